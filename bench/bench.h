@@ -0,0 +1,50 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+// C/C++ language includes
+#include <chrono>
+#include <stdio.h>
+
+#include "host.h"
+
+// Minimum wall clock time to spend on each measurement
+#define BENCH_MIN_NS 200000000LL
+
+// Returns average nanoseconds per call of fn(), calls it in doubling batches until
+// a batch takes at least BENCH_MIN_NS.  Only useful for comparing one result with
+// another on the same host, it says nothing about how long the same code takes on ESP32.
+template <class F> double benchNs(F fn)
+{
+    for (long n = 1;; n *= 2)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < n; i++)
+            fn();
+        long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        if (ns >= BENCH_MIN_NS)
+            return (double)ns / n;
+    }
+}
+
+inline void benchReport(const char *name, double ns)
+{
+    printf("%-48s %10.1f ns\n", name, ns);
+}
+
+// Prints to stdout, for the firmware's own statistics functions
+class StdoutPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override { return fputc(c, stdout) == EOF ? 0 : 1; }
+    size_t write(const uint8_t *b, size_t n) override { return fwrite(b, 1, n, stdout); }
+    using Print::write;
+};
@@ -0,0 +1,93 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Cost of reading a user setting.  Typed getters index the current snapshot by
+ * ConfigKey, the string keyed get() used by the web server and CLI searches for
+ * the key first and returns a std::variant (string values only inside a
+ * transaction, so not timed here).  For comparison, a lookup in a
+ * std::map<std::string, std::variant> as userSettings was before settings were
+ * indexed.
+ *
+ * config.cpp is compiled unchanged, NVS is held in memory (see stub/host.cpp).
+ */
+
+#include <atomic>
+#include <map>
+#include <thread>
+#include <variant>
+
+#include "bench.h"
+#include "ratgdo.h"
+#include "config.h"
+
+int main()
+{
+    esp_log_set_vprintf((vprintf_like_t)esp_log_hook);
+    volatile int sink = 0;
+
+    printf("Typed getters\n");
+    benchReport("getTTCseconds() (int)", benchNs([&]
+                                                 { sink = sink + userConfig->getTTCseconds(); }));
+    benchReport("getTTClight() (bool)", benchNs([&]
+                                                { sink = sink + userConfig->getTTClight(); }));
+    benchReport("getTimeZone() (string copy)", benchNs([&]
+                                                       { sink = sink + *userConfig->getTimeZone().c_str(); }));
+
+    printf("\nString keyed get(), returns std::variant\n");
+    benchReport("get(cfg_TTCseconds) (int)", benchNs([&]
+                                                     { sink = sink + std::get<int>(userConfig->get(cfg_TTCseconds)); }));
+    benchReport("get(cfg_TTClight) (bool)", benchNs([&]
+                                                    { sink = sink + std::get<bool>(userConfig->get(cfg_TTClight)); }));
+    benchReport("contains(cfg_TTCseconds)", benchNs([&]
+                                                    { sink = sink + userConfig->contains(cfg_TTCseconds); }));
+
+    // Map as settings were held before, std::string key built on every call and the value copied out
+    std::map<std::string, std::variant<bool, int, std::string>> settings;
+    static const char *const keys[] = {cfg_deviceName, cfg_dht22Pin, cfg_dht22TempFormat, cfg_wifiChanged,
+                                       cfg_wifiPower, cfg_wifiPhyMode, cfg_staticIP, cfg_localIP, cfg_subnetMask,
+                                       cfg_gatewayIP, cfg_nameserverIP, cfg_passwordRequired, cfg_wwwUsername,
+                                       cfg_wwwCredentials, cfg_GDOSecurityType, cfg_TTCseconds, cfg_TTClight,
+                                       cfg_rebootSeconds, cfg_LEDidle, cfg_motionTriggers, cfg_enableNTP,
+                                       cfg_doorUpdateAt, cfg_doorOpenAt, cfg_doorCloseAt, cfg_timeZone,
+                                       cfg_softAPmode, cfg_syslogEn, cfg_syslogIP, cfg_syslogPort,
+                                       cfg_syslogFacility, cfg_logLevel, cfg_dcOpenClose, cfg_dcBypassTTC,
+                                       cfg_useToggle, cfg_dcDebounceDuration, cfg_useSWserial, cfg_obstFromStatus,
+                                       cfg_builtInTTC, cfg_vehicleThreshold, cfg_vehicleHomeKit,
+                                       cfg_vehicleOccupancyHomeKit, cfg_vehicleArrivingHomeKit,
+                                       cfg_vehicleDepartingHomeKit, cfg_laserEnabled, cfg_laserHomeKit,
+                                       cfg_assistDuration, cfg_occupancyDuration, cfg_enableIPv6, cfg_homespanCLI,
+                                       cfg_lightHomeKit, cfg_motionHomeKit};
+    for (const char *key : keys)
+        if (userConfig->contains(key))
+            settings[key] = 0;
+    settings[cfg_TTClight] = true;
+    settings[cfg_timeZone] = std::string("America/New_York;EST5EDT,M3.2.0,M11.1.0");
+    printf("\nstd::map<std::string, std::variant>, %lu settings\n", (unsigned long)settings.size());
+    benchReport("settings[cfg_TTCseconds] (int)", benchNs([&]
+                                                          { auto v = settings[cfg_TTCseconds];
+                                                            sink = sink + std::get<int>(v); }));
+    benchReport("settings[cfg_timeZone] (string)", benchNs([&]
+                                                           { auto v = settings[cfg_timeZone];
+                                                             sink = sink + std::get<std::string>(v)[0]; }));
+
+    // Readers of the same setting on two tasks, as web server task and main loop do
+    printf("\nTyped getter with another task reading at the same time\n");
+    std::atomic<bool> stop{false};
+    std::thread other([&]
+                      { while (!stop)
+                            sink = sink + userConfig->getTTCseconds(); });
+    benchReport("getTTCseconds() (int)", benchNs([&]
+                                                 { sink = sink + userConfig->getTTCseconds(); }));
+    stop = true;
+    other.join();
+    return 0;
+}
@@ -0,0 +1,127 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Cost of ESP_LOGx() through LOG::logToBuffer(), by level, number of arguments,
+ * number of browsers subscribed to the log and with syslog enabled.  Also the
+ * cost of a line that is dropped by the rate limit or filtered out by level.
+ *
+ * The firmware's log.cpp and utilities.cpp are compiled unchanged.  Serial and
+ * syslog output go to counting sinks (see stub/host.h) and SSEBroadcastState()
+ * below stands in for web.cpp, it builds the event frame once per line and copies
+ * it to each subscriber's queue, as web.cpp does.
+ */
+
+#include "bench.h"
+#include "ratgdo.h"
+#include "config.h"
+#include "web.h"
+
+static const char *TAG = "ratgdo-bench";
+
+char device_name_rfc952[DEVICE_NAME_SIZE] = "ratgdo-bench";
+extern WiFiUDP syslog;
+
+/****************************************************************************
+ * Stand in for web.cpp
+ */
+#define SSE_MAX_CHANNELS 8 // as in web.cpp
+#define SUBSCRIBER_QUEUE_SIZE 1024
+static uint32_t subscribers = 0;
+static char frame[LINE_BUFFER_SIZE + 64];
+static struct
+{
+    char queue[SUBSCRIBER_QUEUE_SIZE];
+    size_t used;
+} subscriber[SSE_MAX_CHANNELS];
+
+void SSEBroadcastState(const char *data, BroadcastType type)
+{
+    if (subscribers == 0)
+        return;
+    size_t len = snprintf(frame, sizeof(frame), "event: logger\nid: %lu\ndata: %s\n\n", (unsigned long)ratgdoLogger->getSequence(), data);
+    len = std::min(len, sizeof(frame) - 1);
+    for (uint32_t i = 0; i < subscribers; i++)
+    {
+        // Queue is emptied whenever it would overflow, as if the client keeps up
+        if (subscriber[i].used + len > SUBSCRIBER_QUEUE_SIZE)
+            subscriber[i].used = 0;
+        memcpy(&subscriber[i].queue[subscriber[i].used], frame, len);
+        subscriber[i].used += len;
+    }
+}
+
+/****************************************************************************
+ * Benchmarks
+ */
+
+// Every call site starts with a full bucket and gets one token per call, so no line is rate limited.
+#define REFILL() host_advance_millis(1000 / LOG_RATE_PER_SEC)
+
+int main()
+{
+    esp_log_set_vprintf((vprintf_like_t)esp_log_hook);
+    const char *door = "Opening";
+    uint32_t count = 42;
+
+    printf("Logging, per line (LINE_BUFFER_SIZE %d, LOG_BUFFER_SIZE %d)\n", LINE_BUFFER_SIZE, LOG_BUFFER_SIZE);
+    benchReport("ESP_LOGE", benchNs([&]
+                                    { REFILL(); ESP_LOGE(TAG, "Door state: %s", door); }));
+    benchReport("ESP_LOGW", benchNs([&]
+                                    { REFILL(); ESP_LOGW(TAG, "Door state: %s", door); }));
+    benchReport("ESP_LOGI", benchNs([&]
+                                    { REFILL(); ESP_LOGI(TAG, "Door state: %s", door); }));
+    benchReport("ESP_LOGD", benchNs([&]
+                                    { REFILL(); ESP_LOGD(TAG, "Door state: %s", door); }));
+    benchReport("ESP_LOGV", benchNs([&]
+                                    { REFILL(); ESP_LOGV(TAG, "Door state: %s", door); }));
+
+    printf("\nArguments, ESP_LOGI\n");
+    benchReport("0 arguments", benchNs([&]
+                                       { REFILL(); ESP_LOGI(TAG, "Door state changed"); }));
+    benchReport("1 argument", benchNs([&]
+                                      { REFILL(); ESP_LOGI(TAG, "Door state: %s", door); }));
+    benchReport("3 arguments", benchNs([&]
+                                       { REFILL(); ESP_LOGI(TAG, "Door state: %s, count: %lu, %d", door, count, -1); }));
+    benchReport("6 arguments", benchNs([&]
+                                       { REFILL(); ESP_LOGI(TAG, "Door %s, %lu, %d, %s, 0x%08lX, %s", door, count, -1, TAG, count, door); }));
+
+    printf("\nSubscribers to the log, ESP_LOGI\n");
+    for (uint32_t n : {0, 1, 4})
+    {
+        char name[48];
+        subscribers = n;
+        snprintf(name, sizeof(name), "%lu subscribers", (unsigned long)n);
+        benchReport(name, benchNs([&]
+                                  { REFILL(); ESP_LOGI(TAG, "Door state: %s", door); }));
+    }
+    subscribers = 0;
+
+    printf("\nSyslog, ESP_LOGI\n");
+    strlcpy(syslogIP, "192.168.1.100", sizeof(syslogIP));
+    syslogEn = true;
+    benchReport("syslog enabled", benchNs([&]
+                                          { REFILL(); ESP_LOGI(TAG, "Door state: %s", door); }));
+    syslogEn = false;
+
+    printf("\nLines not logged\n");
+    benchReport("ESP_LOGI, rate limited", benchNs([&]
+                                                  { ESP_LOGI(TAG, "Door state: %s", door); }));
+    esp_log_level_set("*", ESP_LOG_INFO);
+    benchReport("ESP_LOGD, below log level", benchNs([&]
+                                                     { ESP_LOGD(TAG, "Door state: %s", door); }));
+    esp_log_level_set("*", ESP_LOG_VERBOSE);
+
+    printf("\nSerial: %lu bytes, syslog: %lu packets\n\n", (unsigned long)Serial.bytes, (unsigned long)syslog.packets);
+    StdoutPrint out;
+    ratgdoLogger->printStats(out);
+    return 0;
+}
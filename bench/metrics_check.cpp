@@ -0,0 +1,88 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Writes the /metrics page to stdout, for `make check-metrics` to validate with
+ * promtool (or metrics_lint.py when promtool is not installed).
+ *
+ * The registry is filled as on the device.  web.cpp registers its own metrics
+ * and a latency histogram per route as requests are handled, the metrics that
+ * ratgdo.cpp and comms.cpp register are registered here with the same names,
+ * help and labels.  metrics.cpp and web.cpp are compiled unchanged.
+ */
+
+#include "bench.h"
+#include "ratgdo.h"
+#include "config.h"
+#include "log.h"
+#include "web.h"
+#include "metrics.h"
+
+void handle_everything();
+
+// Few enough requests that rate limits never refuse them
+static void request(const char *uri, HTTPMethod method)
+{
+    server.request.uri = uri;
+    server.request.method = method;
+    handle_everything();
+}
+
+int main()
+{
+    esp_log_set_vprintf((vprintf_like_t)esp_log_hook);
+    garage_door.active = true;
+    setup_web();
+
+    // As ratgdo.cpp setup_metrics()
+    metric *loopTime = metric_histogram("ratgdo_loop_duration_seconds", "Main loop iteration time", metricBucketsLoop, METRICS_MAX_BUCKETS);
+    metric_gauge("ratgdo_uptime_seconds", "Time since boot", NULL, []() -> uint32_t
+                 { return (uint32_t)(_millis() / 1000); });
+    metric_gauge("ratgdo_heap_free_bytes", "Current free heap", NULL, []() -> uint32_t
+                 { return ESP.getFreeHeap(); });
+    metric_gauge("ratgdo_heap_min_free_bytes", "Lowest free heap since boot", NULL, []() -> uint32_t
+                 { return min_heap; });
+    metric_gauge("ratgdo_heap_largest_free_block_bytes", "Largest block that can be allocated", NULL, []() -> uint32_t
+                 { return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT); });
+    metric_counter("ratgdo_log_dropped_total", "Log lines dropped by rate limiting", NULL, []() -> uint32_t
+                   { return ratgdoLogger->getDropped(); });
+    metric_counter("ratgdo_nvs_writes_total", "Values written to NVS, before coalescing", NULL, []() -> uint32_t
+                   { return nvRam->writes; });
+    metric_counter("ratgdo_nvs_commits_total", "NVS commits", NULL, []() -> uint32_t
+                   { return nvRam->commits; });
+    metric_counter("ratgdo_nvs_stored_total", "Values written to NVS flash after coalescing", NULL, []() -> uint32_t
+                   { return nvRam->stored; });
+    metric_gauge("ratgdo_nvs_commit_stall_max_microseconds", "Longest NVS flush and commit", NULL, []() -> uint32_t
+                 { return nvRam->maxStallUs; });
+    metric_gauge("ratgdo_crash_count", "Crash logs saved since last cleared", NULL, []() -> uint32_t
+                 { return 0; });
+
+    // As comms.cpp setup_comms()
+    metric *gdoRxFrames = metric_counter("ratgdo_gdo_rx_frames_total", "Messages received from garage door opener");
+    metric_counter("ratgdo_gdo_tx_frames_total", "Messages sent to garage door opener");
+    metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"decode\"");
+    metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"tx\"");
+    metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"uart\"");
+
+    // Some activity, loop times in every bucket and over the last bound
+    metric_inc(gdoRxFrames, 42);
+    for (uint32_t us = 1; us < 2 * metricBucketsLoop[METRICS_MAX_BUCKETS - 1]; us = us * 3 / 2 + 1)
+        metric_observe(loopTime, us);
+    userConfig->set(ConfigKey::TTCseconds, 10);
+    request("/index.html", HTTP_GET);
+    request("/status.json", HTTP_GET);
+    request("/setgdo", HTTP_GET);
+    request("/wp-login.php", HTTP_GET);
+
+    StdoutPrint out;
+    metrics_render(out);
+    return 0;
+}
@@ -0,0 +1,170 @@
+#!/usr/bin/env python3
+#
+# Checks a page in Prometheus text exposition format (version 0.0.4), for use where
+# promtool is not installed.  Covers the parts of the format that metrics_render()
+# produces: HELP and TYPE once per family and before its samples, families not
+# split, names and labels well formed, no duplicate series, counters named _total,
+# and histogram buckets ascending and cumulative with +Inf equal to _count.
+#
+# Usage: metrics_lint.py [file], reads stdin if no file.  Exit status 1 if any problem.
+
+import math
+import re
+import sys
+
+NAME = r'[a-zA-Z_:][a-zA-Z0-9_:]*'
+LABEL = r'[a-zA-Z_][a-zA-Z0-9_]*'
+SAMPLE = re.compile(r'^(' + NAME + r')(?:\{(.*)\})? (\S+)$')
+LABEL_PAIR = re.compile(r'(' + LABEL + r')="((?:[^"\\\n]|\\[\\"n])*)"(,|$)')
+TYPES = ('counter', 'gauge', 'histogram', 'summary', 'untyped')
+SUFFIXES = ('_bucket', '_sum', '_count')
+
+problems = []
+
+
+def problem(lineno, msg):
+    problems.append('line %d: %s' % (lineno, msg))
+
+
+def parseLabels(lineno, text):
+    labels = {}
+    pos = 0
+    while text and pos < len(text):
+        m = LABEL_PAIR.match(text, pos)
+        if not m:
+            problem(lineno, 'malformed labels "%s"' % text)
+            return None
+        if m.group(1) in labels:
+            problem(lineno, 'duplicate label "%s"' % m.group(1))
+        labels[m.group(1)] = m.group(2)
+        pos = m.end()
+    return labels
+
+
+def familyOf(name, types):
+    if name in types:
+        return name
+    for s in SUFFIXES:
+        if name.endswith(s) and name[:-len(s)] in types and types[name[:-len(s)]] == 'histogram':
+            return name[:-len(s)]
+    return name
+
+
+def checkHistograms(series, types):
+    for family, kind in types.items():
+        if kind != 'histogram':
+            continue
+        groups = {}
+        for (name, labels), (lineno, value) in series.items():
+            if familyOf(name, types) != family:
+                continue
+            key = tuple(sorted((k, v) for k, v in labels if k != 'le'))
+            groups.setdefault(key, {'buckets': [], 'sum': None, 'count': None})
+            g = groups[key]
+            if name == family + '_bucket':
+                le = dict(labels).get('le')
+                if le is None:
+                    problem(lineno, '%s_bucket without le label' % family)
+                    continue
+                g['buckets'].append((lineno, float(le), value))
+            elif name == family + '_sum':
+                g['sum'] = value
+            elif name == family + '_count':
+                g['count'] = value
+            else:
+                problem(lineno, '%s is not a histogram series of %s' % (name, family))
+        for key, g in groups.items():
+            where = '%s%s' % (family, dict(key) if key else '')
+            buckets = sorted(g['buckets'], key=lambda b: b[0])
+            if not buckets or not math.isinf(buckets[-1][1]):
+                problems.append('%s: no +Inf bucket' % where)
+                continue
+            bounds = [b[1] for b in buckets]
+            if bounds != sorted(bounds):
+                problems.append('%s: bucket bounds not ascending' % where)
+            counts = [b[2] for b in buckets]
+            if any(a > b for a, b in zip(counts, counts[1:])):
+                problems.append('%s: bucket counts not cumulative' % where)
+            if g['sum'] is None or g['count'] is None:
+                problems.append('%s: missing _sum or _count' % where)
+            elif g['count'] != counts[-1]:
+                problems.append('%s: _count %g differs from +Inf bucket %g' % (where, g['count'], counts[-1]))
+
+
+def lint(text):
+    helps = {}
+    types = {}
+    series = {}
+    finished = set()
+    current = None
+    if text and not text.endswith('\n'):
+        problem(text.count('\n') + 1, 'no newline at end of page')
+    for lineno, line in enumerate(text.splitlines(), 1):
+        if not line.strip():
+            continue
+        if line.startswith('#'):
+            parts = line.split(None, 3)
+            if len(parts) < 3 or parts[1] not in ('HELP', 'TYPE'):
+                continue
+            name = parts[2]
+            if not re.fullmatch(NAME, name):
+                problem(lineno, 'invalid metric name "%s"' % name)
+            seen = helps if parts[1] == 'HELP' else types
+            if name in seen:
+                problem(lineno, '%s repeated for %s' % (parts[1], name))
+            if parts[1] == 'TYPE':
+                kind = parts[3] if len(parts) > 3 else ''
+                if kind not in TYPES:
+                    problem(lineno, 'unknown type "%s" for %s' % (kind, name))
+                if any(familyOf(n, {name: kind}) == name for n, _ in series):
+                    problem(lineno, 'TYPE for %s after its samples' % name)
+                if kind == 'counter' and not name.endswith('_total'):
+                    problem(lineno, 'counter %s should end in _total' % name)
+                types[name] = kind
+            else:
+                helps[name] = parts[3] if len(parts) > 3 else ''
+            if name != current:
+                if name in finished:
+                    problem(lineno, 'family %s is split' % name)
+                if current:
+                    finished.add(current)
+                current = name
+            continue
+        m = SAMPLE.match(line)
+        if not m:
+            problem(lineno, 'malformed sample "%s"' % line)
+            continue
+        name, labelText, valueText = m.groups()
+        labels = parseLabels(lineno, labelText or '')
+        if labels is None:
+            continue
+        try:
+            value = float(valueText)
+        except ValueError:
+            problem(lineno, 'value "%s" is not a number' % valueText)
+            continue
+        family = familyOf(name, types)
+        if family not in types:
+            problem(lineno, '%s has no TYPE' % name)
+        if family != current:
+            if family in finished:
+                problem(lineno, 'family %s is split' % family)
+            if current:
+                finished.add(current)
+            current = family
+        key = (name, tuple(sorted(labels.items())))
+        if key in series:
+            problem(lineno, 'duplicate series %s' % line.rsplit(' ', 1)[0])
+        series[key] = (lineno, value)
+    checkHistograms(series, types)
+    return len(types), len(series)
+
+
+if __name__ == '__main__':
+    text = open(sys.argv[1]).read() if len(sys.argv) > 1 else sys.stdin.read()
+    families, samples = lint(text)
+    for p in problems:
+        print(p)
+    if problems:
+        sys.exit(1)
+    print('%d families, %d samples, no problems found' % (families, samples))
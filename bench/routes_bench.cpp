@@ -0,0 +1,102 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Route resolution.  Lookup of a page in the perfect hash table generated by
+ * build_web_content.py, against a std::unordered_map keyed by std::string (as
+ * built in API routes are, and as web content was).  Then the whole dispatch
+ * through handle_everything() for web content, a 304 Not Modified, a built in
+ * API route and an unknown page.
+ *
+ * webcontent.h is generated from src/www exactly as in the firmware build, and
+ * web.cpp is compiled unchanged.  Response bytes are counted, not sent.
+ */
+
+#include <unordered_map>
+
+#include "bench.h"
+// Before web.h, so that this file has its own copy of the MIME types which web.h declares extern
+#include "webcontent.h"
+#include "ratgdo.h"
+#include "web.h"
+
+void handle_everything();
+
+#define WEBCONTENT_COUNT (sizeof(webcontent) / sizeof(webcontent[0]))
+
+// Pages that are not in webcontent.h, including built in API routes as those are looked up there too
+static const char *const misses[] = {"/status.json", "/setgdo", "/rest/events/subscribe", "/index.htm", "/favicon.jpg", "/wp-login.php"};
+#define MISS_COUNT (sizeof(misses) / sizeof(misses[0]))
+
+// Request as handle_everything() sees it, with headers already set.  Clock moves on so that
+// rate limits never refuse it.
+static size_t request(const char *uri, HTTPMethod method)
+{
+    host_advance_millis(250);
+    server.request.uri = uri;
+    server.request.method = method;
+    server.sent = 0;
+    handle_everything();
+    return server.sent;
+}
+
+int main()
+{
+    esp_log_set_vprintf((vprintf_like_t)esp_log_hook);
+    garage_door.active = true;
+    setup_web();
+
+    // Pages as they arrive, in a buffer rather than string literals, so the compiler cannot fold lookups.
+    std::vector<std::string> hits;
+    for (size_t i = 0; i < WEBCONTENT_COUNT; i++)
+        hits.push_back(webcontent[i].name);
+    std::vector<std::string> notFound(misses, misses + MISS_COUNT);
+    std::unordered_map<std::string, const pageContent *> map;
+    for (size_t i = 0; i < WEBCONTENT_COUNT; i++)
+        map[webcontent[i].name] = &webcontent[i];
+
+    printf("Web content lookup, %lu pages\n", (unsigned long)WEBCONTENT_COUNT);
+    size_t n = 0;
+    const pageContent *volatile found;
+    benchReport("webcontent_find(), found", benchNs([&]
+                                                    { found = webcontent_find(hits[n++ % hits.size()].c_str()); }));
+    benchReport("webcontent_find(), not found", benchNs([&]
+                                                        { found = webcontent_find(notFound[n++ % notFound.size()].c_str()); }));
+    // Key is constructed from the request's char *, as for builtInUri
+    benchReport("std::unordered_map, found", benchNs([&]
+                                                     { auto it = map.find(hits[n++ % hits.size()].c_str());
+                                                       found = (it == map.end()) ? nullptr : it->second; }));
+    benchReport("std::unordered_map, not found", benchNs([&]
+                                                         { auto it = map.find(notFound[n++ % notFound.size()].c_str());
+                                                           found = (it == map.end()) ? nullptr : it->second; }));
+
+    printf("\nhandle_everything(), response header only\n");
+    const pageContent *index = webcontent_find("/index.html");
+    char etag[32];
+    strlcpy(etag, index->br.data ? index->br.etag : index->gzip.etag, sizeof(etag));
+    size_t bytes = 0;
+    server.request.headers["Accept-Encoding"] = "gzip, deflate, br";
+    double ns = benchNs([&]
+                        { bytes = request("/index.html", HTTP_HEAD); });
+    printf("%-48s %10.1f ns (%lu bytes)\n", "HEAD /index.html", ns, (unsigned long)bytes);
+    server.request.headers["If-None-Match"] = etag;
+    ns = benchNs([&]
+                 { bytes = request("/index.html", HTTP_GET); });
+    printf("%-48s %10.1f ns (%lu bytes)\n", "GET /index.html, 304 Not Modified", ns, (unsigned long)bytes);
+    server.request.headers.erase("If-None-Match");
+    ns = benchNs([&]
+                 { bytes = request("/setgdo", HTTP_GET); });
+    printf("%-48s %10.1f ns (%lu bytes)\n", "GET /setgdo, built in route, wrong method", ns, (unsigned long)bytes);
+    ns = benchNs([&]
+                 { bytes = request("/wp-login.php", HTTP_GET); });
+    printf("%-48s %10.1f ns (%lu bytes)\n", "GET /wp-login.php, 404 Not Found", ns, (unsigned long)bytes);
+    return 0;
+}
@@ -0,0 +1,86 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Output rate of build_status_json(), the document served as status.json and
+ * sent to each browser when it subscribes, and of the changed-values update
+ * that web_loop() sends when the door state changes.
+ *
+ * web.cpp, config.cpp, log.cpp, utilities.cpp, metrics.cpp, led.cpp and
+ * profiler.cpp are compiled unchanged, door state is set as a Security+ 2.0
+ * opener with a vehicle sensor so that every optional member is present.
+ */
+
+#include "bench.h"
+#include "ratgdo.h"
+#include "comms.h"
+#include "config.h"
+#include "web.h"
+
+// Door state as seen on a Security+ 2.0 opener with some history
+static void setDoorState()
+{
+    garage_door.active = true;
+    garage_door.current_state = GarageDoorCurrentState::CURR_CLOSED;
+    garage_door.target_state = GarageDoorTargetState::TGT_CLOSED;
+    garage_door.current_lock = LockCurrentState::CURR_UNLOCKED;
+    garage_door.target_lock = LockTargetState::TGT_UNLOCKED;
+    garage_door.has_motion_sensor = true;
+    garage_door.has_distance_sensor = true;
+    garage_door.openingsCount = 12345;
+    garage_door.batteryState = 2;
+    garage_door.openDuration = 12500;
+    garage_door.closeDuration = 13750;
+    garage_door.builtInTTC = 300;
+    doorControlType = 2;
+    for (uint32_t i = 0; i < DOOR_MAX_HISTORY; i++)
+    {
+        openHistory.duration[i] = 12000 + i * 100;
+        closeHistory.duration[i] = 13000 + i * 150;
+    }
+    openHistory.count = closeHistory.count = DOOR_MAX_HISTORY;
+}
+
+int main()
+{
+    esp_log_set_vprintf((vprintf_like_t)esp_log_hook);
+    setDoorState();
+    setup_web();
+
+    static char json[STATUS_JSON_BUFFER_SIZE + STATUS_STATIC_BUFFER_SIZE];
+    size_t len = build_status_json(json, sizeof(json));
+    printf("status.json: %lu bytes (buffer %lu)\n", (unsigned long)len, (unsigned long)sizeof(json));
+
+    double ns = benchNs([&]
+                        { build_status_json(json, sizeof(json)); });
+    benchReport("build_status_json", ns);
+    printf("%-48s %10.1f MB/s\n", "  output rate", len * 1000.0 / ns);
+
+    // Static segment is rebuilt after any config change, cost here includes the set()
+    int ttc = 0;
+    double setNs = benchNs([&]
+                           { userConfig->set(ConfigKey::TTCseconds, (ttc++ & 1) ? 5 : 10); });
+    benchReport("userConfig->set()", setNs);
+    ns = benchNs([&]
+                 { userConfig->set(ConfigKey::TTCseconds, (ttc++ & 1) ? 5 : 10);
+                   build_status_json(json, sizeof(json)); });
+    benchReport("userConfig->set() + build_status_json", ns);
+    benchReport("  static segment rebuild (difference)", ns - setNs - benchNs([&]
+                                                                               { build_status_json(json, sizeof(json)); }));
+
+    printf("\nweb_loop(), no subscribers\n");
+    benchReport("nothing changed", benchNs([&]
+                                           { web_loop(); }));
+    benchReport("door and light changed", benchNs([&]
+                                                  { garage_door_changed |= GDO_CHANGED_DOOR_STATE | GDO_CHANGED_LIGHT;
+                                                    web_loop(); }));
+    return 0;
+}
@@ -0,0 +1,103 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Stand-ins for the firmware modules that talk to the door opener, HomeKit and
+ * the laser/vehicle sensor, which the benchmarks do not compile.  State is as
+ * ratgdo.cpp, comms.cpp, homekit.cpp and vehicle.cpp initialize it, a benchmark
+ * sets whatever it needs.  Functions do nothing.
+ */
+
+#include "ratgdo.h"
+#include "comms.h"
+#include "homekit.h"
+#include "vehicle.h"
+#include "softAP.h"
+#include "provision.h"
+
+// ratgdo.cpp
+GarageDoor garage_door = {
+    .pinModeObstructionSensor = false,
+    .wallPanelEmulated = false,
+    .active = false,
+    .current_state = (GarageDoorCurrentState)0xFF,
+    .target_state = (GarageDoorTargetState)0xFF,
+    .obstructed = false,
+    .has_motion_sensor = false,
+#ifdef RATGDO32_DISCO
+    .has_distance_sensor = false,
+#endif
+#ifndef USE_GDOLIB
+    .motion_timer = 0,
+#endif
+    .motion = false,
+    .light = false,
+    .current_lock = (LockCurrentState)0xFF,
+    .target_lock = (LockTargetState)0xFF,
+    .openingsCount = 0,
+    .batteryState = 0,
+    .openDuration = 0,
+    .closeDuration = 0,
+    .ttcActive = 0,
+    .builtInTTC = 0,
+    .builtInTTCremaining = 0,
+    .builtInTTChold = false,
+};
+volatile uint32_t garage_door_changed = 0;
+volatile uint32_t garage_door_generation = 0;
+uint32_t free_heap = (1024 * 1024);
+uint32_t min_heap = (1024 * 1024);
+static char loopJson[LOOP_JSON_BUFFER_SIZE];
+char *loop_json = loopJson;
+
+// comms.cpp
+uint32_t doorControlType = 0;
+struct DoorHistory openHistory;
+struct DoorHistory closeHistory;
+void shutdown_comms() {}
+void send_get_status() {}
+GarageDoorCurrentState open_door() { return garage_door.current_state; }
+GarageDoorCurrentState close_door(bool bypass_ttc) { return garage_door.current_state; }
+void send_cancel_ttc() {}
+void send_set_ttc(uint16_t seconds) {}
+bool set_lock(bool value, bool verify) { return true; }
+bool set_light(bool value, bool verify) { return true; }
+void save_rolling_code() {}
+void reset_door() {}
+uint32_t is_ttc_active() { return garage_door.ttcActive; }
+
+// homekit.cpp
+char qrPayload[21] = "X-HM://0000000000000";
+char ipv6_addresses[LWIP_IPV6_NUM_ADDRESSES * IP6ADDR_STRLEN_MAX] = {0};
+bool homekit_paired = false;
+bool homekit_is_paired() { return homekit_paired; }
+void homekit_unpair() {}
+void enable_service_homekit_motion(bool reboot) {}
+void notify_homekit_laser(bool on) {}
+void notify_homekit_temperature_humidity(float temp, float hum) {}
+void enable_service_homekit_vehicle(bool enable) {}
+bool enable_service_homekit_laser(bool enable) { return enable; }
+bool enable_service_homekit_light(bool enable) { return enable; }
+bool enable_service_homekit_motion_sensor(bool enable) { return enable; }
+bool enable_service_homekit_room_occupancy(bool enable) { return enable; }
+
+// vehicle.cpp
+int16_t vehicleDistance = 0;
+int16_t vehicleThresholdDistance = 1000;
+char vehicleStatus[16] = "Away";
+
+// softAP.cpp and provision.cpp
+void handle_setssid() {}
+void handle_rescan() {}
+void handle_wifinets() {}
+void handle_wifiap() {}
+void setup_improv() {}
+void disable_improv() {}
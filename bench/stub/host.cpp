@@ -0,0 +1,434 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+// C/C++ language includes
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "host.h"
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+HardwareSerial Serial2;
+const IPAddress INADDR_NONE_HOST(0, 0, 0, 0);
+EspClass ESP;
+WiFiClass WiFi;
+NetworkClass Network;
+MDNSResponder MDNS;
+UpdateClass Update;
+FS LittleFS;
+Span homeSpan;
+
+/****************************************************************************
+ * Time
+ */
+static std::atomic<uint64_t> hostOffsetUs{0};
+
+// Starts at zero on first call, which may be from a constructor of a firmware global.
+static uint64_t hostMicros()
+{
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count() + hostOffsetUs;
+}
+
+unsigned long millis()
+{
+    return (uint32_t)(hostMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (uint32_t)hostMicros();
+}
+
+int64_t esp_timer_get_time()
+{
+    return hostMicros();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void host_advance_millis(uint32_t ms)
+{
+    hostOffsetUs += (uint64_t)ms * 1000;
+}
+
+/****************************************************************************
+ * FreeRTOS, every mutex is recursive which is harmless for the ones that are not.
+ */
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new std::recursive_mutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+    return new std::recursive_mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait)
+{
+    if (wait == portMAX_DELAY)
+    {
+        static_cast<std::recursive_mutex *>(sem)->lock();
+        return pdTRUE;
+    }
+    uint32_t start = millis();
+    while (!static_cast<std::recursive_mutex *>(sem)->try_lock())
+    {
+        if (millis() - start >= wait)
+            return pdFALSE;
+        std::this_thread::yield();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    static_cast<std::recursive_mutex *>(sem)->unlock();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait)
+{
+    return xSemaphoreTake(sem, wait);
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    return xSemaphoreGive(sem);
+}
+
+// No tasks, a benchmark calls what the task would.
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    if (handle)
+        *handle = nullptr;
+    return pdFALSE;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    static thread_local int task;
+    return &task;
+}
+
+/****************************************************************************
+ * ESP-IDF logging
+ */
+// Lines logged before a benchmark sets the hook, as setup() in ratgdo.cpp does, are dropped.
+static int logDiscard(const char *fmt, va_list args)
+{
+    return 0;
+}
+static vprintf_like_t logVprintf = logDiscard;
+static esp_log_level_t logMaxLevel = ESP_LOG_VERBOSE;
+
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func)
+{
+    vprintf_like_t old = logVprintf;
+    logVprintf = func;
+    return old;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    logMaxLevel = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...)
+{
+    if (level > logMaxLevel)
+        return;
+    va_list args;
+    va_start(args, fmt);
+    logVprintf(fmt, args);
+    va_end(args);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// Session cookies are never checked by a benchmark, signatures are all zero.
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t type)
+{
+    static const mbedtls_md_info_t info = {0};
+    return &info;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *info, const unsigned char *key, size_t keylen, const unsigned char *input, size_t ilen, unsigned char *output)
+{
+    memset(output, 0, 32);
+    return 0;
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    memset(output, 0, 20);
+    return 0;
+}
+
+void configTzTime(const char *tz, const char *server1, const char *server2, const char *server3)
+{
+}
+
+int esp_rom_printf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int len = vfprintf(stderr, fmt, args);
+    va_end(args);
+    return len;
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    return (err == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+/****************************************************************************
+ * NVS, held in memory and empty at start, every commit is counted.
+ */
+struct nvsEntry
+{
+    nvs_type_t type;
+    std::vector<uint8_t> data;
+};
+static std::vector<std::string> nvsNamespaces;
+static std::map<std::pair<std::string, std::string>, nvsEntry> nvsStore;
+uint32_t host_nvs_commits = 0;
+
+esp_err_t nvs_flash_init()
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase()
+{
+    nvsStore.clear();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle)
+{
+    nvsNamespaces.push_back(name);
+    *handle = nvsNamespaces.size();
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    host_nvs_commits++;
+    return ESP_OK;
+}
+
+static esp_err_t nvsSet(nvs_handle_t handle, const char *key, nvs_type_t type, const void *value, size_t length)
+{
+    if (!handle || handle > nvsNamespaces.size())
+        return ESP_ERR_INVALID_ARG;
+    const uint8_t *bytes = static_cast<const uint8_t *>(value);
+    nvsStore[{nvsNamespaces[handle - 1], key}] = {type, std::vector<uint8_t>(bytes, bytes + length)};
+    return ESP_OK;
+}
+
+static const nvsEntry *nvsGet(nvs_handle_t handle, const char *key, nvs_type_t type)
+{
+    if (!handle || handle > nvsNamespaces.size())
+        return nullptr;
+    auto it = nvsStore.find({nvsNamespaces[handle - 1], key});
+    return (it == nvsStore.end() || it->second.type != type) ? nullptr : &it->second;
+}
+
+// Length is in and out, value may be NULL to get length only.
+static esp_err_t nvsGetVariable(nvs_handle_t handle, const char *key, nvs_type_t type, void *value, size_t *length)
+{
+    const nvsEntry *e = nvsGet(handle, key, type);
+    if (!e)
+        return ESP_ERR_NVS_NOT_FOUND;
+    if (value && *length < e->data.size())
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    if (value)
+        memcpy(value, e->data.data(), e->data.size());
+    *length = e->data.size();
+    return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (!handle || handle > nvsNamespaces.size())
+        return ESP_ERR_INVALID_ARG;
+    return nvsStore.erase({nvsNamespaces[handle - 1], key}) ? ESP_OK : ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    if (!handle || handle > nvsNamespaces.size())
+        return ESP_ERR_INVALID_ARG;
+    for (auto it = nvsStore.begin(); it != nvsStore.end();)
+        it = (it->first.first == nvsNamespaces[handle - 1]) ? nvsStore.erase(it) : std::next(it);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *value)
+{
+    const nvsEntry *e = nvsGet(handle, key, NVS_TYPE_I32);
+    if (!e)
+        return ESP_ERR_NVS_NOT_FOUND;
+    memcpy(value, e->data.data(), sizeof(*value));
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value)
+{
+    return nvsSet(handle, key, NVS_TYPE_I32, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *value, size_t *length)
+{
+    return nvsGetVariable(handle, key, NVS_TYPE_STR, value, length);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvsSet(handle, key, NVS_TYPE_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length)
+{
+    return nvsGetVariable(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return nvsSet(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_get_stats(const char *part, nvs_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->used_entries = nvsStore.size();
+    stats->total_entries = 504;
+    stats->free_entries = stats->total_entries - stats->used_entries;
+    stats->available_entries = stats->free_entries;
+    stats->namespace_count = nvsNamespaces.size();
+    return ESP_OK;
+}
+
+// Iterator is a snapshot of the matching entries, followed by the position in it.
+struct nvsIterator
+{
+    std::vector<nvs_entry_info_t> entries;
+    size_t next;
+};
+
+esp_err_t nvs_entry_find(const char *part, const char *name, nvs_type_t type, nvs_iterator_t *it)
+{
+    nvsIterator *iter = new nvsIterator{{}, 0};
+    for (auto &e : nvsStore)
+    {
+        if ((name && e.first.first != name) || (type != NVS_TYPE_ANY && type != e.second.type))
+            continue;
+        nvs_entry_info_t info = {};
+        strlcpy(info.namespace_name, e.first.first.c_str(), sizeof(info.namespace_name));
+        strlcpy(info.key, e.first.second.c_str(), sizeof(info.key));
+        info.type = e.second.type;
+        iter->entries.push_back(info);
+    }
+    if (iter->entries.empty())
+    {
+        delete iter;
+        *it = nullptr;
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    *it = iter;
+    return ESP_OK;
+}
+
+esp_err_t nvs_entry_next(nvs_iterator_t *it)
+{
+    nvsIterator *iter = static_cast<nvsIterator *>(*it);
+    if (++iter->next < iter->entries.size())
+        return ESP_OK;
+    delete iter;
+    *it = nullptr;
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *info)
+{
+    nvsIterator *iter = static_cast<nvsIterator *>(it);
+    *info = iter->entries[iter->next];
+    return ESP_OK;
+}
+
+void nvs_release_iterator(nvs_iterator_t it)
+{
+    delete static_cast<nvsIterator *>(it);
+}
+
+/****************************************************************************
+ * Arduino
+ */
+size_t Print::printf(const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return (len > 0) ? write((const uint8_t *)buf, std::min((size_t)len, sizeof(buf) - 1)) : 0;
+}
+
+size_t Print::printf_P(const char *fmt, ...)
+{
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    return (len > 0) ? write((const uint8_t *)buf, std::min((size_t)len, sizeof(buf) - 1)) : 0;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = std::min(len, size - 1);
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return len;
+}
+
+size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t len = strnlen(dst, size);
+    return len + strlcpy(dst + len, src, size - len);
+}
@@ -0,0 +1,1378 @@
+/****************************************************************************
+ * RATGDO HomeKit for ESP32
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+/****************************************************************************
+ * Host stand-ins for the Arduino, ESP-IDF, FreeRTOS and HomeSpan APIs used by
+ * the firmware sources that the benchmarks compile.  Only ESP32 builds are
+ * supported.  Every system header the sources include is a one line file in
+ * this directory that includes this one.
+ *
+ * Anything on a path that is benchmarked does real work (formatting, copying,
+ * locking) so that costs are not optimized away.  Everything else does nothing
+ * and returns a harmless default.  Functions that are declared but not defined
+ * here are not reachable from any benchmark, the linker discards the code that
+ * calls them (see -Wl,--gc-sections in Makefile).
+ */
+#pragma once
+
+// C/C++ language includes
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <ctype.h>
+#include <sys/time.h>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <optional>
+using std::max;
+using std::min;
+
+/****************************************************************************
+ * Arduino core
+ */
+typedef bool boolean;
+typedef uint8_t byte;
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define FPSTR(s) (s)
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strcasecmp_P strcasecmp
+#define strstr_P strstr
+#define memcpy_P memcpy
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define sprintf_P sprintf
+#define PGM_P const char *
+#define bitRead(v, b) (((v) >> (b)) & 0x01)
+#define bitSet(v, b) ((v) |= (1UL << (b)))
+#define bitClear(v, b) ((v) &= ~(1UL << (b)))
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define OUTPUT_OPEN_DRAIN 3
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define SERIAL_8E1 0x800001e
+#define SERIAL_8N1 0x800001c
+#define IP4ADDR_STRLEN_MAX 16
+#define IP6ADDR_STRLEN_MAX 46
+#define LWIP_IPV6_NUM_ADDRESSES 3
+#define TCP_SND_BUF 5744
+
+// Time runs from the host clock, plus any offset added by host_advance_millis() so a benchmark
+// can move time on without waiting, e.g. to refill log rate limits.
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void host_advance_millis(uint32_t ms);
+inline void delayMicroseconds(unsigned int) {}
+inline void yield() {}
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return 0; }
+inline void attachInterrupt(uint8_t, void (*)(), int) {}
+inline void detachInterrupt(uint8_t) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void tone(uint8_t, unsigned int, unsigned long = 0) {}
+inline void noTone(uint8_t) {}
+inline void noInterrupts() {}
+inline void interrupts() {}
+inline long random(long max) { return max ? rand() % max : 0; }
+inline long random(long min, long max) { return min + random(max - min); }
+inline void randomSeed(unsigned long seed) { srand(seed); }
+template <class T> T constrain(T a, T b, T c) { return a < b ? b : a > c ? c : a; }
+inline uint32_t esp_random() { return (uint32_t)rand() ^ ((uint32_t)rand() << 16); }
+inline void esp_fill_random(void *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        static_cast<uint8_t *>(buf)[i] = esp_random();
+}
+size_t strlcpy(char *dst, const char *src, size_t size);
+size_t strlcat(char *dst, const char *src, size_t size);
+
+class __FlashStringHelper;
+
+class String
+{
+public:
+    std::string s;
+    String() {}
+    String(const char *c) : s(c ? c : "") {}
+    String(const std::string &x) : s(x) {}
+    String(char c) : s(1, c) {}
+    String(int v, int base = 10) : s(std::to_string(v)) {}
+    String(unsigned int v, int base = 10) : s(std::to_string(v)) {}
+    String(long v, int base = 10) : s(std::to_string(v)) {}
+    String(unsigned long v, int base = 10) : s(std::to_string(v)) {}
+    String(long long v, int base = 10) : s(std::to_string(v)) {}
+    String(unsigned long long v, int base = 10) : s(std::to_string(v)) {}
+    String(float v, int d = 2) : s(std::to_string(v)) {}
+    String(double v, int d = 2) : s(std::to_string(v)) {}
+    const char *c_str() const { return s.c_str(); }
+    size_t length() const { return s.size(); }
+    bool isEmpty() const { return s.empty(); }
+    bool reserve(size_t n)
+    {
+        s.reserve(n);
+        return true;
+    }
+    char operator[](size_t i) const { return s[i]; }
+    char &operator[](size_t i) { return s[i]; }
+    char charAt(size_t i) const { return s[i]; }
+    String &operator+=(const String &o)
+    {
+        s += o.s;
+        return *this;
+    }
+    String &operator+=(const char *o)
+    {
+        s += o;
+        return *this;
+    }
+    String &operator+=(char o)
+    {
+        s += o;
+        return *this;
+    }
+    bool concat(const char *o)
+    {
+        s += o;
+        return true;
+    }
+    bool concat(const char *o, size_t n)
+    {
+        s.append(o, n);
+        return true;
+    }
+    bool concat(const String &o)
+    {
+        s += o.s;
+        return true;
+    }
+    bool concat(char o)
+    {
+        s += o;
+        return true;
+    }
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator==(const char *o) const { return s == o; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator!=(const char *o) const { return s != o; }
+    bool operator<(const String &o) const { return s < o.s; }
+    bool equals(const String &o) const { return s == o.s; }
+    bool equalsIgnoreCase(const String &o) const { return strcasecmp(s.c_str(), o.c_str()) == 0; }
+    bool startsWith(const String &o) const { return s.rfind(o.s, 0) == 0; }
+    bool endsWith(const String &o) const { return s.size() >= o.s.size() && s.compare(s.size() - o.s.size(), o.s.size(), o.s) == 0; }
+    int indexOf(const String &o, size_t from = 0) const
+    {
+        size_t p = s.find(o.s, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    int indexOf(char c, size_t from = 0) const
+    {
+        size_t p = s.find(c, from);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    int lastIndexOf(char c) const
+    {
+        size_t p = s.rfind(c);
+        return p == std::string::npos ? -1 : (int)p;
+    }
+    String substring(size_t a) const { return String(s.substr(a)); }
+    String substring(size_t a, size_t b) const { return String(s.substr(a, b - a)); }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return atof(s.c_str()); }
+    void toLowerCase() { std::transform(s.begin(), s.end(), s.begin(), ::tolower); }
+    void toUpperCase() { std::transform(s.begin(), s.end(), s.begin(), ::toupper); }
+    void trim() {}
+    void replace(const String &, const String &) {}
+    void remove(size_t, size_t = 1) {}
+    void clear() { s.clear(); }
+    void toCharArray(char *b, size_t n) const { strlcpy(b, s.c_str(), n); }
+    void getBytes(uint8_t *b, size_t n) const { strlcpy((char *)b, s.c_str(), n); }
+    explicit operator bool() const { return true; }
+};
+inline String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+inline String operator+(const String &a, const char *b) { return String(a.s + b); }
+inline String operator+(const char *a, const String &b) { return String(a + b.s); }
+
+class Print
+{
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *b, size_t n)
+    {
+        size_t r = 0;
+        while (n--)
+            r += write(*b++);
+        return r;
+    }
+    size_t write(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t write(const char *s, size_t n) { return write((const uint8_t *)s, n); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+    size_t print(const char *s) { return write(s); }
+    size_t print(char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(const __FlashStringHelper *s) { return print((const char *)s); }
+    template <class T> size_t print(T v, int = 10) { return print(std::to_string(v).c_str()); }
+    size_t println() { return print("\r\n"); }
+    template <class T> size_t println(T v) { return print(v) + println(); }
+    template <class T> size_t println(T v, int) { return print(v) + println(); }
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    size_t printf_P(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() { return 0; }
+    virtual int read() { return -1; }
+    virtual int peek() { return -1; }
+    size_t readBytes(char *, size_t) { return 0; }
+    size_t readBytes(uint8_t *, size_t) { return 0; }
+    String readString() { return String(); }
+    String readStringUntil(char) { return String(); }
+    void setTimeout(unsigned long) {}
+};
+
+class StreamString : public Stream, public String
+{
+public:
+    size_t write(uint8_t c) override
+    {
+        s += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t *b, size_t n) override
+    {
+        s.append((const char *)b, n);
+        return n;
+    }
+    using Print::write;
+    using String::c_str;
+    using String::length;
+};
+
+// Bytes written are counted and dropped, like a UART with nothing attached.
+class HardwareSerial : public Stream
+{
+public:
+    size_t bytes = 0;
+    size_t write(uint8_t) override
+    {
+        bytes++;
+        return 1;
+    }
+    size_t write(const uint8_t *b, size_t n) override
+    {
+        bytes += n;
+        return n;
+    }
+    using Print::write;
+    void begin(unsigned long, ...) {}
+    void end() {}
+    operator bool() const { return true; }
+    void setDebugOutput(bool) {}
+    void setRxBufferSize(size_t) {}
+    void setTxBufferSize(size_t) {}
+    long parseInt() { return 0; }
+    template <class... A> void onReceiveError(A...) {}
+    template <class... A> void onReceive(A...) {}
+    template <class... A> void setPins(A...) {}
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t addr;
+        } ip4;
+    } u_addr;
+    uint32_t addr;
+    int type;
+} ip_addr_t;
+enum IPType
+{
+    IPv4,
+    IPv6
+};
+class IPAddress
+{
+public:
+    uint8_t b[4] = {0};
+    IPAddress() {}
+    IPAddress(uint32_t a) { memcpy(b, &a, 4); }
+    IPAddress(uint8_t b0, uint8_t b1, uint8_t b2, uint8_t b3) : b{b0, b1, b2, b3} {}
+    IPAddress(const uint8_t *a) { memcpy(b, a, 4); }
+    operator uint32_t() const
+    {
+        uint32_t a;
+        memcpy(&a, b, 4);
+        return a;
+    }
+    uint8_t operator[](int i) const { return b[i]; }
+    uint8_t &operator[](int i) { return b[i]; }
+    bool operator==(const IPAddress &o) const { return !memcmp(b, o.b, 4); }
+    bool operator!=(const IPAddress &o) const { return memcmp(b, o.b, 4); }
+    bool operator==(uint32_t a) const { return (uint32_t)(*this) == a; }
+    bool operator!=(uint32_t a) const { return (uint32_t)(*this) != a; }
+    String toString() const
+    {
+        char buf[IP4ADDR_STRLEN_MAX];
+        snprintf(buf, sizeof(buf), "%u.%u.%u.%u", b[0], b[1], b[2], b[3]);
+        return String(buf);
+    }
+    bool fromString(const char *s)
+    {
+        unsigned int a[4];
+        if (sscanf(s, "%u.%u.%u.%u", &a[0], &a[1], &a[2], &a[3]) != 4)
+            return false;
+        for (int i = 0; i < 4; i++)
+            b[i] = a[i];
+        return true;
+    }
+    bool fromString(const String &s) { return fromString(s.c_str()); }
+    bool isSet() const { return (uint32_t)(*this) != 0; }
+    bool isV4() const { return true; }
+    bool isV6() const { return false; }
+    int type() const { return IPv4; }
+    void to_ip_addr_t(ip_addr_t *a) const { a->u_addr.ip4.addr = (uint32_t)(*this); }
+};
+extern const IPAddress INADDR_NONE_HOST;
+#define INADDR_NONE INADDR_NONE_HOST
+
+class Client : public Stream
+{
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t *, size_t n) override { return n; }
+    using Print::write;
+    virtual int connect(IPAddress, uint16_t) { return 1; }
+    virtual int connect(const char *, uint16_t) { return 1; }
+    virtual void stop() {}
+    virtual uint8_t connected() { return 1; }
+    operator bool() { return true; }
+    IPAddress remoteIP() { return IPAddress(192, 168, 1, 2); }
+    uint16_t remotePort() { return 0; }
+    IPAddress localIP() { return IPAddress(192, 168, 1, 1); }
+    int fd() const { return 0; }
+    void setNoDelay(bool) {}
+    int setSocketOption(int, int, const void *, size_t) { return 0; }
+    template <class... A> void keepAlive(A...) {}
+    void setTimeout(uint32_t) {}
+    int read(uint8_t *, size_t) { return 0; }
+    using Stream::read;
+    void clear() {}
+};
+class WiFiClient : public Client
+{
+public:
+    WiFiClient() {}
+    bool stop(unsigned int) { return true; }
+    using Client::stop;
+};
+
+// Packets are assembled and counted, as syslog would send them, but go nowhere.
+class WiFiUDP : public Stream
+{
+public:
+    char packet[512];
+    size_t length = 0;
+    size_t packets = 0;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *b, size_t n) override
+    {
+        n = std::min(n, sizeof(packet) - length);
+        memcpy(packet + length, b, n);
+        length += n;
+        return n;
+    }
+    using Print::write;
+    int beginPacket(const char *, uint16_t)
+    {
+        length = 0;
+        return 1;
+    }
+    int beginPacket(IPAddress, uint16_t)
+    {
+        length = 0;
+        return 1;
+    }
+    int endPacket()
+    {
+        packets++;
+        return 1;
+    }
+    uint8_t begin(uint16_t) { return 1; }
+    int parsePacket() { return 0; }
+    void stop() {}
+};
+
+/****************************************************************************
+ * FreeRTOS, mutexes are real (see host.cpp), tasks and queues are not.
+ */
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *TimerHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef struct
+{
+    int owner;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(m) ((void)(m))
+#define portEXIT_CRITICAL(m) ((void)(m))
+#define portENTER_CRITICAL_ISR(m) ((void)(m))
+#define portEXIT_CRITICAL_ISR(m) ((void)(m))
+#define taskENTER_CRITICAL(m) ((void)(m))
+#define taskEXIT_CRITICAL(m) ((void)(m))
+#define portYIELD_FROM_ISR(...)
+#define portMAX_DELAY 0xffffffff
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(x) (x)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define errQUEUE_FULL 0
+#define tskNO_AFFINITY 0x7fffffff
+#define configMAX_PRIORITIES 25
+#define eNoAction 0
+#define eIncrement 1
+#define eSetBits 2
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t);
+void vSemaphoreDelete(SemaphoreHandle_t);
+BaseType_t xTaskCreate(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *);
+BaseType_t xTaskCreatePinnedToCore(void (*)(void *), const char *, uint32_t, void *, UBaseType_t, TaskHandle_t *, BaseType_t);
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
+void vTaskDelete(TaskHandle_t);
+void vTaskSuspend(TaskHandle_t);
+void vTaskResume(TaskHandle_t);
+inline TickType_t xTaskGetTickCount() { return millis(); }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t);
+const char *pcTaskGetName(TaskHandle_t);
+BaseType_t xTaskNotifyGive(TaskHandle_t);
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t);
+BaseType_t xTaskNotify(TaskHandle_t, uint32_t, int);
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *);
+QueueHandle_t xQueueCreate(UBaseType_t, UBaseType_t);
+BaseType_t xQueueSend(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendToBack(QueueHandle_t, const void *, TickType_t);
+BaseType_t xQueueSendFromISR(QueueHandle_t, const void *, BaseType_t *);
+BaseType_t xQueueReceive(QueueHandle_t, void *, TickType_t);
+BaseType_t xQueuePeek(QueueHandle_t, void *, TickType_t);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t);
+BaseType_t xQueueReset(QueueHandle_t);
+inline int xPortGetCoreID() { return 1; }
+uint32_t uxTaskGetNumberOfTasks();
+typedef struct
+{
+    const char *pcTaskName;
+    UBaseType_t uxCurrentPriority;
+    uint32_t usStackHighWaterMark;
+    int eCurrentState;
+    uint32_t ulRunTimeCounter;
+    BaseType_t xCoreID;
+    TaskHandle_t xHandle;
+    UBaseType_t xTaskNumber;
+} TaskStatus_t;
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *, UBaseType_t, uint32_t *);
+void *pvPortMalloc(size_t);
+void vPortFree(void *);
+
+/****************************************************************************
+ * ESP-IDF
+ */
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define ESP_ERR_NVS_INVALID_LENGTH 0x110c
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+#define ESP_ERROR_CHECK(x) (x)
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) (x)
+const char *esp_err_to_name(esp_err_t err);
+inline void esp_restart() { exit(0); }
+typedef enum
+{
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+#define ESP_RST_PWR_GLITCH ((esp_reset_reason_t)14)
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+int esp_rom_printf(const char *fmt, ...);
+
+int64_t esp_timer_get_time();
+typedef void *esp_timer_handle_t;
+typedef struct
+{
+    void (*callback)(void *);
+    void *arg;
+    int dispatch_method;
+    const char *name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+int esp_timer_create(const esp_timer_create_args_t *, esp_timer_handle_t *);
+int esp_timer_start_once(esp_timer_handle_t, uint64_t);
+int esp_timer_start_periodic(esp_timer_handle_t, uint64_t);
+int esp_timer_stop(esp_timer_handle_t);
+bool esp_timer_is_active(esp_timer_handle_t);
+
+#define MALLOC_CAP_8BIT 4
+#define MALLOC_CAP_INTERNAL 8
+#define MALLOC_CAP_DEFAULT 16
+inline size_t heap_caps_get_free_size(uint32_t) { return 150000; }
+inline size_t heap_caps_get_minimum_free_size(uint32_t) { return 120000; }
+inline size_t heap_caps_get_largest_free_block(uint32_t) { return 110000; }
+inline void *heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline size_t esp_get_free_heap_size() { return 150000; }
+inline size_t esp_get_minimum_free_heap_size() { return 120000; }
+
+// Logging, ESP_LOGx() calls the function set by esp_log_set_vprintf() if level is enabled.
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+typedef int (*vprintf_like_t)(const char *, va_list);
+vprintf_like_t esp_log_set_vprintf(vprintf_like_t func);
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+inline uint32_t esp_log_timestamp() { return millis(); }
+#define ESP_LOGE(tag, fmt, ...) esp_log_write(ESP_LOG_ERROR, tag, "E (%lu) %s: " fmt "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) esp_log_write(ESP_LOG_WARN, tag, "W (%lu) %s: " fmt "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) esp_log_write(ESP_LOG_INFO, tag, "I (%lu) %s: " fmt "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) esp_log_write(ESP_LOG_DEBUG, tag, "D (%lu) %s: " fmt "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+#define ESP_LOGV(tag, fmt, ...) esp_log_write(ESP_LOG_VERBOSE, tag, "V (%lu) %s: " fmt "\n", esp_log_timestamp(), tag, ##__VA_ARGS__)
+
+typedef enum
+{
+    GPIO_NUM_NC = -1,
+    GPIO_NUM_0 = 0,
+    GPIO_NUM_1,
+    GPIO_NUM_2,
+    GPIO_NUM_3,
+    GPIO_NUM_4,
+    GPIO_NUM_5,
+    GPIO_NUM_6,
+    GPIO_NUM_7,
+    GPIO_NUM_8,
+    GPIO_NUM_9,
+    GPIO_NUM_10,
+    GPIO_NUM_11,
+    GPIO_NUM_12,
+    GPIO_NUM_13,
+    GPIO_NUM_14,
+    GPIO_NUM_15,
+    GPIO_NUM_16,
+    GPIO_NUM_17,
+    GPIO_NUM_18,
+    GPIO_NUM_19,
+    GPIO_NUM_20,
+    GPIO_NUM_21,
+    GPIO_NUM_22,
+    GPIO_NUM_23,
+    GPIO_NUM_24,
+    GPIO_NUM_25,
+    GPIO_NUM_26,
+    GPIO_NUM_27,
+    GPIO_NUM_28,
+    GPIO_NUM_29,
+    GPIO_NUM_30,
+    GPIO_NUM_31,
+    GPIO_NUM_32,
+    GPIO_NUM_33,
+    GPIO_NUM_34,
+    GPIO_NUM_35,
+    GPIO_NUM_36,
+    GPIO_NUM_37,
+    GPIO_NUM_38,
+    GPIO_NUM_39,
+} gpio_num_t;
+inline void gpio_reset_pin(gpio_num_t) {}
+
+// No core dump and no panic handler on the host
+typedef struct
+{
+    uint32_t bt[16];
+    uint32_t depth;
+    bool corrupted;
+} esp_core_dump_bt_info_t;
+typedef struct
+{
+    char exc_task[16];
+    uint32_t exc_pc;
+    esp_core_dump_bt_info_t exc_bt_info;
+    uint32_t exc_tcb;
+    uint32_t core_dump_version;
+} esp_core_dump_summary_t;
+inline esp_err_t esp_core_dump_image_get(size_t *, size_t *) { return ESP_ERR_NOT_FOUND; }
+inline esp_err_t esp_core_dump_image_erase() { return ESP_OK; }
+inline esp_err_t esp_core_dump_image_check() { return ESP_ERR_NOT_FOUND; }
+inline esp_err_t esp_core_dump_get_summary(esp_core_dump_summary_t *) { return ESP_ERR_NOT_FOUND; }
+inline void esp_core_dump_init() {}
+typedef struct
+{
+    int reason;
+    int core;
+    int exception;
+    const char *reason_str;
+    void *addr;
+    uint32_t pc;
+    bool backtrace_corrupt;
+    bool backtrace_continues;
+    uint32_t backtrace_len;
+    uint32_t backtrace[16];
+} arduino_panic_info_t;
+inline void set_arduino_panic_handler(void (*)(arduino_panic_info_t *, void *), void *) {}
+
+// NVS
+typedef uint32_t nvs_handle_t;
+typedef enum
+{
+    NVS_READONLY,
+    NVS_READWRITE
+} nvs_open_mode_t;
+typedef enum
+{
+    NVS_TYPE_U8 = 0x01,
+    NVS_TYPE_U32 = 0x04,
+    NVS_TYPE_I32 = 0x14,
+    NVS_TYPE_STR = 0x21,
+    NVS_TYPE_BLOB = 0x42,
+    NVS_TYPE_ANY = 0xff
+} nvs_type_t;
+typedef void *nvs_iterator_t;
+typedef struct
+{
+    char namespace_name[16];
+    char key[16];
+    nvs_type_t type;
+} nvs_entry_info_t;
+typedef struct
+{
+    size_t used_entries;
+    size_t free_entries;
+    size_t available_entries;
+    size_t total_entries;
+    size_t namespace_count;
+} nvs_stats_t;
+#define NVS_KEY_NAME_MAX_SIZE 16
+#define NVS_DEFAULT_PART_NAME "nvs"
+esp_err_t nvs_flash_init();
+esp_err_t nvs_flash_erase();
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *handle);
+void nvs_close(nvs_handle_t handle);
+esp_err_t nvs_commit(nvs_handle_t handle);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_erase_all(nvs_handle_t handle);
+esp_err_t nvs_get_i32(nvs_handle_t handle, const char *key, int32_t *value);
+esp_err_t nvs_set_i32(nvs_handle_t handle, const char *key, int32_t value);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *value, size_t *length);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *value, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_get_stats(const char *part, nvs_stats_t *stats);
+esp_err_t nvs_entry_find(const char *part, const char *name, nvs_type_t type, nvs_iterator_t *it);
+esp_err_t nvs_entry_next(nvs_iterator_t *it);
+esp_err_t nvs_entry_info(nvs_iterator_t it, nvs_entry_info_t *info);
+void nvs_release_iterator(nvs_iterator_t it);
+
+// SNTP and ping
+void sntp_set_sync_interval(uint32_t);
+void sntp_set_time_sync_notification_cb(void (*)(struct timeval *));
+inline bool esp_sntp_enabled() { return false; }
+void esp_sntp_stop();
+inline int sntp_get_sync_status() { return 0; }
+#define SNTP_SYNC_STATUS_COMPLETED 1
+void configTime(long, int, const char *, const char * = nullptr, const char * = nullptr);
+void configTzTime(const char *tz, const char *server1, const char * = nullptr, const char * = nullptr);
+
+// lwip sockets, setsockopt and send/recv are macros on ESP32
+#define SOL_SOCKET 0xfff
+#define SO_SNDBUF 0x1001
+#define SO_KEEPALIVE 0x8
+#define IPPROTO_TCP 6
+#define TCP_NODELAY 1
+#define TCP_KEEPIDLE 3
+#define TCP_KEEPINTVL 4
+#define TCP_KEEPCNT 5
+#define MSG_DONTWAIT 0x8
+#define MSG_PEEK 0x1
+inline int lwip_setsockopt(int, int, int, const void *, uint32_t) { return 0; }
+inline int lwip_getsockopt(int, int, int, void *, uint32_t *) { return 0; }
+#define setsockopt lwip_setsockopt
+#define getsockopt lwip_getsockopt
+inline int lwip_send(int, const void *, size_t len, int) { return len; }
+inline int lwip_recv(int, void *, size_t, int) { return 0; }
+inline int send(int fd, const void *buf, size_t len, int flags) { return lwip_send(fd, buf, len, flags); }
+inline int recv(int fd, void *buf, size_t len, int flags) { return lwip_recv(fd, buf, len, flags); }
+
+// mbedtls, only what session cookies and WebSocket handshake use
+typedef struct
+{
+    int x;
+} mbedtls_sha1_context;
+typedef struct
+{
+    int x;
+} mbedtls_md_context_t;
+typedef struct
+{
+    int x;
+} mbedtls_md_info_t;
+typedef enum
+{
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA1 = 4,
+    MBEDTLS_MD_SHA256 = 6
+} mbedtls_md_type_t;
+void mbedtls_sha1_init(mbedtls_sha1_context *);
+int mbedtls_sha1_starts(mbedtls_sha1_context *);
+int mbedtls_sha1_update(mbedtls_sha1_context *, const unsigned char *, size_t);
+int mbedtls_sha1_finish(mbedtls_sha1_context *, unsigned char[20]);
+void mbedtls_sha1_free(mbedtls_sha1_context *);
+int mbedtls_sha1(const unsigned char *, size_t, unsigned char[20]);
+const mbedtls_md_info_t *mbedtls_md_info_from_type(mbedtls_md_type_t);
+int mbedtls_md_hmac(const mbedtls_md_info_t *, const unsigned char *, size_t, const unsigned char *, size_t, unsigned char *);
+void mbedtls_md_init(mbedtls_md_context_t *);
+int mbedtls_md_setup(mbedtls_md_context_t *, const mbedtls_md_info_t *, int);
+int mbedtls_md_hmac_starts(mbedtls_md_context_t *, const unsigned char *, size_t);
+int mbedtls_md_hmac_update(mbedtls_md_context_t *, const unsigned char *, size_t);
+int mbedtls_md_hmac_finish(mbedtls_md_context_t *, unsigned char *);
+void mbedtls_md_free(mbedtls_md_context_t *);
+
+/****************************************************************************
+ * Arduino ESP32 classes
+ */
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return 150000; }
+    uint32_t getMinFreeHeap() { return 120000; }
+    uint32_t getMaxAllocHeap() { return 110000; }
+    uint32_t getHeapSize() { return 300000; }
+    uint32_t getFreeSketchSpace() { return 0x1E0000; }
+    uint32_t getSketchSize() { return 0x180000; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    uint32_t getFlashChipSize() { return 0x800000; }
+    uint32_t getFlashChipSpeed() { return 80000000; }
+    const char *getChipModel() { return "host"; }
+    uint8_t getChipRevision() { return 0; }
+    uint64_t getEfuseMac() { return 0x0000AABBCCDDEEFFULL; }
+    uint32_t getCycleCount() { return micros() * 240; }
+    String getSketchMD5() { return String("00000000000000000000000000000000"); }
+    uint32_t random() { return esp_random(); }
+    void restart() { exit(0); }
+};
+extern EspClass ESP;
+
+class Ticker
+{
+public:
+    template <class... A> void once_ms(uint32_t, A...) {}
+    template <class... A> void attach_ms(uint32_t, A...) {}
+    template <class... A> void once(float, A...) {}
+    template <class... A> void attach(float, A...) {}
+    void detach() {}
+    bool active() const { return false; }
+};
+
+class MD5Builder
+{
+public:
+    void begin() {}
+    void add(const char *) {}
+    void add(const String &) {}
+    void add(const uint8_t *, size_t) {}
+    void calculate() {}
+    String toString() { return String(); }
+    void getChars(char *) {}
+    void getBytes(uint8_t *) {}
+};
+
+typedef enum
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+} HTTPMethod;
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+};
+enum HTTPAuthMethod
+{
+    BASIC_AUTH,
+    DIGEST_AUTH
+};
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+struct HTTPUpload
+{
+    HTTPUploadStatus status;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize;
+    size_t currentSize;
+    size_t contentLength;
+    uint8_t buf[2048];
+};
+// Accepts handlers and responses.  Request is whatever a benchmark sets in request, response
+// bytes are counted in sent.
+struct hostRequest
+{
+    String uri;
+    HTTPMethod method = HTTP_GET;
+    std::map<std::string, String> headers;
+};
+class WebServer
+{
+public:
+    typedef std::function<void(void)> THandlerFunction;
+    hostRequest request;
+    size_t sent = 0;
+    WebServer(int port = 80) {}
+    void begin() {}
+    void close() {}
+    void stop() {}
+    void handleClient() {}
+    void on(const String &, THandlerFunction) {}
+    void on(const String &, HTTPMethod, THandlerFunction) {}
+    void on(const String &, HTTPMethod, THandlerFunction, THandlerFunction) {}
+    void onNotFound(THandlerFunction) {}
+    void onFileUpload(THandlerFunction) {}
+    String uri() { return request.uri; }
+    HTTPMethod method() { return request.method; }
+    WiFiClient &client() { return _client; }
+    HTTPUpload &upload() { return _upload; }
+    String pathArg(unsigned int) { return String(); }
+    String arg(const String &) { return String(); }
+    String arg(int) { return String(); }
+    String argName(int) { return String(); }
+    int args() { return 0; }
+    bool hasArg(const String &) { return false; }
+    void collectHeaders(const char *[], size_t) {}
+    template <class... A> void collectAllHeaders(A...) {}
+    String header(const String &name)
+    {
+        auto it = request.headers.find(name.s);
+        return (it == request.headers.end()) ? String() : it->second;
+    }
+    String header(int) { return String(); }
+    String headerName(int) { return String(); }
+    int headers() { return request.headers.size(); }
+    bool hasHeader(const String &name) { return request.headers.count(name.s) > 0; }
+    String hostHeader() { return String(); }
+    bool authenticate(const char *, const char *) { return true; }
+    template <class F> bool authenticate(F) { return true; }
+    template <class... A> bool authenticateDigest(A...) { return true; }
+    void requestAuthentication(HTTPAuthMethod = BASIC_AUTH, const char * = NULL, const String & = String("")) {}
+    void send(int, const char *, const String &content) { sent += content.length(); }
+    void send(int, const char *, const char *content) { sent += strlen(content); }
+    void send(int, const String &, const String &content) { sent += content.length(); }
+    void send(int, const char * = NULL) {}
+    void send(int, const char *, const char *, size_t length) { sent += length; }
+    void send(int, const char *, const uint8_t *, size_t length) { sent += length; }
+    void send_P(int, const char *, const char *content) { sent += strlen(content); }
+    void send_P(int, const char *, const char *, size_t length) { sent += length; }
+    void setContentLength(size_t) {}
+    void sendHeader(const String &, const String &, bool = false) {}
+    void sendContent(const String &content) { sent += content.length(); }
+    void sendContent(const char *content) { sent += strlen(content); }
+    void sendContent(const char *, size_t length) { sent += length; }
+    void sendContent_P(const char *content) { sent += strlen(content); }
+    void sendContent_P(const char *, size_t length) { sent += length; }
+    void chunkResponseBegin(const char * = "") {}
+    void chunkResponseEnd() {}
+    void enableDelay(bool) {}
+    void enableCORS(bool) {}
+    void keepAlive(bool) {}
+    void setTimeout(uint32_t) {}
+    int _currentStatus = 0;
+
+private:
+    WiFiClient _client;
+    HTTPUpload _upload;
+};
+
+typedef enum
+{
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+    WIFI_AUTH_WAPI_PSK,
+    WIFI_AUTH_MAX
+} wifi_auth_mode_t;
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL,
+    WL_SCAN_COMPLETED,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_DISCONNECTED
+} wl_status_t;
+typedef enum
+{
+    WIFI_OFF,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA
+} WiFiMode_t;
+typedef enum
+{
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM
+} wifi_ps_type_t;
+typedef enum
+{
+    WIFI_POWER_19_5dBm = 78
+} wifi_power_t;
+typedef enum
+{
+    WIFI_PHY_MODE_11B = 1,
+    WIFI_PHY_MODE_11G,
+    WIFI_PHY_MODE_11N
+} WiFiPhyMode_t;
+typedef int WiFiEvent_t;
+typedef struct
+{
+    int x;
+    struct
+    {
+        struct
+        {
+            int ip_info;
+        } got_ip;
+    } got_ip;
+} WiFiEventInfo_t;
+#define ARDUINO_EVENT_WIFI_STA_DISCONNECTED 5
+#define ARDUINO_EVENT_WIFI_STA_GOT_IP 7
+#define ARDUINO_EVENT_WIFI_STA_GOT_IP6 8
+// Station connected to a network, set connected to false to stop syslog.
+class WiFiClass
+{
+public:
+    bool connected = true;
+    wl_status_t status() { return connected ? WL_CONNECTED : WL_DISCONNECTED; }
+    bool isConnected() { return connected; }
+    IPAddress localIP() { return IPAddress(192, 168, 1, 1); }
+    IPAddress gatewayIP() { return IPAddress(192, 168, 1, 254); }
+    IPAddress subnetMask() { return IPAddress(255, 255, 255, 0); }
+    IPAddress dnsIP(int = 0) { return IPAddress(192, 168, 1, 254); }
+    IPAddress softAPIP() { return IPAddress(); }
+    IPAddress linkLocalIPv6() { return IPAddress(); }
+    IPAddress globalIPv6() { return IPAddress(); }
+    String macAddress() { return String("AA:BB:CC:DD:EE:FF"); }
+    uint8_t *macAddress(uint8_t *mac)
+    {
+        static const uint8_t m[6] = {0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF};
+        memcpy(mac, m, 6);
+        return mac;
+    }
+    String softAPmacAddress() { return macAddress(); }
+    String SSID() { return String("bench"); }
+    String SSID(int) { return SSID(); }
+    String BSSIDstr() { return macAddress(); }
+    String BSSIDstr(int) { return macAddress(); }
+    uint8_t *BSSID(int = 0) { return NULL; }
+    String psk() { return String(); }
+    int32_t RSSI(int = 0) { return -55; }
+    int32_t channel(int = 0) { return 6; }
+    wifi_auth_mode_t encryptionType(int) { return WIFI_AUTH_WPA2_PSK; }
+    int scanNetworks(bool = false, bool = false) { return 0; }
+    int scanComplete() { return 0; }
+    void scanDelete() {}
+    const char *getHostname() { return "ratgdo-bench"; }
+    bool setHostname(const char *) { return true; }
+    bool hostname(const char *) { return true; }
+    bool mode(WiFiMode_t) { return true; }
+    WiFiMode_t getMode() { return WIFI_STA; }
+    bool disconnect(bool = false, bool = false) { return true; }
+    bool softAPdisconnect(bool = false) { return true; }
+    bool softAP(const char *, const char * = NULL, int = 1, int = 0, int = 4) { return true; }
+    bool softAPConfig(IPAddress, IPAddress, IPAddress) { return true; }
+    wl_status_t begin(const char *, const char * = NULL, int32_t = 0, const uint8_t * = NULL, bool = true) { return status(); }
+    bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress()) { return true; }
+    bool setAutoReconnect(bool) { return true; }
+    bool setSleep(bool) { return true; }
+    bool setTxPower(wifi_power_t) { return true; }
+    wifi_power_t getTxPower() { return WIFI_POWER_19_5dBm; }
+    bool setMinSecurity(wifi_auth_mode_t) { return true; }
+    bool enableIPv6(bool = true) { return true; }
+    bool reconnect() { return true; }
+    void persistent(bool) {}
+    int hostByName(const char *, IPAddress &) { return 0; }
+    bool setScanMethod(int) { return true; }
+    bool setSortMethod(int) { return true; }
+    template <class... A> void onEvent(A...) {}
+    struct
+    {
+        template <class... A> bool enableDhcpCaptivePortal(A...) { return true; }
+        template <class... A> bool create(A...) { return true; }
+    } AP;
+};
+extern WiFiClass WiFi;
+
+struct NetworkClass
+{
+    template <class... A> String macAddress(A...) { return WiFi.macAddress(); }
+    template <class... A> void onEvent(A...) {}
+    template <class... A> bool setHostname(A...) { return true; }
+    const char *getHostname() { return WiFi.getHostname(); }
+};
+extern NetworkClass Network;
+
+class MDNSResponder
+{
+public:
+    bool begin(const char *) { return true; }
+    void end() {}
+    bool addService(const char *, const char *, uint16_t) { return true; }
+    bool addServiceTxt(const char *, const char *, const char *, const char *) { return true; }
+    bool addServiceTxt(const char *, const char *, const char *, const String &) { return true; }
+    bool setInstanceName(const char *) { return true; }
+    bool setInstanceName(const String &) { return true; }
+    void enableWorkstation() {}
+};
+extern MDNSResponder MDNS;
+
+class DNSServer
+{
+public:
+    template <class... A> bool start(A...) { return true; }
+    void stop() {}
+    void processNextRequest() {}
+    void setErrorReplyCode(int) {}
+};
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_MOVED_PERMANENTLY 301
+#define HTTP_CODE_FOUND 302
+#define HTTPC_STRICT_FOLLOW_REDIRECTS 1
+class HTTPClient
+{
+public:
+    template <class... A> bool begin(A...) { return true; }
+    int GET() { return -1; }
+    String getString() { return String(); }
+    String getLocation() { return String(); }
+    int getSize() { return 0; }
+    WiFiClient *getStreamPtr() { return nullptr; }
+    String header(const char *) { return String(); }
+    template <class... A> void collectHeaders(A...) {}
+    template <class... A> void setFollowRedirects(A...) {}
+    void setTimeout(int) {}
+    void end() {}
+};
+
+#define U_FLASH 0
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+class UpdateClass
+{
+public:
+    bool begin(size_t, int = U_FLASH, int = -1, uint8_t = LOW, const char * = NULL) { return true; }
+    size_t write(uint8_t *, size_t n) { return n; }
+    bool end(bool = false) { return true; }
+    void abort() {}
+    bool hasError() { return false; }
+    uint8_t getError() { return 0; }
+    const char *errorString() { return ""; }
+    void printError(Print &) {}
+    bool setMD5(const char *) { return true; }
+    bool isRunning() { return false; }
+    bool canRollBack() { return false; }
+    bool rollBack() { return false; }
+};
+extern UpdateClass Update;
+
+// No file system, files are always empty
+class File : public Stream
+{
+public:
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t *, size_t n) override { return n; }
+    using Print::write;
+    operator bool() const { return false; }
+    void close() {}
+    size_t size() const { return 0; }
+    bool seek(uint32_t) { return true; }
+    size_t position() const { return 0; }
+    int read(uint8_t *, size_t) { return 0; }
+    using Stream::read;
+    const char *name() const { return ""; }
+    void truncate(uint32_t) {}
+};
+class FS
+{
+public:
+    bool begin(bool = false) { return true; }
+    void end() {}
+    File open(const char *, const char *) { return File(); }
+    File open(const String &, const char *) { return File(); }
+    bool exists(const char *) { return false; }
+    bool exists(const String &) { return false; }
+    bool remove(const char *) { return true; }
+    bool remove(const String &) { return true; }
+    bool rename(const char *, const char *) { return true; }
+    bool rename(const String &, const char *) { return true; }
+    bool format() { return true; }
+};
+extern FS LittleFS;
+namespace fs
+{
+    typedef ::File File;
+    typedef ::FS FS;
+}
+
+#define DHT22 22
+class DHT
+{
+public:
+    DHT(uint8_t, uint8_t) {}
+    void begin() {}
+    float readTemperature(bool = false) { return NAN; }
+    float readHumidity() { return NAN; }
+};
+
+/****************************************************************************
+ * HomeSpan
+ */
+struct SpanCharacteristic
+{
+    template <class T = int> T getVal() { return T(); }
+    template <class T = int> T getNewVal() { return T(); }
+    template <class T> void setVal(T, bool = true) {}
+    bool updated() { return false; }
+    template <class... A> SpanCharacteristic *setRange(A...) { return this; }
+    template <class... A> SpanCharacteristic *setValidValues(A...) { return this; }
+    SpanCharacteristic *setDescription(const char *) { return this; }
+    SpanCharacteristic *setUnit(const char *) { return this; }
+    uint32_t timeVal() { return 0; }
+};
+struct SpanService
+{
+    SpanService *setPrimary() { return this; }
+    SpanService *addLink(SpanService *) { return this; }
+    virtual boolean update() { return true; }
+    virtual void loop() {}
+    virtual ~SpanService() {}
+};
+struct SpanAccessory
+{
+    SpanAccessory(uint32_t = 0) {}
+};
+#define HOST_CHARACTERISTIC(n) \
+    struct n : SpanCharacteristic \
+    {                             \
+        template <class... A>     \
+        n(A...) {}
+namespace Characteristic
+{
+    HOST_CHARACTERISTIC(CurrentDoorState) enum { OPEN = 0, CLOSED = 1, OPENING = 2, CLOSING = 3, STOPPED = 4 }; };
+    HOST_CHARACTERISTIC(TargetDoorState) enum { OPEN = 0, CLOSED = 1 }; };
+    HOST_CHARACTERISTIC(LockCurrentState) enum { UNLOCKED = 0, LOCKED = 1, JAMMED = 2, UNKNOWN = 3 }; };
+    HOST_CHARACTERISTIC(LockTargetState) enum { UNLOCK = 0, LOCK = 1 }; };
+    HOST_CHARACTERISTIC(ObstructionDetected) enum { NOT_DETECTED = 0, DETECTED = 1 }; };
+    HOST_CHARACTERISTIC(On) enum { OFF = 0, ON = 1 }; };
+    HOST_CHARACTERISTIC(MotionDetected) enum { NOT_DETECTED = 0, DETECTED = 1 }; };
+    HOST_CHARACTERISTIC(OccupancyDetected) enum { NOT_DETECTED = 0, DETECTED = 1 }; };
+    HOST_CHARACTERISTIC(CurrentTemperature) };
+    HOST_CHARACTERISTIC(CurrentRelativeHumidity) };
+    HOST_CHARACTERISTIC(Name) };
+    HOST_CHARACTERISTIC(Manufacturer) };
+    HOST_CHARACTERISTIC(SerialNumber) };
+    HOST_CHARACTERISTIC(Model) };
+    HOST_CHARACTERISTIC(FirmwareRevision) };
+    HOST_CHARACTERISTIC(Identify) };
+    HOST_CHARACTERISTIC(ConfiguredName) };
+}
+namespace Service
+{
+    struct GarageDoorOpener : SpanService {};
+    struct AccessoryInformation : SpanService {};
+    struct LightBulb : SpanService {};
+    struct MotionSensor : SpanService {};
+    struct OccupancySensor : SpanService {};
+    struct TemperatureSensor : SpanService {};
+    struct HumiditySensor : SpanService {};
+    struct HAPProtocolInformation : SpanService {};
+}
+typedef enum
+{
+    HS_WIFI_NEEDED,
+    HS_WIFI_CONNECTING,
+    HS_PAIRING_NEEDED,
+    HS_PAIRED,
+    HS_ENTERING_CONFIG_MODE,
+    HS_CONFIG_MODE_EXIT,
+    HS_CONFIG_MODE_REBOOT,
+    HS_CONFIG_MODE_LAUNCH_AP,
+    HS_CONFIG_MODE_UNPAIR,
+    HS_CONFIG_MODE_ERASE_WIFI,
+    HS_CONFIG_MODE_EXIT_SELECTED,
+    HS_CONFIG_MODE_REBOOT_SELECTED,
+    HS_CONFIG_MODE_LAUNCH_AP_SELECTED,
+    HS_CONFIG_MODE_UNPAIR_SELECTED,
+    HS_CONFIG_MODE_ERASE_WIFI_SELECTED,
+    HS_REBOOTING,
+    HS_FACTORY_RESET,
+    HS_AP_STARTED,
+    HS_AP_CONNECTED,
+    HS_AP_TERMINATED,
+    HS_OTA_STARTED,
+    HS_WIFI_SCANNING,
+    HS_ETH_CONNECTING
+} HS_STATUS;
+namespace Category
+{
+    enum
+    {
+        Bridges = 2,
+        GarageDoorOpeners = 4
+    };
+}
+// Every setter accepts anything and returns itself, so chained calls compile.
+class Span
+{
+public:
+    template <class... A> Span &begin(A...) { return *this; }
+    template <class... A> Span &setLogLevel(A...) { return *this; }
+    template <class... A> Span &setHostNameSuffix(A...) { return *this; }
+    template <class... A> Span &setPortNum(A...) { return *this; }
+    template <class... A> Span &setQRID(A...) { return *this; }
+    template <class... A> Span &setPairingCode(A...) { return *this; }
+    template <class... A> Span &setStatusCallback(A...) { return *this; }
+    template <class... A> Span &setPairCallback(A...) { return *this; }
+    template <class... A> Span &setWifiCallback(A...) { return *this; }
+    template <class... A> Span &setWifiCallbackAll(A...) { return *this; }
+    template <class... A> Span &setConnectionCallback(A...) { return *this; }
+    template <class... A> Span &setSketchVersion(A...) { return *this; }
+    template <class... A> Span &setMaxConnections(A...) { return *this; }
+    template <class... A> Span &setSerialInputDisable(A...) { return *this; }
+    template <class... A> Span &setControllerCallback(A...) { return *this; }
+    template <class... A> Span &setVerboseWifiReconnect(A...) { return *this; }
+    template <class... A> Span &setLogger(A...) { return *this; }
+    template <class... A> Span &setWifiBegin(A...) { return *this; }
+    template <class... A> Span &setGetCharacteristicsCallback(A...) { return *this; }
+    template <class... A> Span &enableWebLog(A...) { return *this; }
+    template <class... A> Span &setTimeServerTimeout(A...) { return *this; }
+    template <class... A> Span &setStatusAutoOff(A...) { return *this; }
+    template <class... A> Span &setApFunction(A...) { return *this; }
+    template <class... A> Span &enableAutoStartAP(A...) { return *this; }
+    template <class... A> Span &setHostName(A...) { return *this; }
+    template <class... A> Span &processSerialCommand(A...) { return *this; }
+    template <class... A> Span &deleteStoredValues(A...) { return *this; }
+    template <class... A> Span &resetIID(A...) { return *this; }
+    template <class... A> Span &setWifiCredentials(A...) { return *this; }
+    template <class... A> void autoPoll(A...) {}
+    void poll() {}
+    const char *statusString(HS_STATUS) { return ""; }
+    bool compareIIDs() { return true; }
+    int getLogLevel() { return 0; }
+    TaskHandle_t getAutoPollTask() { return nullptr; }
+    void markSketchOK() {}
+    const char *getSketchVersion() { return ""; }
+    bool updateDatabase(bool = true) { return true; }
+    bool deleteAccessory(uint32_t) { return true; }
+};
+extern Span homeSpan;
+struct SpanUserCommand
+{
+    template <class... A> SpanUserCommand(A...) {}
+};
+
+/****************************************************************************
+ * magic_enum, names are only used for diagnostics
+ */
+namespace magic_enum
+{
+    template <class E> std::string_view enum_name(E) { return "?"; }
+    template <class E> std::optional<E> enum_cast(std::string_view) { return std::nullopt; }
+    template <class E> std::optional<E> enum_cast(int) { return std::nullopt; }
+    template <class E> constexpr auto enum_integer(E e) { return (int)e; }
+}
@@ -0,0 +1,34 @@
+#!/usr/bin/env python3
+#
+# Runs build_web_content.py outside of PlatformIO, to generate webcontent.h for the host
+# benchmarks.  Run from the project directory with the build directory as argument, the
+# header is written to <build directory>/host/www/include/webcontent.h
+#
+import builtins
+import os
+import sys
+
+
+class Env(dict):
+    def GetOption(self, option):
+        return False
+
+    def Append(self, **kwargs):
+        pass
+
+
+class _Return(Exception):
+    pass
+
+
+def Return():
+    raise _Return()
+
+
+builtins.Import = lambda name: None
+env = Env(PROJECT_BUILD_DIR=sys.argv[1], PIOENV="host", PROJECT_DIR=os.getcwd())
+script = "build_web_content.py"
+try:
+    exec(compile(open(script).read(), script, "exec"), {"env": env, "Return": Return, "__name__": "__main__"})
+except _Return:
+    pass
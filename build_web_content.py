@@ -14,6 +14,12 @@ import base64
 import zlib
 import gzip
 
+# brotli is optional, if the module is not installed we only build gzip variants.
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
 #platformio
 Import("env")
 
@@ -77,11 +83,26 @@ wf = open(includepath  + "/webcontent.h", "w")
 wf.write("/**************************************\n")
 wf.write(" * Autogenerated DO NOT EDIT\n")
 wf.write(" **************************************/\n")
-wf.write("#include <unordered_map>\n")
-wf.write("#include <string>\n")
+wf.write("#include <stdint.h>\n")
+wf.write("#include <string.h>\n")
 wf.flush()
 
+# Assets are streamed from flash in chunks that fit in a single TCP segment.
+CHUNK_SIZE = 1436
+
+def writeArray(wf, name, data):
+    wf.write("const unsigned char %s[] PROGMEM = {\n" % name)
+    for i in range(0, len(data), 12):
+        if i > 0 and i % CHUNK_SIZE < 12:
+            wf.write("  // chunk %d\n" % (i // CHUNK_SIZE))
+        wf.write('  ' + ''.join('0x%02X,' % b for b in data[i:i + 12]) + '\n')
+    wf.write('};\n')
+    wf.write("const unsigned int %s_len = %d;\n\n" % (name, len(data)))
+
 varnames = []
+lengths = {}
+brLengths = {}
+sizes = []
 # now loop through each file...
 for file in filenames:
     # skip hidden files
@@ -120,22 +141,25 @@ for file in filenames:
             f_out.close()
    
     # create the 'c' code
-    # const unsigned char src_www_build_apple_touch_icon_png_gz[] PROGMEM = {
-    # const unsigned int src_www_build_apple_touch_icon_png_gz_len = 2721;
-    wf.write("const unsigned char %s[] PROGMEM = {\n" % varname.replace(".", "_").replace("/", "_").replace("-", "_") )
-    count = 0
+    # const unsigned char www_apple_touch_icon_png_gz[] PROGMEM = {
+    # const unsigned int www_apple_touch_icon_png_gz_len = 2721;
+    var = varname.replace(".", "_").replace("/", "_").replace("-", "_")
     with open(gzfile, 'rb') as f:
-        bytes_read = f.read(12)
-        while bytes_read:
-            count = count + len(bytes_read)
-            wf.write('  ')
-            for b in bytes_read:
-                wf.write('0x%02X,' % b)
-            wf.write('\n')
-            bytes_read = f.read(12)
-    
-    wf.write('};\n')
-    wf.write("const unsigned int %s_len = %d;\n\n" % (varname.replace(".", "_").replace("/", "_").replace("-", "_"), count) )
+        gzdata = f.read()
+    with gzip.open(gzfile, 'rb') as f:
+        raw = f.read()
+    writeArray(wf, var, gzdata)
+    lengths[var] = len(gzdata)
+    # brotli variant, only worth the extra flash if it is meaningfully smaller than gzip
+    brLengths[var] = 0
+    if brotli:
+        brdata = brotli.compress(raw, quality=11)
+        if len(brdata) < len(gzdata) - len(gzdata) // 16:
+            with open(targetpath + "/" + file + ".br", 'wb') as f:
+                f.write(brdata)
+            writeArray(wf, var[:-3] + "_br", brdata)
+            brLengths[var] = len(brdata)
+    sizes.append((file, len(raw), len(gzdata), brLengths[var]))
 
 wf.flush()
 
@@ -159,39 +183,150 @@ const char type_css[]  PROGMEM = "text/css";
 const char type_js[]   PROGMEM = "text/javascript";
 const char type_mjs[]  PROGMEM = "text/javascript";
 const char type_json[] PROGMEM = "application/json";
+const char type_cbor[] PROGMEM = "application/cbor";
 const char type_webmanifest[] PROGMEM = "application/manifest+json";
 // Must be at least one more than max string above...
 #define MAX_MIME_TYPE_LEN 32
 """
 )
 
-# Use an unordered_map so we can lookup the data, length and type based on filename...
+# Browser cache control, time in seconds after which browser cache invalid.
+# This is used for CSS, HTML, JS and IMAGE file types.  Set to 30 days !!
+CACHE_CONTROL = 60 * 60 * 24 * 30
+
+mimetypes = {
+    "svg": "image/svg+xml", "bmp": "image/bmp", "gif": "image/gif", "jpeg": "image/jpeg",
+    "jpg": "image/jpeg", "png": "image/png", "tiff": "image/tiff", "tif": "image/tiff",
+    "ico": "image/x-icon", "txt": "text/plain", "": "text/plain", "htm": "text/html",
+    "html": "text/html", "css": "text/css", "js": "text/javascript", "mjs": "text/javascript",
+    "json": "application/json", "webmanifest": "application/manifest+json",
+}
+
+# Build complete HTTP response headers for each file at compile time, so that the
+# server has nothing to format when sending a page.
+def responseHeaders(file, length, etag, encoding, vary):
+    t = file.rpartition(".")[-1] if file.find(".") > 0 else ""
+    mime = mimetypes.get(t, "text/plain")
+    cache = CACHE_CONTROL > 0 and (t in ("css", "html", "htm", "js") or mime.startswith("image"))
+    cacheHdr = ("max-age=%d" % CACHE_CONTROL) if cache else "no-cache, no-store"
+    etagHdr = ("ETag: %s\r\n" % etag) if cache else ""
+    varyHdr = "Vary: Accept-Encoding\r\n" if vary else ""
+    ok = ("HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Encoding: %s\r\nCache-Control: %s\r\n%s%s"
+          "Content-Length: %d\r\nConnection: close\r\n\r\n" % (mime, encoding, cacheHdr, etagHdr, varyHdr, length))
+    notModified = ("HTTP/1.1 304 Not Modified\r\nCache-Control: %s\r\n%s%sConnection: close\r\n\r\n" % (cacheHdr, etagHdr, varyHdr))
+    return t, cache, ok, notModified
+
+# Perfect hash, FNV-1a with a seed that we search for so that every file name lands
+# in its own slot of the lookup table.  The slot is taken from the top bits of the hash
+# as low bits of FNV only depend on low bits of the input.  Must match webcontent_find() below.
+def fnv1a(seed, name):
+    h = seed
+    for c in name.encode():
+        h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+    return h
+
+tableBits = 1
+while (1 << tableBits) < len(varnames) * 2:
+    tableBits += 1
+tableSize = 1 << tableBits
+seed = 2166136261
+while len({fnv1a(seed, f) >> (32 - tableBits) for f, v, c in varnames}) != len(varnames):
+    seed = (seed + 1) & 0xFFFFFFFF
+table = [-1] * tableSize
+for n, (file, var, crc32) in enumerate(varnames):
+    table[fnv1a(seed, file) >> (32 - tableBits)] = n
+print("perfect hash seed 0x%08X, %d files in %d slots" % (seed, len(varnames), tableSize))
+
 wf.write(
     """
-struct pageContent
+#define WEBCONTENT_CHUNK_SIZE %d
+
+struct pageVariant
 {
-    const unsigned char *data;
+    const unsigned char *data;  // nullptr if there is no variant for this encoding
     const unsigned int length;
-    const char *type;
-    const std::string crc32;
+    const char *etag;
+    const char *header;         // complete HTTP 200 response header
+    const unsigned int headerLength;
+    const char *notModified;    // complete HTTP 304 response
+    const unsigned int notModifiedLength;
 };
 
-const std::unordered_map<std::string, pageContent> webcontent = {
-    """
+struct pageContent
+{
+    const char *name;
+    const char *type;
+    const bool cache;
+    const pageVariant gzip;
+    const pageVariant br;
+};
+""" % CHUNK_SIZE
 )
-n = 0
+
+def escape(text):
+    return text.replace("\r", "\\r").replace("\n", "\\n")
+
+variants = {}
 for file, var, crc32 in varnames:
-    t = ""
-    if file.find(".") > 0:
-        t = file.rpartition(".")[-1]
-    # Need comma at end of every line except last one...
+    hasBr = brLengths[var] > 0
+    variants[var] = [("gz", var, lengths[var], crc32, "gzip")]
+    if hasBr:
+        variants[var].append(("br", var[:-3] + "_br", brLengths[var], crc32 + ".br", "br"))
+    for suffix, data, length, etag, encoding in variants[var]:
+        t, cache, ok, notModified = responseHeaders(file, length, etag, encoding, hasBr)
+        wf.write('const char %s_hdr[] PROGMEM = "%s";\n' % (data, escape(ok)))
+        wf.write('const char %s_304[] PROGMEM = "%s";\n' % (data, escape(notModified)))
+
+wf.write("\nconst pageContent webcontent[] = {")
+for n, (file, var, crc32) in enumerate(varnames):
+    entries = []
+    for suffix, data, length, etag, encoding in variants[var]:
+        t, cache, ok, notModified = responseHeaders(file, length, etag, encoding, len(variants[var]) > 1)
+        entries.append('{ %s, %s_len, "%s", %s_hdr, %d, %s_304, %d }' %
+                       (data, data, etag, data, len(ok), data, len(notModified)))
+    if len(entries) < 2:
+        entries.append("{ nullptr, 0, nullptr, nullptr, 0, nullptr, 0 }")
     if n > 0:
         wf.write(",")
-    wf.write('\n  { "' + file + '", {' + var + ", " + var + "_len, type_" + t + ', "' + crc32 + '"' + "} }")
-    n = n + 1
+    wf.write('\n  { "%s", type_%s, %s,\n    %s,\n    %s }' %
+             (file, t, "true" if cache else "false", entries[0], entries[1]))
+wf.write("\n};\n")
+
+wf.write("\n#define WEBCONTENT_HASH_SEED 0x%08XUL\n" % seed)
+wf.write("#define WEBCONTENT_TABLE_BITS %d\n" % tableBits)
+wf.write("#define WEBCONTENT_TABLE_SIZE %d\n" % tableSize)
+wf.write("const int16_t webcontent_table[WEBCONTENT_TABLE_SIZE] = {" + ", ".join(str(i) for i in table) + "};\n")
+wf.write(
+    """
+inline uint32_t webcontent_hash(const char *name)
+{
+    uint32_t h = WEBCONTENT_HASH_SEED;
+    while (*name)
+        h = (h ^ (uint8_t)*name++) * 16777619UL;
+    return h;
+}
+
+// Returns nullptr if page is not one of our files.
+inline const pageContent *webcontent_find(const char *page)
+{
+    int16_t i = webcontent_table[webcontent_hash(page) >> (32 - WEBCONTENT_TABLE_BITS)];
+    if (i < 0 || strcmp(webcontent[i].name, page))
+        return nullptr;
+    return &webcontent[i];
+}
+"""
+)
 
 # All done, close the file...
-wf.write("\n\n};\n")
 wf.close()
 
+# Report compressed sizes, so that growth of any asset is visible in the build log
+print("%-28s %8s %8s %8s %7s" % ("file", "raw", "gzip", "brotli", "chunks"))
+for file, raw, gz, br in sorted(sizes, key=lambda x: -x[1]):
+    sent = br if br > 0 else gz
+    print("%-28s %8d %8d %8s %7d" % (file, raw, gz, br if br > 0 else "-", (sent + CHUNK_SIZE - 1) // CHUNK_SIZE))
+print("%-28s %8d %8d %8d" % ("total", sum(x[1] for x in sizes), sum(x[2] for x in sizes),
+                             sum(x[3] if x[3] > 0 else x[2] for x in sizes)))
+if not brotli:
+    print("brotli module not installed, only gzip variants built (pip install brotli)")
 print("processed " + str(len(varnames)) + " files")
@@ -44,6 +44,11 @@
 
 #define LINE_BUFFER_SIZE 256
 
+// Every log line is given a sequence number so clients can request just the lines
+// added after a cursor.  We keep the buffer offset of the most recent lines, sized
+// so that it covers the whole message buffer (log lines are rarely less than 32 bytes).
+#define LOG_INDEX_SIZE (LOG_BUFFER_SIZE / 32)
+
 #define SYSLOG_LOCAL0 16
 
 extern bool syslogEn;
@@ -103,10 +108,52 @@ extern "C" void logToBuffer_P(const char *fmt, ...);
 
 #endif
 
+// Accumulated cost of logging, so we can quantify the impact of log calls in hot code paths.
+// Time spent in each stage is only collected when built with -D LOG_STATS.
+typedef struct logStats
+{
+    uint32_t count[ESP_LOG_VERBOSE + 1];   // lines logged, by level
+#ifdef LOG_STATS
+    uint64_t totalUs[ESP_LOG_VERBOSE + 1]; // total microseconds in logToBuffer(), by level
+    uint32_t maxUs[ESP_LOG_VERBOSE + 1];   // longest microseconds in logToBuffer(), by level
+    uint64_t formatUs;                     // time formatting the line and timestamp
+    uint64_t serialUs;                     // time writing to serial port
+    uint64_t bufferUs;                     // time copying into message buffer
+    uint64_t broadcastUs;                  // time sending to SSE subscribers and syslog
+#endif
+    uint32_t bytes;                        // total bytes logged
+    uint32_t wraps;                        // number of times message buffer wrapped
+    uint32_t suppressed;                   // lines dropped by rate limiting
+    uint32_t evicted;                      // lines dropped at call sites no longer tracked
+    uint32_t since;                        // millis() when statistics last reset
+} logStats;
+
+// Per call site rate limiting of log messages, so a fault that logs on every loop
+// does not evict all useful history from the message buffer or flood syslog.
+// Errors and warnings are exempt.
+#define LOG_RATE_SITES 16  // number of call sites tracked
+#define LOG_RATE_BURST 20  // lines a call site can log in a burst
+#define LOG_RATE_PER_SEC 5 // sustained lines per second for a call site
+typedef struct logRateSite
+{
+    const char *fmt;     // format string identifies the call site
+    uint32_t tokens;     // lines available, in 1/1000ths of a line
+    uint32_t lastMillis; // millis() when tokens were last refilled
+    uint32_t suppressed; // lines dropped since call site last logged
+    uint32_t total;      // lines dropped since statistics last reset
+} logRateSite;
+
 class LOG
 {
 private:
-    char *lineBuffer = NULL; // Buffer for single message line
+    char *lineBuffer = NULL;    // Buffer for single message line
+    uint32_t *lineIndex = NULL; // Ring of absolute buffer offsets, indexed by sequence number
+    uint32_t lineSeq = 0;       // Sequence number of most recent line, first line is 1
+    uint32_t totalWritten = 0;  // Total bytes written to msgBuffer (modulo multiple of buffer size)
+    logStats stats;             // Cost of logging
+    uint32_t dropped = 0;       // Lines dropped by rate limiting since boot, not reset with stats
+    uint32_t evictedSuppressed = 0; // Lines dropped at call sites whose slot was reused, not yet reported
+    logRateSite rateSites[LOG_RATE_SITES];
 #ifndef ESP8266
     // ESP8266 is single thread and inherently serialized.  No mutex semaphores
     SemaphoreHandle_t logMutex = NULL;
@@ -114,6 +161,7 @@ private:
 
     static LOG *instancePtr;
     LOG();
+    bool rateLimited(const char *fmt, uint32_t *suppressed);
 
 public:
     logBuffer *msgBuffer = NULL; // Buffer to save log messages as they occur
@@ -137,10 +185,18 @@ public:
     void printSavedLog(File file, Print &outputDev, bool slow = true);
 #endif
     void printMessageLog(Print &outDevice = Serial, bool slow = true);
+    void printMessageLogHeader(Print &outDevice = Serial);
+    uint32_t printMessagesSince(Print &outDevice, uint32_t after, uint32_t upTo, esp_log_level_t level = ESP_LOG_VERBOSE, const char *tag = nullptr, const char *match = nullptr);
+    uint32_t getSequence() { return lineSeq; };
+    uint32_t getDropped() { return dropped; };
     void clearCrashLog();
     void printCrashLog(Print &outDevice = Serial);
     void saveMessageLog();
+    void printStats(Print &outDevice = Serial);
+    void resetStats();
 };
 extern LOG *ratgdoLogger;
 
 extern void esp_log_hook(const char *fmt, va_list args);
+extern esp_log_level_t logLineLevel(const char *line);
+extern bool logLineHasTag(const char *line, const char *tags);
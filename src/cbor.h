@@ -0,0 +1,135 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+/****************************************************************************
+ * Bounded, allocation free, CBOR (RFC 8949) writer for a single flat map of
+ * string keys to integer, boolean or string values.  The map is written with
+ * indefinite length so members do not need to be counted up front.  Like the
+ * JsonWriter a member that will not fit is left out and overflow() reports it.
+ */
+class CborWriter
+{
+private:
+    uint8_t *p;
+    uint8_t *start;
+    uint8_t *end;      // one past last byte of buffer
+    bool lost = false; // a member did not fit
+    bool closed = false;
+
+    enum : uint8_t
+    {
+        MAJOR_UINT = 0 << 5,
+        MAJOR_NINT = 1 << 5,
+        MAJOR_TEXT = 3 << 5,
+        MAJOR_MAP = 5 << 5,
+        SIMPLE_FALSE = 0xF4,
+        SIMPLE_TRUE = 0xF5,
+        SIMPLE_NULL = 0xF6,
+        MAP_INDEFINITE = MAJOR_MAP | 31,
+        BREAK = 0xFF,
+    };
+
+    // Keep space for the break byte that closes the map
+    inline bool fits(size_t n) { return (size_t)(end - p) > n; }
+
+    // Major type with its argument in shortest form
+    bool putHead(uint8_t major, uint64_t v)
+    {
+        int extra = (v < 24) ? 0 : (v <= 0xFF) ? 1 : (v <= 0xFFFF) ? 2 : (v <= 0xFFFFFFFF) ? 4 : 8;
+        if (!fits(1 + extra))
+            return false;
+        if (extra == 0)
+        {
+            *p++ = major | (uint8_t)v;
+            return true;
+        }
+        *p++ = major | ((extra == 1) ? 24 : (extra == 2) ? 25 : (extra == 4) ? 26 : 27);
+        for (int i = extra - 1; i >= 0; i--)
+            *p++ = (uint8_t)(v >> (i * 8));
+        return true;
+    }
+
+    bool putText(const char *s)
+    {
+        size_t len = strlen(s);
+        if (!putHead(MAJOR_TEXT, len) || !fits(len))
+            return false;
+        memcpy(p, s, len);
+        p += len;
+        return true;
+    }
+
+    bool putByte(uint8_t b)
+    {
+        if (!fits(1))
+            return false;
+        *p++ = b;
+        return true;
+    }
+
+    bool done(uint8_t *mark, bool ok)
+    {
+        if (!ok)
+        {
+            p = mark;
+            lost = true;
+        }
+        return ok;
+    }
+
+public:
+    CborWriter(uint8_t *buf, size_t size) : p(buf), start(buf), end(buf + size)
+    {
+        *p++ = MAP_INDEFINITE;
+    }
+
+    bool addUint(const char *k, uint64_t v)
+    {
+        uint8_t *mark = p;
+        return done(mark, putText(k) && putHead(MAJOR_UINT, v));
+    }
+
+    bool addInt(const char *k, int64_t v)
+    {
+        uint8_t *mark = p;
+        return done(mark, putText(k) && ((v < 0) ? putHead(MAJOR_NINT, (uint64_t)(-1 - v)) : putHead(MAJOR_UINT, v)));
+    }
+
+    bool addBool(const char *k, bool v)
+    {
+        uint8_t *mark = p;
+        return done(mark, putText(k) && putByte(v ? SIMPLE_TRUE : SIMPLE_FALSE));
+    }
+
+    bool addStr(const char *k, const char *v)
+    {
+        uint8_t *mark = p;
+        return done(mark, putText(k) && ((v) ? putText(v) : putByte(SIMPLE_NULL)));
+    }
+
+    // Close the map, returns length.
+    size_t finish()
+    {
+        if (!closed)
+        {
+            *p++ = BREAK;
+            closed = true;
+        }
+        return p - start;
+    }
+
+    size_t length() const { return p - start; }
+    bool overflow() const { return lost; }
+};
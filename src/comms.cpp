@@ -33,6 +33,7 @@
 #include "secplus2.h"
 #include "Packet.h"
 #include "drycontact.h"
+#include "metrics.h"
 #endif // USE_GDOLIB
 
 #ifdef ESP8266
@@ -163,8 +164,8 @@ void cancel_builtin_TTC_countdown()
         ESP_LOGI(TAG, "Ending automatic close countdown timer");
         builtInTTCcountdown.detach();
     }
-    garage_door.builtInTTCremaining = 0;
-    garage_door.builtInTTChold = false;
+    GDO_SET(builtInTTCremaining, 0, GDO_CHANGED_TTC_REMAINING);
+    GDO_SET(builtInTTChold, false, GDO_CHANGED_TTC_HOLD);
 }
 
 struct DoorHistory openHistory = {0};
@@ -380,6 +381,13 @@ void sec1_poll_status(uint8_t sec1PollCmd);
 #ifdef ESP32
 void receiveErrorHandler(hardwareSerial_error_t error);
 #endif
+
+// Frame counts for /metrics, registered in setup_comms()
+static metric *gdoRxFrames = NULL;
+static metric *gdoTxFrames = NULL;
+static metric *gdoDecodeErrors = NULL;
+static metric *gdoTxErrors = NULL;
+static metric *gdoUartErrors = NULL;
 #endif // not USE_GDOLIB
 
 void manual_recovery();
@@ -463,7 +471,7 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     case GDO_CB_EVENT_BATTERY:
         ESP_LOGI(TAG, "GDO event: battery: %s", gdo_battery_state_to_string(status->battery));
-        garage_door.batteryState = status->battery;
+        GDO_SET(batteryState, status->battery, GDO_CHANGED_BATTERY);
         break;
     case GDO_CB_EVENT_BUTTON:
         ESP_LOGI(TAG, "GDO event: button: %s", gdo_button_state_to_string(status->button));
@@ -475,7 +483,7 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
         break;
     case GDO_CB_EVENT_OPENINGS:
         ESP_LOGI(TAG, "GDO event: openings: %d", status->openings);
-        garage_door.openingsCount = status->openings;
+        GDO_SET(openingsCount, status->openings, GDO_CHANGED_OPENINGS);
         break;
     case GDO_CB_EVENT_SET_TTC:
         ESP_LOGI(TAG, "GDO event: set TTC: %d", status->ttc_seconds);
@@ -495,11 +503,11 @@ static void gdo_event_handler(const gdo_status_t *status, gdo_cb_event_t event,
                  status->paired_devices.total_all);
         break;
     case GDO_CB_EVENT_OPEN_DURATION_MEASUREMENT:
-        garage_door.openDuration = (status->open_ms + 500) / 1000; // round up/down to closest second
+        GDO_SET(openDuration, (status->open_ms + 500) / 1000, GDO_CHANGED_OPEN_DURATION); // round up/down to closest second
         ESP_LOGI(TAG, "GDO event: open duration: %d seconds (%s)", garage_door.openDuration, timeString());
         break;
     case GDO_CB_EVENT_CLOSE_DURATION_MEASUREMENT:
-        garage_door.closeDuration = (status->close_ms + 500) / 1000; // round up/down to closest second
+        GDO_SET(closeDuration, (status->close_ms + 500) / 1000, GDO_CHANGED_CLOSE_DURATION); // round up/down to closest second
         ESP_LOGI(TAG, "GDO event: close duration: %d seconds (%s)", garage_door.closeDuration, timeString());
         break;
     default:
@@ -567,6 +575,12 @@ void setup_comms()
     // need to make more space available for initialization.
     txQueueCreate();
 
+    gdoRxFrames = metric_counter("ratgdo_gdo_rx_frames_total", "Messages received from garage door opener");
+    gdoTxFrames = metric_counter("ratgdo_gdo_tx_frames_total", "Messages sent to garage door opener");
+    gdoDecodeErrors = metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"decode\"");
+    gdoTxErrors = metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"tx\"");
+    gdoUartErrors = metric_counter("ratgdo_gdo_errors_total", "Garage door opener communication errors", "reason=\"uart\"");
+
     // set to output (not currently used (prob not ported over) using now for new disconnect of wall panel)
     pinMode(STATUS_DOOR_PIN, OUTPUT);
 
@@ -763,8 +777,8 @@ void setup_comms()
     }
     else
     {
-        garage_door.openDuration = (doorMedian(openHistory.duration, std::min(openHistory.count, DOOR_MAX_HISTORY)) + 500) / 1000;    // round up/down to closest second
-        garage_door.closeDuration = (doorMedian(closeHistory.duration, std::min(closeHistory.count, DOOR_MAX_HISTORY)) + 500) / 1000; // round up/down to closest second
+        GDO_SET(openDuration, (doorMedian(openHistory.duration, std::min(openHistory.count, DOOR_MAX_HISTORY)) + 500) / 1000, GDO_CHANGED_OPEN_DURATION);    // round up/down to closest second
+        GDO_SET(closeDuration, (doorMedian(closeHistory.duration, std::min(closeHistory.count, DOOR_MAX_HISTORY)) + 500) / 1000, GDO_CHANGED_CLOSE_DURATION); // round up/down to closest second
     }
     ESP_LOGI(TAG, "Door open history (%d):  %lums, %lums, %lums, %lums, %lums, %lums; Median: %dsecs", openHistory.count,
              openHistory(1), openHistory(2), openHistory(3), openHistory(4), openHistory(5), openHistory(6), garage_door.openDuration);
@@ -820,6 +834,8 @@ void save_rolling_code()
     write_door_int(nvram_rolling, rolling_code);
     last_saved_code = rolling_code;
 #endif // !USE_GDOLIB
+    // Must not be lost in a crash, reusing a rolling code the GDO has seen locks us out.
+    sync_door_data();
 }
 
 void reset_door()
@@ -940,7 +956,7 @@ void wallPlate_Emulation()
         if (!emulateWallPanel && !wallPanelDetected)
         {
             emulateWallPanel = true;
-            garage_door.wallPanelEmulated = true;
+            GDO_SET(wallPanelEmulated, true, GDO_CHANGED_SEC1_EMULATED);
             ESP_LOGI(TAG, "No DIGITAL wall panel detected. Switching to emulation mode.");
         }
     }
@@ -989,7 +1005,7 @@ void update_door_state(GarageDoorCurrentState current_state)
             ESP_LOGI(TAG, "Door closing, canceling TTC delay timer");
             TTCtimer.detach();
             // This will force us to send current state to browser, so it reports correct state.
-            last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+            gdo_changed(GDO_CHANGED_DOOR_STATE);
         }
         // If we were in a automatic close timeout, cancel and reset that.
         cancel_builtin_TTC_countdown();
@@ -1026,7 +1042,7 @@ void update_door_state(GarageDoorCurrentState current_state)
         {
             openHistory.duration[openHistory.count++ % DOOR_MAX_HISTORY] = duration;
             uint32_t median = doorMedian(openHistory.duration, std::min(openHistory.count, DOOR_MAX_HISTORY));
-            garage_door.openDuration = (median + 500) / 1000; // round up/down to closest second
+            GDO_SET(openDuration, (median + 500) / 1000, GDO_CHANGED_OPEN_DURATION); // round up/down to closest second
             ESP_LOGI(TAG, "Door open duration: %lums, History: %lums, %lums, %lums, %lums, %lums; Median: %lums (%s)",
                      duration, openHistory(2), openHistory(3), openHistory(4), openHistory(5), openHistory(6),
                      median, timeString());
@@ -1050,7 +1066,7 @@ void update_door_state(GarageDoorCurrentState current_state)
         {
             closeHistory.duration[closeHistory.count++ % DOOR_MAX_HISTORY] = duration;
             uint32_t median = doorMedian(closeHistory.duration, std::min(closeHistory.count, DOOR_MAX_HISTORY));
-            garage_door.closeDuration = (median + 500) / 1000; // round up/down to closest second
+            GDO_SET(closeDuration, (median + 500) / 1000, GDO_CHANGED_CLOSE_DURATION); // round up/down to closest second
             ESP_LOGI(TAG, "Door close duration: %lums, History: %lums, %lums, %lums, %lums, %lums; Median: %lums (%s)",
                      duration, closeHistory(2), closeHistory(3), closeHistory(4), closeHistory(5), closeHistory(6),
                      median, timeString());
@@ -1381,7 +1397,7 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
         else if (lastLightState == 0xFF)
         {
             // Force update of light state in any listening client
-            last_reported_garage_door.light = !garage_door.light;
+            gdo_changed(GDO_CHANGED_LIGHT);
         }
 
         if (value != prevLightLock)
@@ -1415,12 +1431,12 @@ void sec1_process_message(uint8_t key, uint8_t value = 0xFF)
 
             if (lockState)
             {
-                garage_door.current_lock = CURR_LOCKED;
+                GDO_SET(current_lock, CURR_LOCKED, GDO_CHANGED_LOCK_STATE);
                 garage_door.target_lock = TGT_LOCKED;
             }
             else
             {
-                garage_door.current_lock = CURR_UNLOCKED;
+                GDO_SET(current_lock, CURR_UNLOCKED, GDO_CHANGED_LOCK_STATE);
                 garage_door.target_lock = TGT_UNLOCKED;
             }
             notify_homekit_target_lock(garage_door.target_lock);
@@ -1522,6 +1538,7 @@ bool process_send_queue()
 void receiveErrorHandler(hardwareSerial_error_t error)
 {
     // ESP_LOGD(TAG, "-- onReceiveError: [ERR#%d:%s]", error, uartErrorStrings[error]);
+    metric_inc(gdoUartErrors);
 
     if (error == hardwareSerial_error_t::UART_PARITY_ERROR)
     {
@@ -1587,6 +1604,7 @@ readIn:
                 ESP_LOGD(TAG, "SEC1 RX Parity error [0x%02X]", ser_byte);
 
             // toss message, start over
+            metric_inc(gdoUartErrors);
             reading_msg = false;
             continue;
         }
@@ -1616,6 +1634,7 @@ readIn:
         case secplus1Codes::LockButtonPress:
         case secplus1Codes::LockButtonRelease:
         {
+            metric_inc(gdoRxFrames);
             sec1_process_message(ser_byte);
             reading_msg = false; // reset start of message
             break;
@@ -1648,11 +1667,13 @@ readIn:
                 ESP_LOGV(TAG, "SEC1 RX IDLE:%lums - MSG: 0x%02X:0x%02X (%lums)", (uint32_t)(msg_complete - lastTime), sec1cmd, ser_byte, (uint32_t)(msg_complete - msg_start));
                 lastTime = msg_complete;
 
+                metric_inc(gdoRxFrames);
                 sec1_process_message(sec1cmd, ser_byte);
                 reading_msg = false; // reset start of message
             }
             else
             {
+                metric_inc(gdoDecodeErrors);
                 ESP_LOGD(TAG, "SEC1 RX invalid cmd byte 0x%02X", ser_byte);
             }
             break;
@@ -1708,6 +1729,7 @@ void comms_loop_sec2()
 
         static _millis_t lastStatusPkt = 0;
         // We have a full packet, process it.
+        metric_inc(gdoRxFrames);
         Packet pkt = Packet(reader.fetch_buf());
         pkt.print();
 
@@ -1951,7 +1973,7 @@ void comms_loop_sec2()
 
         case PacketCommand::Battery:
         {
-            garage_door.batteryState = (uint8_t)pkt.m_data.value.battery.state;
+            GDO_SET(batteryState, (uint8_t)pkt.m_data.value.battery.state, GDO_CHANGED_BATTERY);
             break;
         }
 
@@ -1960,7 +1982,7 @@ void comms_loop_sec2()
             if (pkt.m_data.value.openings.flags == 0)
             {
                 // Apparently flags must be zero... to indicate a reply to our request
-                garage_door.openingsCount = pkt.m_data.value.openings.count;
+                GDO_SET(openingsCount, pkt.m_data.value.openings.count, GDO_CHANGED_OPENINGS);
             }
             break;
         }
@@ -1990,7 +2012,7 @@ void comms_loop_sec2()
             if (secs >= 60)
             {
                 ESP_LOGI(TAG, "Set built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
+                GDO_SET(builtInTTC, secs, GDO_CHANGED_BUILTIN_TTC);
                 userConfig->set(cfg_builtInTTC, secs);
                 ESP8266_SAVE_CONFIG();
             }
@@ -2011,22 +2033,23 @@ void comms_loop_sec2()
             {
                 // If higher than what we have saved, then we need to update our saved value.
                 ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
+                GDO_SET(builtInTTC, secs, GDO_CHANGED_BUILTIN_TTC);
                 userConfig->set(cfg_builtInTTC, secs);
                 ESP8266_SAVE_CONFIG();
             }
 
             if ((garage_door.current_state == GarageDoorCurrentState::CURR_OPENING || garage_door.current_state == GarageDoorCurrentState::CURR_OPEN) && secs > 0)
             {
-                garage_door.builtInTTCremaining = secs;
-                garage_door.builtInTTChold = false;
+                GDO_SET(builtInTTCremaining, secs, GDO_CHANGED_TTC_REMAINING);
+                GDO_SET(builtInTTChold, false, GDO_CHANGED_TTC_HOLD);
                 if (!builtInTTCcountdown.active())
                 {
                     ESP_LOGI(TAG, "Start automatic close countdown timer");
                     // start a timer that will count down number of seconds remaining in built-in automatic close timer.
                     builtInTTCcountdown.attach_ms(1000, []()
                                                   { if (garage_door.builtInTTChold) return;
-                                                    if (--garage_door.builtInTTCremaining == 0)builtInTTCcountdown.detach(); });
+                                                    if (--garage_door.builtInTTCremaining == 0)builtInTTCcountdown.detach();
+                                                    gdo_changed(GDO_CHANGED_TTC_REMAINING); });
                 }
             }
             else
@@ -2044,7 +2067,7 @@ void comms_loop_sec2()
             case CancelTtcState::Cancel:
             {
                 cancel_builtin_TTC_countdown();
-                garage_door.builtInTTC = 0;
+                GDO_SET(builtInTTC, 0, GDO_CHANGED_BUILTIN_TTC);
                 userConfig->set(cfg_builtInTTC, 0);
                 ESP8266_SAVE_CONFIG();
                 break;
@@ -2053,12 +2076,12 @@ void comms_loop_sec2()
             {
                 if (builtInTTCcountdown.active())
                 {
-                    garage_door.builtInTTChold = !garage_door.builtInTTChold;
+                    GDO_SET(builtInTTChold, !garage_door.builtInTTChold, GDO_CHANGED_TTC_HOLD);
                     ESP_LOGI(TAG, "Automatic close time-to-close hold %s %d seconds remaining", garage_door.builtInTTChold ? "at" : "released at", garage_door.builtInTTCremaining);
                 }
                 else
                 {
-                    garage_door.builtInTTChold = false;
+                    GDO_SET(builtInTTChold, false, GDO_CHANGED_TTC_HOLD);
                     ESP_LOGI(TAG, "Received unexpected CancelTtc hold as countdown not active");
                 }
                 break;
@@ -2079,7 +2102,7 @@ void comms_loop_sec2()
             if (secs > 60 && secs != userConfig->getBuiltInTTC())
             {
                 ESP_LOGI(TAG, "Update built-in automatic time-to-close to %d seconds", secs);
-                garage_door.builtInTTC = secs;
+                GDO_SET(builtInTTC, secs, GDO_CHANGED_BUILTIN_TTC);
                 userConfig->set(cfg_builtInTTC, secs);
                 ESP8266_SAVE_CONFIG();
             }
@@ -2119,6 +2142,7 @@ void comms_loop_sec2()
         case PacketCommand::Unknown:
         {
             // Typically occurs if there is a fail-to-decode packet error.  This could be a regular status update.
+            metric_inc(gdoDecodeErrors);
             // If it has been more than 5 minutes since the last status packet then request GDO to resend one, or
             // if we are in the middle of an open or close sequence as we might have missed the state change to open or closed.
             if (_millis() - lastStatusPkt > (5 * 60 * 1000) ||
@@ -2294,6 +2318,7 @@ bool transmitSec1(byte toSend)
     // aprox 10ms to write byte
     // every byte we send echos, but want the echo on polls to id the GDO response
     Sec1Serial.write(toSend);
+    metric_inc(gdoTxFrames);
     // timestamp tx
     last_tx = _millis();
     // byte sent
@@ -2322,6 +2347,7 @@ bool transmitSec1(byte toSend)
             if (echoByte != toSend)
             {
                 ESP_LOGD(TAG, "SEC1 TX MISMATCH ECHO OF: tx:0x%02X rx:0x%02X", toSend, echoByte);
+                metric_inc(gdoTxErrors);
                 success = false;
             }
             else
@@ -2371,6 +2397,7 @@ bool transmitSec2(PacketAction &pkt_ac)
     if (digitalRead(UART_RX_PIN))
     {
         ESP_LOGI(TAG, "Collision detected, waiting to send packet");
+        metric_inc(gdoTxErrors);
         return false;
     }
 
@@ -2385,12 +2412,14 @@ bool transmitSec2(PacketAction &pkt_ac)
     if (pkt_ac.pkt.encode(rolling_code, buf) != 0)
     {
         ESP_LOGE(TAG, "Could not encode packet");
+        metric_inc(gdoTxErrors);
     }
     else
     {
         // Use LED to signal activity
         led.flash(FLASH_ACTIVITY_MS);
         sw_serial.write(buf, SECPLUS2_CODE_LEN);
+        metric_inc(gdoTxFrames);
         delayMicroseconds(100);
         // timestamp tx
         last_tx = _millis();
@@ -2590,7 +2619,7 @@ GarageDoorCurrentState open_door()
         // Reset light to state it was at before delay start.
         set_light(TTCwasLightOn);
         // This will force us to send current state to browser, so it reports correct state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        gdo_changed(GDO_CHANGED_DOOR_STATE);
         return GarageDoorCurrentState::CURR_OPEN;
     }
 
@@ -2598,8 +2627,8 @@ GarageDoorCurrentState open_door()
     if (garage_door.current_state == GarageDoorCurrentState::CURR_OPEN)
     {
         ESP_LOGI(TAG, "Door already open; ignored request");
-        // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        // Flag as changed so we will update browser with actual state.
+        gdo_changed(GDO_CHANGED_DOOR_STATE);
         return GarageDoorCurrentState::CURR_OPEN;
     }
 
@@ -2702,6 +2731,7 @@ void delayFnCall(uint32_t ms, void (*callback)())
     TTCwasLightOn = garage_door.light; // Current state of light
     ESP_LOGI(TAG, "Start function delay timer for %lums (%d iterations)", ms, TTCiterations);
     TTCendTime = _millis() + (_millis_t)ms;
+    gdo_changed(GDO_CHANGED_TTC_ACTIVE);
     TTCtimer.attach_ms(TTCinterval, [callback, light]()
                        {
 #ifdef ESP8266
@@ -2722,8 +2752,8 @@ GarageDoorCurrentState close_door(bool bypass_ttc)
     if (garage_door.current_state == GarageDoorCurrentState::CURR_CLOSED)
     {
         ESP_LOGI(TAG, "Door already closed; ignored request");
-        // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF;
+        // Flag as changed so we will update browser with actual state.
+        gdo_changed(GDO_CHANGED_DOOR_STATE);
         return GarageDoorCurrentState::CURR_CLOSED;
     }
 
@@ -2919,8 +2949,8 @@ bool set_lock(bool value, bool verify)
     if (verify && (garage_door.current_lock == ((value) ? LockCurrentState::CURR_LOCKED : LockCurrentState::CURR_UNLOCKED)))
     {
         ESP_LOGI(TAG, "Remote locks already %s; ignored request", (value) ? "locked" : "unlocked");
-        // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
+        // Flag as changed so we will update browser with actual state.
+        gdo_changed(GDO_CHANGED_LOCK_STATE);
         return false;
     }
 
@@ -2939,8 +2969,8 @@ bool set_lock(bool value, bool verify)
     if (verify && (garage_door.current_lock == ((value) ? LockCurrentState::CURR_LOCKED : LockCurrentState::CURR_UNLOCKED)))
     {
         ESP_LOGI(TAG, "Remote locks already %s; ignored request", (value) ? "locked" : "unlocked");
-        // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.current_lock = (LockCurrentState)0xFF;
+        // Flag as changed so we will update browser with actual state.
+        gdo_changed(GDO_CHANGED_LOCK_STATE);
         return false;
     }
 
@@ -3001,8 +3031,8 @@ bool set_light(bool value, bool verify)
         gdo_light_on_check(verify);
     else
         gdo_light_off_check(verify);
-    // Reset last reported to we will update browser with actual state.
-    last_reported_garage_door.light = !value;
+    // Flag as changed so we will update browser with actual state.
+    gdo_changed(GDO_CHANGED_LIGHT);
     return true;
 }
 #else
@@ -3054,8 +3084,8 @@ bool set_light(bool value, bool verify)
     if (verify && (garage_door.light == value))
     {
         ESP_LOGI(TAG, "Light already %s; ignored request", (value) ? "on" : "off");
-        // Reset last reported to we will update browser with actual state.
-        last_reported_garage_door.light = !value;
+        // Flag as changed so we will update browser with actual state.
+        gdo_changed(GDO_CHANGED_LIGHT);
         return false;
     }
 
@@ -3168,7 +3198,7 @@ void obstruction_timer()
             obstruction_sensor.pin_ever_changed = true;
             if (!garage_door.pinModeObstructionSensor)
             {
-                garage_door.pinModeObstructionSensor = true;
+                GDO_SET(pinModeObstructionSensor, true, GDO_CHANGED_PIN_OBST);
                 ESP_LOGI(TAG, "Pin-based obstruction detection active");
             }
 
@@ -13,6 +13,9 @@
  *
  */
 
+// C/C++ language includes
+#include <algorithm>
+
 // ESP system files
 #ifdef ESP8266
 #include <LittleFS.h>
@@ -22,6 +25,7 @@
 #include <nvs_flash.h>
 #include <nvs.h>
 #include <ESPmDNS.h>
+#include <esp_rom_crc.h>
 #endif
 
 // RATGDO project includes
@@ -62,9 +66,10 @@ nvRamClass *nvRam = nvRamClass::getInstance();
 #define TAKE_MUTEX()
 #define GIVE_MUTEX()
 #else
-// ESP32 is multi-core, need to serialize access to JSON buffers
-#define TAKE_MUTEX() xSemaphoreTake(mutex, portMAX_DELAY)
-#define GIVE_MUTEX() xSemaphoreGive(mutex)
+// ESP32 is multi-core, need to serialize set's.  Recursive as a transaction holds the
+// mutex while helper functions call set.
+#define TAKE_MUTEX() xSemaphoreTakeRecursive(mutex, portMAX_DELAY)
+#define GIVE_MUTEX() xSemaphoreGiveRecursive(mutex)
 #endif
 
 bool setDeviceName(const std::string &key, const char *name, configSetting *action)
@@ -225,7 +230,7 @@ bool helperLogLevel(const std::string &key, const char *value, configSetting *ac
 bool helperBuiltInTTC(const std::string &key, const char *value, configSetting *action)
 {
     userConfig->set(key, value);
-    garage_door.builtInTTC = userConfig->getBuiltInTTC();
+    GDO_SET(builtInTTC, userConfig->getBuiltInTTC(), GDO_CHANGED_BUILTIN_TTC);
 #ifdef USE_GDOLIB
     if (!userConfig->getBuiltInTTC())
     {
@@ -347,7 +352,7 @@ userSettings::userSettings()
     LittleFS.begin();
     snprintf_P(default_device_name, sizeof(default_device_name), PSTR("Garage Door %06X"), ESP.getChipId());
 #else
-    mutex = xSemaphoreCreateMutex(); // need to serialize set's
+    mutex = xSemaphoreCreateRecursiveMutex(); // need to serialize set's
     uint8_t mac[6];
     Network.macAddress(mac);
     snprintf(default_device_name, sizeof(default_device_name), "Garage Door %02X%02X%02X", mac[3], mac[4], mac[5]);
@@ -355,145 +360,209 @@ userSettings::userSettings()
     strlcpy(device_name, default_device_name, sizeof(device_name));
     make_rfc952(device_name_rfc952, default_device_name, sizeof(device_name_rfc952));
     IRAM_START(TAG);
-    char *localIPBuf = static_cast<char *>(malloc(IP4ADDR_STRLEN_MAX));
-    strlcpy(localIPBuf, "0.0.0.0", 16);
-    char *subnetMaskBuf = static_cast<char *>(malloc(IP4ADDR_STRLEN_MAX));
-    strlcpy(subnetMaskBuf, "0.0.0.0", 16);
-    char *gatewayIPBuf = static_cast<char *>(malloc(IP4ADDR_STRLEN_MAX));
-    strlcpy(gatewayIPBuf, "0.0.0.0", 16);
-    char *nameserverIPBuf = static_cast<char *>(malloc(IP4ADDR_STRLEN_MAX));
-    strlcpy(nameserverIPBuf, "0.0.0.0", 16);
-    char *syslogIPBuf = static_cast<char *>(malloc(IP4ADDR_STRLEN_MAX));
-    strlcpy(syslogIPBuf, "0.0.0.0", 16);
-    char *timezoneBuf = static_cast<char *>(malloc(64));
-    *timezoneBuf = (char)0;
-    char *usernameBuf = static_cast<char *>(malloc(32));
-    strlcpy(usernameBuf, "admin", 32);
-    char *credentialsBuf = static_cast<char *>(malloc(36));
-    strlcpy(credentialsBuf, "10d3c00fa1e09696601ef113b99f8a87", 36);
+    // String defaults are copied into the first snapshot below
+    char *localIPBuf = (char *)"0.0.0.0";
+    char *subnetMaskBuf = (char *)"0.0.0.0";
+    char *gatewayIPBuf = (char *)"0.0.0.0";
+    char *nameserverIPBuf = (char *)"0.0.0.0";
+    char *syslogIPBuf = (char *)"0.0.0.0";
+    char *timezoneBuf = (char *)"";
+    char *usernameBuf = (char *)"admin";
+    char *credentialsBuf = (char *)"10d3c00fa1e09696601ef113b99f8a87";
 #ifdef USE_DHT22
-    char *dht22TempFormatBuf = static_cast<char *>(malloc(2));
-    strlcpy(dht22TempFormatBuf, "C", 2);
+    char *dht22TempFormatBuf = (char *)"C";
 #endif
     //  key, {reboot, wifiChanged, value, fn to call}
-    settings = {
-        {cfg_deviceName, {false, false, (configStr){DEVICE_NAME_SIZE, default_device_name}, setDeviceName}}, // call fn to set global
-        {cfg_wifiChanged, {true, true, false, NULL}},
-        {cfg_wifiPower, {true, true, WIFI_POWER_MAX, helperWiFiPower}}, // call fn to set reboot only if setting changed
-        {cfg_wifiPhyMode, {true, true, 0, helperWiFiPhyMode}},          // call fn to set reboot only if setting changed
-        {cfg_staticIP, {true, true, false, NULL}},
-        {cfg_localIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, localIPBuf}, NULL}},
-        {cfg_subnetMask, {true, true, (configStr){IP4ADDR_STRLEN_MAX, subnetMaskBuf}, NULL}},
-        {cfg_gatewayIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, gatewayIPBuf}, NULL}},
-        {cfg_nameserverIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, nameserverIPBuf}, NULL}},
-        {cfg_passwordRequired, {false, false, false, NULL}},
-        {cfg_wwwUsername, {false, false, (configStr){32, usernameBuf}, NULL}},
-        //  Credentials are MD5 Hash... server.credentialHash(username, realm, "password");
-        {cfg_wwwCredentials, {false, false, (configStr){36, credentialsBuf}, NULL}},
-        {cfg_GDOSecurityType, {true, false, 2, helperGDOSecurityType}}, // call fn to reset door
-        {cfg_TTCseconds, {false, false, 5, NULL}},
-        {cfg_TTClight, {false, false, true, NULL}},
-        {cfg_rebootSeconds, {true, true, 0, NULL}},
-        {cfg_LEDidle, {false, false, 0, helperLEDidle}},               // call fn to set LED object
-        {cfg_motionTriggers, {false, false, 0, helperMotionTriggers}}, // call fn to enable HomeSpan service
-        {cfg_enableNTP, {true, false, false, NULL}},
-        {cfg_doorUpdateAt, {false, false, 0, NULL}},
-        {cfg_doorOpenAt, {false, false, 0, NULL}},
-        {cfg_doorCloseAt, {false, false, 0, NULL}},
-        // Will contain string of region/city and POSIX code separated by semicolon...
-        // For example... "America/New_York;EST5EDT,M3.2.0,M11.1.0"
-        // Current maximum string length is known to be 60 chars (+ null terminator), see JavaScript console log.
-        {cfg_timeZone, {false, false, (configStr){64, timezoneBuf}, helperTimeZone}}, // call fn to set system time zone
-        {cfg_softAPmode, {true, false, false, NULL}},
-        {cfg_syslogEn, {false, false, false, helperSyslogEn}}, // call fn to set globals
-        {cfg_syslogIP, {false, false, (configStr){IP4ADDR_STRLEN_MAX, syslogIPBuf}, NULL}},
-        {cfg_syslogPort, {false, false, 514, helperSyslogPort}},                   // call fn to set global
-        {cfg_syslogFacility, {false, false, SYSLOG_LOCAL0, helperSyslogFacility}}, // call fn to set global
-        {cfg_logLevel, {false, false, ESP_LOG_INFO, helperLogLevel}},              // call fn to set log level
-        {cfg_dcOpenClose, {true, false, false, NULL}},
-        {cfg_dcBypassTTC, {false, false, false, NULL}},
-        {cfg_useToggle, {false, false, false, NULL}},
-        {cfg_dcDebounceDuration, {true, false, 50, NULL}},
-        {cfg_obstFromStatus, {true, false, false, NULL}},
+    entry(ConfigKey::deviceName) = {cfg_deviceName, {false, false, (configStr){DEVICE_NAME_SIZE, default_device_name}, setDeviceName}}; // call fn to set global
+    entry(ConfigKey::wifiChanged) = {cfg_wifiChanged, {true, true, false, NULL}};
+    entry(ConfigKey::wifiPower) = {cfg_wifiPower, {true, true, WIFI_POWER_MAX, helperWiFiPower}}; // call fn to set reboot only if setting changed
+    entry(ConfigKey::wifiPhyMode) = {cfg_wifiPhyMode, {true, true, 0, helperWiFiPhyMode}}; // call fn to set reboot only if setting changed
+    entry(ConfigKey::staticIP) = {cfg_staticIP, {true, true, false, NULL}};
+    entry(ConfigKey::localIP) = {cfg_localIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, localIPBuf}, NULL}};
+    entry(ConfigKey::subnetMask) = {cfg_subnetMask, {true, true, (configStr){IP4ADDR_STRLEN_MAX, subnetMaskBuf}, NULL}};
+    entry(ConfigKey::gatewayIP) = {cfg_gatewayIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, gatewayIPBuf}, NULL}};
+    entry(ConfigKey::nameserverIP) = {cfg_nameserverIP, {true, true, (configStr){IP4ADDR_STRLEN_MAX, nameserverIPBuf}, NULL}};
+    entry(ConfigKey::passwordRequired) = {cfg_passwordRequired, {false, false, false, NULL}};
+    entry(ConfigKey::wwwUsername) = {cfg_wwwUsername, {false, false, (configStr){32, usernameBuf}, NULL}};
+    //  Credentials are MD5 Hash... server.credentialHash(username, realm, "password");
+    entry(ConfigKey::wwwCredentials) = {cfg_wwwCredentials, {false, false, (configStr){36, credentialsBuf}, NULL}};
+    entry(ConfigKey::GDOSecurityType) = {cfg_GDOSecurityType, {true, false, 2, helperGDOSecurityType}}; // call fn to reset door
+    entry(ConfigKey::TTCseconds) = {cfg_TTCseconds, {false, false, 5, NULL}};
+    entry(ConfigKey::TTClight) = {cfg_TTClight, {false, false, true, NULL}};
+    entry(ConfigKey::rebootSeconds) = {cfg_rebootSeconds, {true, true, 0, NULL}};
+    entry(ConfigKey::LEDidle) = {cfg_LEDidle, {false, false, 0, helperLEDidle}}; // call fn to set LED object
+    entry(ConfigKey::motionTriggers) = {cfg_motionTriggers, {false, false, 0, helperMotionTriggers}}; // call fn to enable HomeSpan service
+    entry(ConfigKey::enableNTP) = {cfg_enableNTP, {true, false, false, NULL}};
+    entry(ConfigKey::doorUpdateAt) = {cfg_doorUpdateAt, {false, false, 0, NULL}};
+    entry(ConfigKey::doorOpenAt) = {cfg_doorOpenAt, {false, false, 0, NULL}};
+    entry(ConfigKey::doorCloseAt) = {cfg_doorCloseAt, {false, false, 0, NULL}};
+    // Will contain string of region/city and POSIX code separated by semicolon...
+    // For example... "America/New_York;EST5EDT,M3.2.0,M11.1.0"
+    // Current maximum string length is known to be 60 chars (+ null terminator), see JavaScript console log.
+    entry(ConfigKey::timeZone) = {cfg_timeZone, {false, false, (configStr){64, timezoneBuf}, helperTimeZone}}; // call fn to set system time zone
+    entry(ConfigKey::softAPmode) = {cfg_softAPmode, {true, false, false, NULL}};
+    entry(ConfigKey::syslogEn) = {cfg_syslogEn, {false, false, false, helperSyslogEn}}; // call fn to set globals
+    entry(ConfigKey::syslogIP) = {cfg_syslogIP, {false, false, (configStr){IP4ADDR_STRLEN_MAX, syslogIPBuf}, NULL}};
+    entry(ConfigKey::syslogPort) = {cfg_syslogPort, {false, false, 514, helperSyslogPort}}; // call fn to set global
+    entry(ConfigKey::syslogFacility) = {cfg_syslogFacility, {false, false, SYSLOG_LOCAL0, helperSyslogFacility}}; // call fn to set global
+    entry(ConfigKey::logLevel) = {cfg_logLevel, {false, false, ESP_LOG_INFO, helperLogLevel}}; // call fn to set log level
+    entry(ConfigKey::dcOpenClose) = {cfg_dcOpenClose, {true, false, false, NULL}};
+    entry(ConfigKey::dcBypassTTC) = {cfg_dcBypassTTC, {false, false, false, NULL}};
+    entry(ConfigKey::useToggle) = {cfg_useToggle, {false, false, false, NULL}};
+    entry(ConfigKey::dcDebounceDuration) = {cfg_dcDebounceDuration, {true, false, 50, NULL}};
+    entry(ConfigKey::obstFromStatus) = {cfg_obstFromStatus, {true, false, false, NULL}};
 #ifdef RATGDO32_DISCO
-        {cfg_vehicleThreshold, {false, false, 100, helperVehicleThreshold}}, // call fn to set globals
-        {cfg_vehicleHomeKit, {false, false, false, helperVehicleHomeKit}},   // call fn to enable/disable HomeKit accessories
-    {cfg_vehicleOccupancyHomeKit, {false, false, true, helperVehicleOccupancyHomeKit}}, // granular control for occupancy sensor
-    {cfg_vehicleArrivingHomeKit, {false, false, true, helperVehicleArrivingHomeKit}},   // granular control for arriving motion sensor
-    {cfg_vehicleDepartingHomeKit, {false, false, true, helperVehicleDepartingHomeKit}}, // granular control for departing motion sensor
-        {cfg_laserEnabled, {false, false, false, helperLaser}},
-        {cfg_laserHomeKit, {false, false, true, helperLaser}}, // call fn to enable/disable HomeKit accessories
-        {cfg_assistDuration, {false, false, 60, NULL}},
+    entry(ConfigKey::vehicleThreshold) = {cfg_vehicleThreshold, {false, false, 100, helperVehicleThreshold}}; // call fn to set globals
+    entry(ConfigKey::vehicleHomeKit) = {cfg_vehicleHomeKit, {false, false, false, helperVehicleHomeKit}}; // call fn to enable/disable HomeKit accessories
+    entry(ConfigKey::vehicleOccupancyHomeKit) = {cfg_vehicleOccupancyHomeKit, {false, false, true, helperVehicleOccupancyHomeKit}}; // granular control for occupancy sensor
+    entry(ConfigKey::vehicleArrivingHomeKit) = {cfg_vehicleArrivingHomeKit, {false, false, true, helperVehicleArrivingHomeKit}}; // granular control for arriving motion sensor
+    entry(ConfigKey::vehicleDepartingHomeKit) = {cfg_vehicleDepartingHomeKit, {false, false, true, helperVehicleDepartingHomeKit}}; // granular control for departing motion sensor
+    entry(ConfigKey::laserEnabled) = {cfg_laserEnabled, {false, false, false, helperLaser}};
+    entry(ConfigKey::laserHomeKit) = {cfg_laserHomeKit, {false, false, true, helperLaser}}; // call fn to enable/disable HomeKit accessories
+    entry(ConfigKey::assistDuration) = {cfg_assistDuration, {false, false, 60, NULL}};
 #endif
 #ifdef USE_GDOLIB
-        {cfg_useSWserial, {true, false, true, helperUseSWserial}}, // call fn to shut down GDO before switch
+    entry(ConfigKey::useSWserial) = {cfg_useSWserial, {true, false, true, helperUseSWserial}}; // call fn to shut down GDO before switch
 #endif
-        {cfg_builtInTTC, {false, false, 0, helperBuiltInTTC}},
+    entry(ConfigKey::builtInTTC) = {cfg_builtInTTC, {false, false, 0, helperBuiltInTTC}};
 #ifndef ESP8266
-        // These features not available on ESP8266
-        {cfg_occupancyDuration, {false, false, 0, helperOccupancyDuration}}, // call fn to enable/disable HomeKit accessories
-        {cfg_enableIPv6, {true, false, false, NULL}},
-        {cfg_homespanCLI, {false, false, false, helperHomeSpanCLI}}, // call fn to enable/disable HomeSpan CLI and Improv
-        {cfg_lightHomeKit, {false, false, true, helperLightHomeKit}},   // call fn to enable/disable HomeKit light accessory (default: enabled)
-        {cfg_motionHomeKit, {false, false, true, helperMotionHomeKit}}, // call fn to enable/disable HomeKit motion accessory (default: enabled)
+    // These features not available on ESP8266
+    entry(ConfigKey::occupancyDuration) = {cfg_occupancyDuration, {false, false, 0, helperOccupancyDuration}}; // call fn to enable/disable HomeKit accessories
+    entry(ConfigKey::enableIPv6) = {cfg_enableIPv6, {true, false, false, NULL}};
+    entry(ConfigKey::homespanCLI) = {cfg_homespanCLI, {false, false, false, helperHomeSpanCLI}}; // call fn to enable/disable HomeSpan CLI and Improv
+    entry(ConfigKey::lightHomeKit) = {cfg_lightHomeKit, {false, false, true, helperLightHomeKit}}; // call fn to enable/disable HomeKit light accessory (default: enabled)
+    entry(ConfigKey::motionHomeKit) = {cfg_motionHomeKit, {false, false, true, helperMotionHomeKit}}; // call fn to enable/disable HomeKit motion accessory (default: enabled)
 #endif
 #ifdef USE_DHT22
-        {cfg_dht22Pin, {true, false, -1, NULL}}, // DHT22 sensor GPIO pin, -1 = disabled
-        {cfg_dht22TempFormat, {false, false, (configStr){2, dht22TempFormatBuf}, NULL}}, // "C" or "F"
+    entry(ConfigKey::dht22Pin) = {cfg_dht22Pin, {true, false, -1, NULL}}; // DHT22 sensor GPIO pin, -1 = disabled
+    entry(ConfigKey::dht22TempFormat) = {cfg_dht22TempFormat, {false, false, (configStr){2, dht22TempFormatBuf}, NULL}}; // "C" or "F"
 #endif
-    };
+    // Lay out strings and fill the first snapshot with default values
+    configSnapshot *first = &snapshots[0];
+    memset(first, 0, sizeof(configSnapshot));
+    uint16_t offset = 0;
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
+    {
+        configEntry &it = settings[i];
+        if (!it.key)
+        {
+            ESP_LOGE(TAG, "No default for user setting index %d", i);
+            it.key = "";
+        }
+        if (std::holds_alternative<configStr>(it.setting.value))
+        {
+            const configStr &dflt = std::get<configStr>(it.setting.value);
+            if (offset + dflt.max > CONFIG_STR_SIZE || dflt.max > CONFIG_STR_MAX)
+            {
+                ESP_LOGE(TAG, "No space for user setting %s, increase CONFIG_STR_SIZE or CONFIG_STR_MAX", it.key);
+                it.setting.value = (configStr){1, (char *)""};
+                it.offset = CONFIG_STR_SIZE - 1;
+                continue;
+            }
+            it.offset = offset;
+            offset += dflt.max;
+            strlcpy(first->str + it.offset, dflt.str, dflt.max);
+            first->value[i] = 0;
+        }
+        else if (std::holds_alternative<int>(it.setting.value))
+            first->value[i] = std::get<int>(it.setting.value);
+        else
+            first->value[i] = std::get<bool>(it.setting.value) ? 1 : 0;
+    }
+    for (uint8_t i = 0; i < CONFIG_SNAPSHOTS; i++)
+    {
+        busy[i] = false;
+#ifndef ESP8266
+        readers[i] = 0;
+#endif
+    }
+    busy[0] = true;
+    current.store(first);
+    draft.store(NULL);
     IRAM_END(TAG);
 }
 
+// Value of key in snapshot, as the type it is defined with.
+std::variant<bool, int, configStr> userSettings::valueOf(const configSnapshot *snap, ConfigKey key)
+{
+    const configEntry &it = entry(key);
+    if (std::holds_alternative<configStr>(it.setting.value))
+        return (configStr){std::get<configStr>(it.setting.value).max, (char *)snap->str + it.offset};
+    if (std::holds_alternative<int>(it.setting.value))
+        return (int)snap->value[(uint8_t)key];
+    return (bool)(snap->value[(uint8_t)key] != 0);
+}
+
+configString userSettings::getStr(ConfigKey key)
+{
+    configString copy;
+    const configSnapshot *snap = pin();
+    strlcpy(copy.str, snap->str + entry(key).offset, sizeof(copy.str));
+    unpin(snap);
+    return copy;
+}
+
 void userSettings::toStdOut()
 {
-    for (const auto &it : settings)
+    // Copy, so that writers are not held up while we print
+    const configSnapshot *pinned = pin();
+    configSnapshot snap = *pinned;
+    unpin(pinned);
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
     {
-        if (std::holds_alternative<configStr>(it.second.value))
+        const char *key = settings[i].key;
+        std::variant<bool, int, configStr> value = valueOf(&snap, (ConfigKey)i);
+        if (std::holds_alternative<configStr>(value))
         {
-            Serial.printf_P(PSTR("%s:\t%s\n"), it.first.c_str(), std::get<configStr>(it.second.value).str);
+            Serial.printf_P(PSTR("%s:\t%s\n"), key, std::get<configStr>(value).str);
         }
-        else if (std::holds_alternative<int>(it.second.value))
+        else if (std::holds_alternative<int>(value))
         {
-            Serial.printf_P(PSTR("%s:\t%d\n"), it.first.c_str(), std::get<int>(it.second.value));
+            Serial.printf_P(PSTR("%s:\t%d\n"), key, std::get<int>(value));
         }
         else
         {
-            Serial.printf_P(PSTR("%s:\t%d\n"), it.first.c_str(), std::get<bool>(it.second.value));
+            Serial.printf_P(PSTR("%s:\t%d\n"), key, std::get<bool>(value));
         }
     }
 }
 
 void userSettings::toFile(Print &file)
 {
-    for (const auto &it : settings)
+    // Copy, so that writers are not held up while we print
+    const configSnapshot *pinned = pin();
+    configSnapshot snap = *pinned;
+    unpin(pinned);
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
     {
-        if (std::holds_alternative<configStr>(it.second.value))
+        const char *key = settings[i].key;
+        std::variant<bool, int, configStr> value = valueOf(&snap, (ConfigKey)i);
+        if (std::holds_alternative<configStr>(value))
         {
-            file.printf_P(PSTR("%s,,%s\n"), it.first.c_str(), std::get<configStr>(it.second.value).str);
+            file.printf_P(PSTR("%s,,%s\n"), key, std::get<configStr>(value).str);
         }
-        else if (std::holds_alternative<int>(it.second.value))
+        else if (std::holds_alternative<int>(value))
         {
-            file.printf_P(PSTR("%s,,%d\n"), it.first.c_str(), std::get<int>(it.second.value));
+            file.printf_P(PSTR("%s,,%d\n"), key, std::get<int>(value));
 #ifdef ESP8266
             // Also save selected values under their old (v1.9.x and older) keynames
             // Just-in-case user uploads back-level firmware.
-            if (it.first == cfg_GDOSecurityType)
-                file.printf_P(PSTR("gdoSecurityType,,%d\n"), std::get<int>(it.second.value));
-            else if (it.first == cfg_TTCseconds)
-                file.printf_P(PSTR("TTCdelay,,%d\n"), std::get<int>(it.second.value));
-            else if (it.first == cfg_LEDidle)
-                file.printf_P(PSTR("ledIdleState,,%d\n"), std::get<int>(it.second.value));
+            if (i == (uint8_t)ConfigKey::GDOSecurityType)
+                file.printf_P(PSTR("gdoSecurityType,,%d\n"), std::get<int>(value));
+            else if (i == (uint8_t)ConfigKey::TTCseconds)
+                file.printf_P(PSTR("TTCdelay,,%d\n"), std::get<int>(value));
+            else if (i == (uint8_t)ConfigKey::LEDidle)
+                file.printf_P(PSTR("ledIdleState,,%d\n"), std::get<int>(value));
 #endif
         }
         else
         {
-            file.printf_P(PSTR("%s,,%d\n"), it.first.c_str(), std::get<bool>(it.second.value));
+            file.printf_P(PSTR("%s,,%d\n"), key, std::get<bool>(value));
 #ifdef ESP8266
             // Also save selected values under their old (v1.9.x and older) keynames
             // Just-in-case user uploads back-level firmware.
-            if (it.first == cfg_passwordRequired)
-                file.printf_P(PSTR("wwwPWrequired,,%d\n"), std::get<bool>(it.second.value));
+            if (i == (uint8_t)ConfigKey::passwordRequired)
+                file.printf_P(PSTR("wwwPWrequired,,%d\n"), std::get<bool>(value));
 #endif
         }
     }
@@ -587,25 +656,111 @@ void userSettings::erase()
     ESP_LOGI(TAG, "Config file erased");
 }
 #else
-// On ESP32 we save settings to nvram.
+// On ESP32 we save settings to nvram, all together in one blob.  Each record holds
+// the key name, so settings can be added or removed (or be build dependent) without
+// changing format.  Records are...
+//   uint8_t key length, key, uint8_t type, then int32_t value or uint8_t length and string
+// Older versions saved each setting in its own NVRAM key.  Those are read when found, then
+// the blob is rewritten with them included and the keys erased.  So a key found alongside
+// the blob was written by an older version after a downgrade, and is newer than the blob.
+#define CONFIG_BLOB_MAGIC 0x46434752 // "RGCF"
+#define CONFIG_BLOB_VERSION 1
+
+static std::string nvKey(const std::string &constKey);
+
+struct configBlobHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;  // number of records
+    uint32_t length; // of records following header
+    uint32_t crc;    // of records following header
+};
+
 void userSettings::save()
 {
     ESP_LOGI(TAG, "Writing user configuration to NVRAM");
-    for (const auto &it : settings)
+    TAKE_MUTEX();
+    const configSnapshot *snap = pin();
+    writeNVRAM(snap, false);
+    unpin(snap);
+    GIVE_MUTEX();
+    nvRam->commit();
+}
+
+void userSettings::writeNVRAM(const configSnapshot *snap, bool commit)
+{
+    std::string blob(sizeof(configBlobHeader), (char)0);
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
     {
-        if (std::holds_alternative<configStr>(it.second.value))
+        const configEntry &it = settings[i];
+        uint8_t keyLen = strlen(it.key);
+        blob += (char)keyLen;
+        blob.append(it.key, keyLen);
+        std::variant<bool, int, configStr> value = valueOf(snap, (ConfigKey)i);
+        blob += (char)value.index();
+        if (std::holds_alternative<configStr>(value))
         {
-            nvRam->write(it.first, std::get<configStr>(it.second.value).str);
+            uint8_t len = strlen(std::get<configStr>(value).str);
+            blob += (char)len;
+            blob.append(std::get<configStr>(value).str, len);
         }
-        else if (std::holds_alternative<int>(it.second.value))
+        else
         {
-            nvRam->write(it.first, std::get<int>(it.second.value));
+            int32_t v = snap->value[i];
+            blob.append(reinterpret_cast<const char *>(&v), sizeof(v));
         }
-        else
+    }
+    configBlobHeader header = {CONFIG_BLOB_MAGIC, CONFIG_BLOB_VERSION, CONFIG_KEYS, (uint32_t)(blob.size() - sizeof(configBlobHeader)), 0};
+    header.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(blob.data()) + sizeof(configBlobHeader), header.length);
+    memcpy(&blob[0], &header, sizeof(header));
+    nvRam->writeBlob(nvram_user_config, blob.data(), blob.size(), commit);
+}
+
+// Copy values for all keys found in blob into snapshot, noting which were found.  Returns
+// false if the blob is not valid.
+bool userSettings::fromBlob(const std::string &blob, configSnapshot *snap, bool *found)
+{
+    configBlobHeader header;
+    if (blob.size() < sizeof(header))
+        return false;
+    memcpy(&header, blob.data(), sizeof(header));
+    const uint8_t *p = reinterpret_cast<const uint8_t *>(blob.data()) + sizeof(header);
+    if (header.magic != CONFIG_BLOB_MAGIC || header.version != CONFIG_BLOB_VERSION || header.length != blob.size() - sizeof(header))
+    {
+        ESP_LOGW(TAG, "User configuration blob invalid, magic: 0x%08lX, version: %d, length: %lu (%d)", header.magic, header.version, header.length, blob.size());
+        return false;
+    }
+    if (header.crc != esp_rom_crc32_le(0, p, header.length))
+    {
+        ESP_LOGW(TAG, "User configuration blob checksum error");
+        return false;
+    }
+    const uint8_t *end = p + header.length;
+    for (uint16_t n = 0; n < header.count; n++)
+    {
+        // key length, key, type and at least one byte of value
+        if (p >= end || end - p < 3 + *p)
+            return false;
+        std::string key(reinterpret_cast<const char *>(p + 1), *p);
+        p += 1 + *p;
+        uint8_t type = *p++;
+        size_t len = (type == 2) ? 1 + *p : sizeof(int32_t);
+        if ((size_t)(end - p) < len)
+            return false;
+        ConfigKey k = find(key);
+        if (k != ConfigKey::COUNT && entry(k).setting.value.index() == type)
         {
-            nvRam->write(it.first, std::get<bool>(it.second.value) ? 1 : 0);
+            const configEntry &it = entry(k);
+            if (type == 2)
+                strlcpy(snap->str + it.offset, std::string(reinterpret_cast<const char *>(p + 1), *p).c_str(), std::get<configStr>(it.setting.value).max);
+            else
+                memcpy(&snap->value[(uint8_t)k], p, sizeof(int32_t));
+            found[(uint8_t)k] = true;
         }
+        p += len;
     }
+    return true;
 }
 
 void userSettings::load()
@@ -615,124 +770,347 @@ void userSettings::load()
     ESP_LOGI(TAG, "NVRAM Used Entries: (%lu), Free Entries: (%lu), Total Entries: (%lu), Namespace Count: (%lu)",
              nvs_stats.used_entries, nvs_stats.free_entries, nvs_stats.total_entries, nvs_stats.namespace_count);
     ESP_LOGI(TAG, "Read user configuration from NVRAM");
-    for (auto &it : settings)
+    TAKE_MUTEX();
+    configSnapshot *next = acquire();
+    bool found[CONFIG_KEYS] = {};
+    std::string blob;
+    if (nvRam->readBlob(nvram_user_config, blob))
+        fromBlob(blob, next, found);
+    // One pass over what is stored, rather than a lookup for every setting
+    std::vector<std::string> stored = nvRam->keys();
+    bool ownKey[CONFIG_KEYS] = {};
+    uint32_t missing = 0;  // from blob
+    uint32_t fallback = 0; // read from own key
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
     {
-        if (std::holds_alternative<configStr>(it.second.value))
+        const configEntry &it = settings[i];
+        ownKey[i] = std::find(stored.begin(), stored.end(), nvKey(it.key)) != stored.end();
+        if (!found[i])
+            missing++;
+        if (!ownKey[i])
+            continue;
+        // Saved by an older version, read the value from its own key.
+        fallback++;
+        if (std::holds_alternative<configStr>(it.setting.value))
         {
-            char *p = std::get<configStr>(it.second.value).str;
-            size_t max = std::get<configStr>(it.second.value).max;
-            strlcpy(p, nvRam->read(it.first, p).c_str(), max);
+            char *p = next->str + it.offset;
+            size_t max = std::get<configStr>(it.setting.value).max;
+            strlcpy(p, nvRam->read(it.key, p).c_str(), max);
         }
-        else if (std::holds_alternative<int>(it.second.value))
+        else if (std::holds_alternative<int>(it.setting.value))
         {
-            it.second.value = (int)nvRam->read(it.first, std::get<int>(it.second.value));
+            next->value[i] = nvRam->read(it.key, next->value[i]);
         }
         else
         {
-            it.second.value = (bool)(nvRam->read(it.first, std::get<bool>(it.second.value) ? 1 : 0) != 0);
+            next->value[i] = (nvRam->read(it.key, next->value[i]) != 0) ? 1 : 0;
         }
     }
+    ESP_LOGI(TAG, "Read %lu settings from configuration blob, %lu from individual keys", CONFIG_KEYS - missing, fallback);
+    if (fallback || missing)
+    {
+        // Migrate, next boot will read everything from the blob.  Individual keys are only
+        // erased once the blob is safely written, if not they are read again next boot.
+        uint32_t failures = nvRam->failures;
+        writeNVRAM(next, false);
+        nvRam->commit();
+        if (nvRam->failures == failures)
+        {
+            for (uint8_t i = 0; i < CONFIG_KEYS; i++)
+            {
+                if (ownKey[i])
+                    nvRam->erase(settings[i].key);
+            }
+        }
+    }
+    publish(next);
+    GIVE_MUTEX();
 }
 #endif
 
+// Linear search, there are few enough settings that this is as fast as a map and it is
+// only used for keys that arrive as strings from the web server or CLI.
+ConfigKey userSettings::find(const std::string &key)
+{
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
+    {
+        if (!strcmp(settings[i].key, key.c_str()))
+            return (ConfigKey)i;
+    }
+    return ConfigKey::COUNT;
+}
+
 bool userSettings::contains(const std::string &key)
 {
-    return (settings.count(key) > 0);
+    return (find(key) != ConfigKey::COUNT);
 }
 
 std::variant<bool, int, configStr> userSettings::get(const std::string &key)
 {
-    return settings[key].value;
+    ConfigKey k = find(key);
+    if (k == ConfigKey::COUNT)
+        return false;
+    const configSnapshot *snap = pin();
+    std::variant<bool, int, configStr> value = valueOf(snap, k);
+    unpin(snap);
+    if (std::holds_alternative<configStr>(value) && snap != draft.load(std::memory_order_relaxed))
+        std::get<configStr>(value).str = NULL; // not in a transaction, snapshot may be reused
+    return value;
 }
 
 configSetting userSettings::getDetail(const std::string &key)
 {
-    return settings[key];
+    ConfigKey k = find(key);
+    if (k == ConfigKey::COUNT)
+        return {false, false, false, NULL};
+    configSetting detail = entry(k).setting;
+    detail.value = get(key);
+    return detail;
 }
 
-bool userSettings::set(const std::string &key, const bool value)
+// Check that value can be set for key, without setting it.
+bool userSettings::validate(const std::string &key, const char *value)
 {
-    bool rc = false;
-    TAKE_MUTEX();
-    if (settings.count(key))
+    ConfigKey k = find(key);
+    if (k == ConfigKey::COUNT)
+        return false;
+    const configSetting &setting = entry(k).setting;
+    if (std::holds_alternative<configStr>(setting.value))
+        return strlen(value) < std::get<configStr>(setting.value).max;
+    if (std::holds_alternative<bool>(setting.value) && (!strcmp(value, "true") || !strcmp(value, "false")))
+        return true;
+    // int or bool, must be a number. Empty is zero for bool, but helpers for int settings
+    // parse the value with std::stoi() which throws on an empty or out of range string.
+    if (*value == 0)
+        return std::holds_alternative<bool>(setting.value);
+    char *end;
+    double number = strtod(value, &end);
+    return *end == 0 && number >= INT32_MIN && number <= INT32_MAX;
+}
+
+// Called with mutex held.  Returns a copy of the current snapshot in a slot that is not current,
+// not a draft and not pinned by a reader.  Readers only pin a snapshot long enough to copy one
+// value, or all of them, out of it, so if every free slot is pinned we wait at most that long.
+configSnapshot *userSettings::acquire()
+{
+    for (bool waited = false;; waited = true)
     {
-        if (std::holds_alternative<bool>(settings[key].value))
+        for (uint8_t i = 0; i < CONFIG_SNAPSHOTS; i++)
         {
-            settings[key].value = value;
-#ifndef ESP8266
-            nvRam->write(key, value ? 1 : 0);
+#ifdef ESP8266
+            if (!busy[i])
+#else
+            if (!busy[i] && readers[i] == 0)
 #endif
-            rc = true;
+            {
+                busy[i] = true;
+                memcpy(&snapshots[i], current.load(std::memory_order_relaxed), sizeof(configSnapshot));
+                return &snapshots[i];
+            }
         }
+        if (!waited)
+            ESP_LOGD(TAG, "All setting snapshots in use by readers, waiting");
+        delay(1);
     }
-    GIVE_MUTEX();
-    return rc;
 }
 
-bool userSettings::set(const std::string &key, const int value)
+// Called with mutex held.  Make next the current snapshot, the one it replaces is reused once
+// no reader has it pinned.
+void userSettings::publish(configSnapshot *next)
 {
-    bool rc = false;
-    TAKE_MUTEX();
-    if (settings.count(key))
+    configSnapshot *old = current.load(std::memory_order_relaxed);
+    current.store(next);
+    release(old);
+    version++;
+}
+
+// Called with mutex held.
+void userSettings::release(configSnapshot *snap)
+{
+    busy[snap - snapshots] = false;
+}
+
+// Called with mutex held.  Snapshot was never published.
+void userSettings::discard(configSnapshot *snap)
+{
+    release(snap);
+}
+
+// Called with mutex held.  In a transaction all changes go to the draft, otherwise to a new copy.
+configSnapshot *userSettings::writable()
+{
+    configSnapshot *d = draft.load(std::memory_order_relaxed);
+    return d ? d : acquire();
+}
+
+// Called with mutex held after a value is changed in next, outside of a transaction it is saved
+// and published, unless it was set to the value it already had.
+void userSettings::changed(ConfigKey key, configSnapshot *next)
+{
+    if (next == draft.load(std::memory_order_relaxed))
+        return;
+    if (same(next, current.load(std::memory_order_relaxed), key))
     {
-        if (std::holds_alternative<int>(settings[key].value))
-        {
-            settings[key].value = value;
+        discard(next);
+        return;
+    }
 #ifndef ESP8266
-            nvRam->write(key, value);
+    writeNVRAM(next, true);
 #endif
-            rc = true;
-        }
-        else if (std::holds_alternative<bool>(settings[key].value))
-        {
-            settings[key].value = (value != 0);
+    publish(next);
+}
+
+bool userSettings::same(const configSnapshot *a, const configSnapshot *b, ConfigKey key)
+{
+    const configEntry &it = entry(key);
+    if (std::holds_alternative<configStr>(it.setting.value))
+        return !strcmp(a->str + it.offset, b->str + it.offset);
+    return a->value[(uint8_t)key] == b->value[(uint8_t)key];
+}
+
+// Start a transaction.  Until commitTransaction() or rollbackTransaction() values that are set are
+// only changed in a private draft, seen by this task but not others.  Other tasks calling set()
+// wait until the transaction is done.
+void userSettings::beginTransaction()
+{
+    TAKE_MUTEX();
 #ifndef ESP8266
-            nvRam->write(key, value ? 1 : 0);
+    draftOwner = xTaskGetCurrentTaskHandle();
 #endif
-            rc = true;
-        }
-    }
-    GIVE_MUTEX();
-    return rc;
+    draft.store(acquire(), std::memory_order_relaxed);
 }
 
-bool userSettings::set(const std::string &key, const char *value)
+// Persist all values changed in the transaction, with one commit, and publish them together.
+void userSettings::commitTransaction()
 {
-    bool rc = false;
-    TAKE_MUTEX();
-    if (settings.count(key))
+    configSnapshot *next = draft.load(std::memory_order_relaxed);
+    const configSnapshot *old = current.load(std::memory_order_relaxed);
+    uint32_t updated = 0;
+    for (uint8_t i = 0; i < CONFIG_KEYS; i++)
     {
-        if (std::holds_alternative<configStr>(settings[key].value))
-        {
-            char *p = std::get<configStr>(settings[key].value).str;
-            size_t max = std::get<configStr>(settings[key].value).max;
-            strlcpy(p, value, max);
+        if (!same(next, old, (ConfigKey)i))
+            updated++;
+    }
+    draft.store(NULL, std::memory_order_relaxed);
 #ifndef ESP8266
-            nvRam->write(key, value);
+    draftOwner = NULL;
 #endif
-            rc = true;
-        }
-        else if (std::holds_alternative<bool>(settings[key].value))
-        {
-            settings[key].value = (!strcmp(value, "true")) || (atoi(value) != 0);
+    if (updated)
+    {
 #ifndef ESP8266
-            nvRam->write(key, std::get<bool>(settings[key].value) ? 1 : 0);
+        writeNVRAM(next, false);
+        nvRam->commit();
 #endif
-            rc = true;
-        }
-        else if (std::holds_alternative<int>(settings[key].value))
-        {
-            settings[key].value = atoi(value);
+        publish(next);
+    }
+    else
+    {
+        discard(next);
+    }
+    ESP_LOGI(TAG, "Settings transaction committed, %lu values changed", updated);
+    GIVE_MUTEX();
+}
+
+// Discard all values set in the transaction, nothing outside this task ever saw them.
+void userSettings::rollbackTransaction()
+{
+    configSnapshot *next = draft.load(std::memory_order_relaxed);
+    draft.store(NULL, std::memory_order_relaxed);
 #ifndef ESP8266
-            nvRam->write(key, atoi(value));
+    draftOwner = NULL;
 #endif
-            rc = true;
-        }
+    discard(next);
+    ESP_LOGI(TAG, "Settings transaction rolled back");
+    GIVE_MUTEX();
+}
+
+bool userSettings::set(ConfigKey key, const bool value)
+{
+    bool rc = false;
+    TAKE_MUTEX();
+    const configSetting &setting = entry(key).setting;
+    if (std::holds_alternative<bool>(setting.value))
+    {
+        configSnapshot *next = writable();
+        next->value[(uint8_t)key] = value ? 1 : 0;
+        changed(key, next);
+        rc = true;
     }
     GIVE_MUTEX();
     return rc;
 }
 
+bool userSettings::set(ConfigKey key, const int value)
+{
+    bool rc = false;
+    TAKE_MUTEX();
+    const configSetting &setting = entry(key).setting;
+    if (std::holds_alternative<int>(setting.value) || std::holds_alternative<bool>(setting.value))
+    {
+        configSnapshot *next = writable();
+        if (std::holds_alternative<int>(setting.value))
+            next->value[(uint8_t)key] = value;
+        else
+            next->value[(uint8_t)key] = (value != 0) ? 1 : 0;
+        changed(key, next);
+        rc = true;
+    }
+    GIVE_MUTEX();
+    return rc;
+}
+
+bool userSettings::set(ConfigKey key, const char *value)
+{
+    TAKE_MUTEX();
+    const configEntry &it = entry(key);
+    configSnapshot *next = writable();
+    if (std::holds_alternative<configStr>(it.setting.value))
+        strlcpy(next->str + it.offset, value, std::get<configStr>(it.setting.value).max);
+    else if (std::holds_alternative<bool>(it.setting.value))
+        next->value[(uint8_t)key] = ((!strcmp(value, "true")) || (atoi(value) != 0)) ? 1 : 0;
+    else
+        next->value[(uint8_t)key] = atoi(value);
+    changed(key, next);
+    GIVE_MUTEX();
+    return true;
+}
+
+bool userSettings::set(const std::string &key, const bool value)
+{
+    ConfigKey k = find(key);
+    return (k != ConfigKey::COUNT) && set(k, value);
+}
+
+bool userSettings::set(const std::string &key, const int value)
+{
+    ConfigKey k = find(key);
+    return (k != ConfigKey::COUNT) && set(k, value);
+}
+
+bool userSettings::set(const std::string &key, const char *value)
+{
+    ConfigKey k = find(key);
+    return (k != ConfigKey::COUNT) && set(k, value);
+}
+
+// Compare cost of typed getter against looking up the same value by string key.
+void userSettings::printGetterCost(Print &outputDev)
+{
+    const uint32_t n = 10000;
+    volatile uint32_t sink = 0;
+    uint32_t mhz = ESP.getCpuFreqMHz();
+    uint32_t start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < n; i++)
+        sink = sink + getTTCseconds();
+    uint32_t indexed = ESP.getCycleCount() - start;
+    start = ESP.getCycleCount();
+    for (uint32_t i = 0; i < n; i++)
+        sink = sink + std::get<int>(get(cfg_TTCseconds));
+    uint32_t byString = ESP.getCycleCount() - start;
+    outputDev.printf("Getter cost over %lu calls at %lu MHz: indexed %lu cycles (%lu ns) per call, by string %lu cycles (%lu ns) per call\n",
+                     n, mhz, indexed / n, indexed / n * 1000 / mhz, byString / n, byString / n * 1000 / mhz);
+}
+
 #ifdef ESP8266
 /****************************************************************************
  * No NVRAM on ESP8266 so just use simple read/write from files
@@ -789,6 +1167,7 @@ void delete_file(const char *filename)
 nvRamClass::nvRamClass()
 {
     ESP_LOGI(TAG, "Constructor for NVRAM class");
+    mutex = xSemaphoreCreateMutex();
     // Initialize non volatile ram
     // We use this sparingly, most settings are saved in file system initialized below.
     esp_err_t err = nvs_flash_init();
@@ -800,7 +1179,7 @@ nvRamClass::nvRamClass()
         err = nvs_flash_init();
     }
     ESP_ERROR_CHECK(err);
-    err = nvs_open("ratgdo", NVS_READWRITE, &nvHandle);
+    err = nvs_open(NVRAM_NAMESPACE, NVS_READWRITE, &nvHandle);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "Error (%s) opening NVS handle!\n", esp_err_to_name(err));
@@ -822,143 +1201,271 @@ void nvRamClass::checkStats()
     }
 }
 
-int32_t nvRamClass::read(const std::string &constKey, const int32_t dflt)
+// NVS keys are limited in length, truncate longer keys.
+static std::string nvKey(const std::string &constKey)
 {
     std::string key = constKey;
     if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
         key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
+    return key;
+}
 
+int32_t nvRamClass::read(const std::string &constKey, const int32_t dflt)
+{
+    std::string key = nvKey(constKey);
     int32_t value = dflt;
-    esp_err_t err = nvs_get_i32(nvHandle, key.c_str(), &value);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto it = pending.find(key);
+    if (it != pending.end() && it->second.type == PENDING_INT)
+    {
+        value = it->second.value;
+    }
+    else
     {
-        ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+        esp_err_t err = nvs_get_i32(nvHandle, key.c_str(), &value);
+        if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
+        {
+            ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+        }
     }
+    xSemaphoreGive(mutex);
     return value;
 }
 
 std::string nvRamClass::read(const std::string &constKey, const char *dflt)
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
-
+    std::string key = nvKey(constKey);
     std::string value(dflt);
-    size_t len;
-    esp_err_t err = nvs_get_str(nvHandle, key.c_str(), NULL, &len);
-    if (err == ESP_OK)
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto it = pending.find(key);
+    if (it != pending.end() && it->second.type == PENDING_STR)
     {
-        char *buf = static_cast<char *>(malloc(len));
-        if (nvs_get_str(nvHandle, key.c_str(), buf, &len) == ESP_OK)
-        {
-            value = buf;
-        }
-        free(buf);
+        value = it->second.data;
     }
-    else if (err != ESP_ERR_NVS_NOT_FOUND)
+    else
     {
-        ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+        size_t len;
+        esp_err_t err = nvs_get_str(nvHandle, key.c_str(), NULL, &len);
+        if (err == ESP_OK)
+        {
+            char *buf = static_cast<char *>(malloc(len));
+            if (nvs_get_str(nvHandle, key.c_str(), buf, &len) == ESP_OK)
+            {
+                value = buf;
+            }
+            free(buf);
+        }
+        else if (err != ESP_ERR_NVS_NOT_FOUND)
+        {
+            ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+        }
     }
+    xSemaphoreGive(mutex);
     return value;
 }
 
-bool nvRamClass::write(const std::string &constKey, const int32_t value, bool commit)
+bool nvRamClass::readBlob(const std::string &constKey, void *value, size_t size)
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
-
-    esp_err_t err = nvs_set_i32(nvHandle, key.c_str(), value);
-    if (err != ESP_OK)
+    std::string key = nvKey(constKey);
+    bool rc = true;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto it = pending.find(key);
+    if (it != pending.end() && it->second.type == PENDING_BLOB)
     {
-        ESP_LOGE(TAG, "NVRAM set error for: %s (%s)", key.c_str(), esp_err_to_name(err));
-        return false;
+        memcpy(value, it->second.data.data(), std::min(size, it->second.data.size()));
     }
-    if (commit)
+    else
     {
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+        esp_err_t err = nvs_get_blob(nvHandle, key.c_str(), value, &size);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+            rc = false;
+        }
     }
-    return true;
+    xSemaphoreGive(mutex);
+    return rc;
 }
 
-bool nvRamClass::readBlob(const std::string &constKey, void *value, size_t size)
+// Read blob of any size.
+bool nvRamClass::readBlob(const std::string &constKey, std::string &value)
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
+    std::string key = nvKey(constKey);
+    bool rc = false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    auto it = pending.find(key);
+    if (it != pending.end() && it->second.type == PENDING_BLOB)
+    {
+        value = it->second.data;
+        rc = true;
+    }
+    else
+    {
+        size_t len;
+        esp_err_t err = nvs_get_blob(nvHandle, key.c_str(), NULL, &len);
+        if (err == ESP_OK)
+        {
+            value.resize(len);
+            rc = (nvs_get_blob(nvHandle, key.c_str(), &value[0], &len) == ESP_OK);
+        }
+        else if (err != ESP_ERR_NVS_NOT_FOUND)
+        {
+            ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
+        }
+    }
+    xSemaphoreGive(mutex);
+    return rc;
+}
 
-    esp_err_t err = nvs_get_blob(nvHandle, key.c_str(), value, &size);
-    if (err != ESP_OK)
+// Hold value until next flush, replacing any value already waiting for the same key.
+void nvRamClass::stage(const std::string &constKey, pendingValue &&value, bool commit)
+{
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pending[nvKey(constKey)] = std::move(value);
+    writes++;
+    if (commit && !flushArmed)
     {
-        ESP_LOGE(TAG, "NVRAM get error for: %s (%s)", key.c_str(), esp_err_to_name(err));
-        return false;
+        flushArmed = true;
+        flushAt = millis() + NVRAM_FLUSH_MS;
     }
+    xSemaphoreGive(mutex);
+}
+
+bool nvRamClass::write(const std::string &constKey, const int32_t value, bool commit)
+{
+    stage(constKey, {PENDING_INT, value, std::string()}, commit);
+    return true;
+}
+
+bool nvRamClass::write(const std::string &constKey, const char *value, bool commit)
+{
+    stage(constKey, {PENDING_STR, 0, std::string(value)}, commit);
     return true;
 }
 
 bool nvRamClass::writeBlob(const std::string &constKey, const void *value, size_t size, bool commit)
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
+    stage(constKey, {PENDING_BLOB, 0, std::string(static_cast<const char *>(value), size)}, commit);
+    return true;
+}
 
-    esp_err_t err = nvs_set_blob(nvHandle, key.c_str(), value, size);
-    if (err != ESP_OK)
+// Called with mutex held.  Write all pending values to flash and commit.  Values that fail
+// to write stay pending and the timer is armed again, so they are retried on next flush.
+void nvRamClass::flush()
+{
+    flushArmed = false;
+    if (pending.empty())
+        return;
+    uint32_t start = micros();
+    for (auto it = pending.begin(); it != pending.end();)
     {
-        ESP_LOGE(TAG, "NVRAM set error for: %s (%s)", key.c_str(), esp_err_to_name(err));
-        return false;
+        esp_err_t err;
+        if (it->second.type == PENDING_INT)
+            err = nvs_set_i32(nvHandle, it->first.c_str(), it->second.value);
+        else if (it->second.type == PENDING_STR)
+            err = nvs_set_str(nvHandle, it->first.c_str(), it->second.data.c_str());
+        else
+            err = nvs_set_blob(nvHandle, it->first.c_str(), it->second.data.data(), it->second.data.size());
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "NVRAM set error for: %s (%s), will retry", it->first.c_str(), esp_err_to_name(err));
+            failures++;
+            it++;
+            continue;
+        }
+        stored++;
+        it = pending.erase(it);
     }
-    if (commit)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+    commits++;
+    if (!pending.empty())
     {
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+        flushArmed = true;
+        flushAt = millis() + NVRAM_FLUSH_MS;
     }
-    return true;
+    lastStallUs = micros() - start;
+    if (lastStallUs > maxStallUs)
+        maxStallUs = lastStallUs;
 }
 
-bool nvRamClass::write(const std::string &constKey, const char *value, bool commit)
+// Barrier, returns after every value written so far is saved, or failed and is pending for retry.
+void nvRamClass::commit()
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    flush();
+    xSemaphoreGive(mutex);
+}
 
-    esp_err_t err = nvs_set_str(nvHandle, key.c_str(), value);
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG, "NVRAM set error for: %s (%s)", key.c_str(), esp_err_to_name(err));
-        return false;
-    }
-    if (commit)
+void nvRamClass::loop()
+{
+    if (!flushArmed || (int32_t)(millis() - flushAt) < 0)
+        return;
+    commit();
+}
+
+// Names of all keys in flash, values pending write are not included.
+std::vector<std::string> nvRamClass::keys()
+{
+    std::vector<std::string> names;
+    nvs_iterator_t it = NULL;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVRAM_NAMESPACE, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK)
     {
-        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        names.push_back(info.key);
+        err = nvs_entry_next(&it);
     }
-    return true;
+    nvs_release_iterator(it);
+    xSemaphoreGive(mutex);
+    return names;
 }
 
 bool nvRamClass::erase(const std::string &constKey)
 {
-    std::string key = constKey;
-    if (key.length() >= NVS_KEY_NAME_MAX_SIZE)
-        key.resize(NVS_KEY_NAME_MAX_SIZE - 1); // allow for null terminator
-
+    std::string key = nvKey(constKey);
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pending.erase(key);
     esp_err_t err = nvs_erase_key(nvHandle, key.c_str());
+    if (err == ESP_OK)
+        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+    xSemaphoreGive(mutex);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "NVRAM erase error for: %s (%s)", key.c_str(), esp_err_to_name(err));
         return false;
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
     return true;
 }
 
 void nvRamClass::erase()
 {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    pending.clear();
+    flushArmed = false;
     esp_err_t err = nvs_erase_all(nvHandle);
+    if (err == ESP_OK)
+        ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
+    xSemaphoreGive(mutex);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG, "NVRAM erase_all error: %s", esp_err_to_name(err));
         return;
     }
-    ESP_ERROR_CHECK_WITHOUT_ABORT(nvs_commit(nvHandle));
     return;
 }
+
+void nvRamClass::printStats(Print &outputDev)
+{
+    uint32_t uptimeMs = millis();
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    size_t pendingCount = pending.size();
+    xSemaphoreGive(mutex);
+    outputDev.printf("NVRAM writes: %lu, written to flash: %lu (%lu coalesced), commits: %lu, pending: %d, failed: %lu\n",
+                     writes, stored, writes - stored, commits, pendingCount, failures);
+    outputDev.printf("NVRAM commits/hour: %lu (%lu if every write committed), last flush: %luus, max flush: %luus\n",
+                     (uint32_t)((uint64_t)commits * 3600000 / uptimeMs), (uint32_t)((uint64_t)writes * 3600000 / uptimeMs),
+                     lastStallUs, maxStallUs);
+}
 #endif
@@ -18,6 +18,8 @@
 #include <variant>
 #include <string>
 #include <map>
+#include <vector>
+#include <atomic>
 
 // Arduino includes
 #include <Print.h>
@@ -119,6 +121,7 @@ constexpr char nvram_close_history[] PROGMEM = "close_history";
 #ifndef ESP8266
 constexpr char nvram_ratgdo_pw[] PROGMEM = "ratgdo_pw";
 constexpr char nvram_has_distance[] PROGMEM = "has_distance";
+constexpr char nvram_user_config[] PROGMEM = "user_config";
 #endif
 
 struct configStr
@@ -127,6 +130,16 @@ struct configStr
     char *str;
 };
 
+// Copy of a string setting returned by getters, so it stays valid for as long as the
+// caller keeps it.  Pass c_str() where a char pointer cannot be converted to, e.g. printf.
+#define CONFIG_STR_MAX 64 // longest string setting, including terminator
+struct configString
+{
+    char str[CONFIG_STR_MAX];
+    const char *c_str() const { return str; };
+    operator const char *() const { return str; };
+};
+
 struct configSetting
 {
     bool reboot;
@@ -135,28 +148,205 @@ struct configSetting
     bool (*fn)(const std::string &key, const char *value, configSetting *actions);
 };
 
+// Index of every user setting into the settings array.  Typed getters below read the
+// array directly, the string keys above are only searched for by the web and CLI layer.
+enum class ConfigKey : uint8_t
+{
+    deviceName,
+    wifiChanged,
+    wifiPower,
+    wifiPhyMode,
+    staticIP,
+    localIP,
+    subnetMask,
+    gatewayIP,
+    nameserverIP,
+    passwordRequired,
+    wwwUsername,
+    wwwCredentials,
+    GDOSecurityType,
+    TTCseconds,
+    TTClight,
+    rebootSeconds,
+    LEDidle,
+    motionTriggers,
+    enableNTP,
+    doorUpdateAt,
+    doorOpenAt,
+    doorCloseAt,
+    timeZone,
+    softAPmode,
+    syslogEn,
+    syslogIP,
+    syslogPort,
+    syslogFacility,
+    logLevel,
+    dcOpenClose,
+    dcBypassTTC,
+    useToggle,
+    dcDebounceDuration,
+    obstFromStatus,
+    builtInTTC,
+#ifdef RATGDO32_DISCO
+    vehicleThreshold,
+    vehicleHomeKit,
+    vehicleOccupancyHomeKit,
+    vehicleArrivingHomeKit,
+    vehicleDepartingHomeKit,
+    laserEnabled,
+    laserHomeKit,
+    assistDuration,
+#endif
+#ifdef USE_GDOLIB
+    useSWserial,
+#endif
+#ifndef ESP8266
+    occupancyDuration,
+    enableIPv6,
+    homespanCLI,
+    lightHomeKit,
+    motionHomeKit,
+#endif
+#ifdef USE_DHT22
+    dht22Pin,
+    dht22TempFormat,
+#endif
+    COUNT
+};
+#define CONFIG_KEYS ((uint8_t)ConfigKey::COUNT)
+
+// Key, type, default value and what to do when set.  For strings the offset of the
+// value within every configSnapshot.
+struct configEntry
+{
+    const char *key = NULL;
+    configSetting setting;
+    uint16_t offset = 0;
+};
+
+/****************************************************************************
+ * Setting values are held in immutable snapshots.  Readers pin the current snapshot
+ * by counting themselves in its slot, copy the value out and unpin it, they never
+ * wait for a writer.  Writers (serialized by mutex) copy the current snapshot into a
+ * slot that is neither current nor pinned, change the copy and publish it with one
+ * atomic store.  Pins last only as long as a getter, no pointer into a snapshot is
+ * returned, so a writer rarely waits and then only for a reader to copy one value.
+ * A transaction changes one private draft which only the task that owns the
+ * transaction sees until commit.
+ */
+#ifdef ESP8266
+// Single threaded, there can be no reader of a replaced snapshot.
+#define CONFIG_SNAPSHOTS 2
+#else
+// Current, draft, and one for a reader still copying out of a replaced snapshot
+#define CONFIG_SNAPSHOTS 4
+#endif
+#define CONFIG_STR_SIZE 256 // total of all string settings max size
+
+struct configSnapshot
+{
+    int32_t value[CONFIG_KEYS]; // bool and int settings
+    char str[CONFIG_STR_SIZE];  // string settings, at configEntry offset
+};
+
 class userSettings
 {
 private:
-    std::map<std::string, configSetting> settings;
+    configEntry settings[CONFIG_KEYS];
+    configSnapshot snapshots[CONFIG_SNAPSHOTS];
+    bool busy[CONFIG_SNAPSHOTS]; // current or draft, cannot be reused
+#ifndef ESP8266
+    std::atomic<uint16_t> readers[CONFIG_SNAPSHOTS]; // getters copying out of snapshot
+#endif
+    std::atomic<configSnapshot *> current;
+    std::atomic<configSnapshot *> draft; // in a transaction, private to owner
     static userSettings *instancePtr;
+    uint32_t version = 0; // incremented on every change
     userSettings();
+    configEntry &entry(ConfigKey key) { return settings[(uint8_t)key]; };
+    ConfigKey find(const std::string &key);
+    configSnapshot *acquire();
+    void publish(configSnapshot *next);
+    void release(configSnapshot *snap);
+    void discard(configSnapshot *snap);
+    bool same(const configSnapshot *a, const configSnapshot *b, ConfigKey key);
+    configSnapshot *writable();
+    void changed(ConfigKey key, configSnapshot *next);
+    std::variant<bool, int, configStr> valueOf(const configSnapshot *snap, ConfigKey key);
     void toFile(Print &file);
 #ifndef ESP8266
     SemaphoreHandle_t mutex;
+    TaskHandle_t draftOwner = NULL;
+    void writeNVRAM(const configSnapshot *snap, bool commit);
+    bool fromBlob(const std::string &blob, configSnapshot *snap, bool *found);
 #endif
 
+#ifdef ESP8266
+    const configSnapshot *pin()
+    {
+        const configSnapshot *d = draft.load(std::memory_order_relaxed);
+        return d ? d : current.load(std::memory_order_relaxed);
+    };
+    void unpin(const configSnapshot *snap) {};
+#else
+    // The snapshot this task should read, which cannot be reused until unpin().  Count
+    // the reader then check the snapshot is still current, if not it may already be
+    // in reuse (the writer did not see the count), so try again.  Sequentially consistent
+    // so the writer either sees the count or this sees the new current snapshot.
+    const configSnapshot *pin()
+    {
+        configSnapshot *d = draft.load(std::memory_order_relaxed);
+        if (d && draftOwner == xTaskGetCurrentTaskHandle())
+        {
+            readers[d - snapshots]++;
+            return d;
+        }
+        for (;;)
+        {
+            configSnapshot *s = current.load();
+            readers[s - snapshots]++;
+            if (current.load() == s)
+                return s;
+            readers[s - snapshots]--;
+        }
+    };
+    void unpin(const configSnapshot *snap) { readers[snap - snapshots]--; };
+#endif
+    int32_t valueAt(ConfigKey key)
+    {
+        const configSnapshot *snap = pin();
+        int32_t value = snap->value[(uint8_t)key];
+        unpin(snap);
+        return value;
+    };
+
 public:
     userSettings(const userSettings &obj) = delete;
     static userSettings *getInstance() { return instancePtr; }
 
+    // String keyed, for the web server and CLI
     bool contains(const std::string &key);
     bool set(const std::string &key, const bool value);
     bool set(const std::string &key, const int value);
     bool set(const std::string &key, const char *value);
+    bool validate(const std::string &key, const char *value);
+    // String values returned by these point into the snapshot, so they are only set
+    // within a transaction, where the draft cannot change under the caller.
     std::variant<bool, int, configStr> get(const std::string &key);
     configSetting getDetail(const std::string &key);
+    // Indexed, no string construction or search
+    bool set(ConfigKey key, const bool value);
+    bool set(ConfigKey key, const int value);
+    bool set(ConfigKey key, const char *value);
+    bool getBool(ConfigKey key) { return valueAt(key) != 0; };
+    int getInt(ConfigKey key) { return valueAt(key); };
+    configString getStr(ConfigKey key);
+    void beginTransaction();
+    void commitTransaction();
+    void rollbackTransaction();
+    uint32_t getVersion() { return version; };
     void toStdOut();
+    void printGetterCost(Print &outputDev);
     void save();
     void load();
 #ifdef ESP8266
@@ -168,62 +358,64 @@ public:
 #define ESP8266_SAVE_CONFIG()
 #endif
 
-    const char *getDeviceName() { return (std::get<configStr>(get(cfg_deviceName)).str); };
-    bool getWifiChanged() { return std::get<bool>(get(cfg_wifiChanged)); };
-    uint32_t getWifiPower() { return std::get<int>(get(cfg_wifiPower)); };
-    uint32_t getWifiPhyMode() { return std::get<int>(get(cfg_wifiPhyMode)); };
-    bool getStaticIP() { return std::get<bool>(get(cfg_staticIP)); };
-    const char *getLocalIP() { return (std::get<configStr>(get(cfg_localIP)).str); };
-    const char *getSubnetMask() { return (std::get<configStr>(get(cfg_subnetMask)).str); };
-    const char *getGatewayIP() { return (std::get<configStr>(get(cfg_gatewayIP)).str); };
-    const char *getNameserverIP() { return (std::get<configStr>(get(cfg_nameserverIP)).str); };
-    bool getPasswordRequired() { return std::get<bool>(get(cfg_passwordRequired)); };
-    const char *getwwwUsername() { return (std::get<configStr>(get(cfg_wwwUsername)).str); };
-    const char *getwwwCredentials() { return (std::get<configStr>(get(cfg_wwwCredentials)).str); };
-    uint32_t getGDOSecurityType() { return std::get<int>(get(cfg_GDOSecurityType)); };
-    uint32_t getTTCseconds() { return std::get<int>(get(cfg_TTCseconds)); };
-    bool getTTClight() { return std::get<bool>(get(cfg_TTClight)); };
-    uint32_t getRebootSeconds() { return std::get<int>(get(cfg_rebootSeconds)); };
-    uint32_t getLEDidle() { return std::get<int>(get(cfg_LEDidle)); };
-    uint32_t getMotionTriggers() { return std::get<int>(get(cfg_motionTriggers)); };
-    bool getEnableNTP() { return std::get<bool>(get(cfg_enableNTP)); };
-    uint32_t getDoorUpdateAt() { return std::get<int>(get(cfg_doorUpdateAt)); };
-    uint32_t getDoorOpenAt() { return std::get<int>(get(cfg_doorOpenAt)); };
-    uint32_t getDoorCloseAt() { return std::get<int>(get(cfg_doorCloseAt)); };
-    const char *getTimeZone() { return (std::get<configStr>(get(cfg_timeZone)).str); };
-    bool getSoftAPmode() { return std::get<bool>(get(cfg_softAPmode)); };
-    bool getSyslogEn() { return std::get<bool>(get(cfg_syslogEn)); };
-    const char *getSyslogIP() { return (std::get<configStr>(get(cfg_syslogIP)).str); };
-    uint32_t getSyslogPort() { return std::get<int>(get(cfg_syslogPort)); };
-    uint32_t getSyslogFacility() { return std::get<int>(get(cfg_syslogFacility)); };
-    uint32_t getLogLevel() { return std::get<int>(get(cfg_logLevel)); };
-    bool getDCOpenClose() { return std::get<bool>(get(cfg_dcOpenClose)); };
-    bool getDCBypassTTC() { return std::get<bool>(get(cfg_dcBypassTTC)); };
-    bool getUseToggle() { return std::get<bool>(get(cfg_useToggle)); };
-    uint32_t getDCDebounceDuration() { return std::get<int>(get(cfg_dcDebounceDuration)); };
-    bool getObstFromStatus() { return std::get<bool>(get(cfg_obstFromStatus)); };
-    uint32_t getBuiltInTTC() { return std::get<int>(get(cfg_builtInTTC)); };
+    configString getDeviceName() { return getStr(ConfigKey::deviceName); };
+    bool getWifiChanged() { return getBool(ConfigKey::wifiChanged); };
+    uint32_t getWifiPower() { return getInt(ConfigKey::wifiPower); };
+    uint32_t getWifiPhyMode() { return getInt(ConfigKey::wifiPhyMode); };
+    bool getStaticIP() { return getBool(ConfigKey::staticIP); };
+    configString getLocalIP() { return getStr(ConfigKey::localIP); };
+    configString getSubnetMask() { return getStr(ConfigKey::subnetMask); };
+    configString getGatewayIP() { return getStr(ConfigKey::gatewayIP); };
+    configString getNameserverIP() { return getStr(ConfigKey::nameserverIP); };
+    bool getPasswordRequired() { return getBool(ConfigKey::passwordRequired); };
+    configString getwwwUsername() { return getStr(ConfigKey::wwwUsername); };
+    configString getwwwCredentials() { return getStr(ConfigKey::wwwCredentials); };
+    uint32_t getGDOSecurityType() { return getInt(ConfigKey::GDOSecurityType); };
+    uint32_t getTTCseconds() { return getInt(ConfigKey::TTCseconds); };
+    bool getTTClight() { return getBool(ConfigKey::TTClight); };
+    uint32_t getRebootSeconds() { return getInt(ConfigKey::rebootSeconds); };
+    uint32_t getLEDidle() { return getInt(ConfigKey::LEDidle); };
+    uint32_t getMotionTriggers() { return getInt(ConfigKey::motionTriggers); };
+    bool getEnableNTP() { return getBool(ConfigKey::enableNTP); };
+    uint32_t getDoorUpdateAt() { return getInt(ConfigKey::doorUpdateAt); };
+    uint32_t getDoorOpenAt() { return getInt(ConfigKey::doorOpenAt); };
+    uint32_t getDoorCloseAt() { return getInt(ConfigKey::doorCloseAt); };
+    configString getTimeZone() { return getStr(ConfigKey::timeZone); };
+    bool getSoftAPmode() { return getBool(ConfigKey::softAPmode); };
+    bool getSyslogEn() { return getBool(ConfigKey::syslogEn); };
+    configString getSyslogIP() { return getStr(ConfigKey::syslogIP); };
+    uint32_t getSyslogPort() { return getInt(ConfigKey::syslogPort); };
+    uint32_t getSyslogFacility() { return getInt(ConfigKey::syslogFacility); };
+    uint32_t getLogLevel() { return getInt(ConfigKey::logLevel); };
+    bool getDCOpenClose() { return getBool(ConfigKey::dcOpenClose); };
+    bool getDCBypassTTC() { return getBool(ConfigKey::dcBypassTTC); };
+    bool getUseToggle() { return getBool(ConfigKey::useToggle); };
+    uint32_t getDCDebounceDuration() { return getInt(ConfigKey::dcDebounceDuration); };
+    bool getObstFromStatus() { return getBool(ConfigKey::obstFromStatus); };
+    uint32_t getBuiltInTTC() { return getInt(ConfigKey::builtInTTC); };
 #ifdef RATGDO32_DISCO
-    uint32_t getVehicleThreshold() { return std::get<int>(get(cfg_vehicleThreshold)); };
-    bool getLaserEnabled() { return std::get<bool>(get(cfg_laserEnabled)); };
-    bool getLaserHomeKit() { return std::get<bool>(get(cfg_laserHomeKit)); };
-    bool getVehicleHomeKit() { return std::get<bool>(get(cfg_vehicleHomeKit)); };
-    bool getVehicleOccupancyHomeKit() { return std::get<bool>(get(cfg_vehicleOccupancyHomeKit)); };
-    bool getVehicleArrivingHomeKit() { return std::get<bool>(get(cfg_vehicleArrivingHomeKit)); };
-    bool getVehicleDepartingHomeKit() { return std::get<bool>(get(cfg_vehicleDepartingHomeKit)); };
-    uint32_t getAssistDuration() { return std::get<int>(get(cfg_assistDuration)); };
+    uint32_t getVehicleThreshold() { return getInt(ConfigKey::vehicleThreshold); };
+    bool getLaserEnabled() { return getBool(ConfigKey::laserEnabled); };
+    bool getLaserHomeKit() { return getBool(ConfigKey::laserHomeKit); };
+    bool getVehicleHomeKit() { return getBool(ConfigKey::vehicleHomeKit); };
+    bool getVehicleOccupancyHomeKit() { return getBool(ConfigKey::vehicleOccupancyHomeKit); };
+    bool getVehicleArrivingHomeKit() { return getBool(ConfigKey::vehicleArrivingHomeKit); };
+    bool getVehicleDepartingHomeKit() { return getBool(ConfigKey::vehicleDepartingHomeKit); };
+    uint32_t getAssistDuration() { return getInt(ConfigKey::assistDuration); };
+#endif
+#ifdef USE_GDOLIB
+    bool getUseSWserial() { return getBool(ConfigKey::useSWserial); };
 #endif
 #ifndef ESP8266
-    bool getUseSWserial() { return std::get<bool>(get(cfg_useSWserial)); };
-    uint32_t getOccupancyDuration() { return std::get<int>(get(cfg_occupancyDuration)); };
-    bool getEnableIPv6() { return std::get<bool>(get(cfg_enableIPv6)); };
-    bool getEnableHomeSpanCLI() { return std::get<bool>(get(cfg_homespanCLI)); };
-    bool getLightHomeKit() { return std::get<bool>(get(cfg_lightHomeKit)); };
-    bool getMotionHomeKit() { return std::get<bool>(get(cfg_motionHomeKit)); };
+    uint32_t getOccupancyDuration() { return getInt(ConfigKey::occupancyDuration); };
+    bool getEnableIPv6() { return getBool(ConfigKey::enableIPv6); };
+    bool getEnableHomeSpanCLI() { return getBool(ConfigKey::homespanCLI); };
+    bool getLightHomeKit() { return getBool(ConfigKey::lightHomeKit); };
+    bool getMotionHomeKit() { return getBool(ConfigKey::motionHomeKit); };
 #endif
 #ifdef USE_DHT22
-    int getDHT22Pin() { return contains(cfg_dht22Pin) ? std::get<int>(get(cfg_dht22Pin)) : -1; };
-    char *getDHT22TempFormat() { return contains(cfg_dht22TempFormat) ? std::get<configStr>(get(cfg_dht22TempFormat)).str : (char*)"C"; };
+    int getDHT22Pin() { return getInt(ConfigKey::dht22Pin); };
+    configString getDHT22TempFormat() { return getStr(ConfigKey::dht22TempFormat); };
 #endif
 };
 extern userSettings *userConfig;
@@ -240,13 +432,43 @@ void delete_file(const char *filename);
 #define read_door_data read_blob_from_file
 #define write_door_data write_blob_to_file
 #define erase_door_data delete_file
+#define sync_door_data() // files are written immediately
 #else
+/****************************************************************************
+ * Write-behind NVRAM.  Values written are held in memory, repeated writes to
+ * the same key replace each other, and all pending values are written to flash
+ * and committed together by commit(), which is also a barrier for callers that
+ * must know a value is saved.  write(..., true) arms a timer that flushes after
+ * NVRAM_FLUSH_MS, write(..., false) leaves it to the caller to commit().  Reads
+ * see pending values.  loop() must be called regularly to run the timer.
+ */
+#define NVRAM_FLUSH_MS 5000
+#define NVRAM_NAMESPACE "ratgdo"
+
 class nvRamClass
 {
 private:
+    enum pendingType : uint8_t
+    {
+        PENDING_INT,
+        PENDING_STR,
+        PENDING_BLOB,
+    };
+    struct pendingValue
+    {
+        pendingType type;
+        int32_t value;    // if PENDING_INT
+        std::string data; // if PENDING_STR or PENDING_BLOB
+    };
     nvs_handle_t nvHandle;
+    SemaphoreHandle_t mutex;
+    std::map<std::string, pendingValue> pending; // key truncated to NVS maximum
+    uint32_t flushAt = 0;                        // millis() when timer expires
+    bool flushArmed = false;
     static nvRamClass *instancePtr;
     nvRamClass();
+    void stage(const std::string &key, pendingValue &&value, bool commit);
+    void flush();
 
 public:
     nvRamClass(const nvRamClass &obj) = delete;
@@ -263,8 +485,19 @@ public:
     bool writeBlob(const std::string &constKey, const void *value, size_t size, bool commit);
     bool writeBlob(const std::string &constKey, const void *value, size_t size) { return writeBlob(constKey, value, size, true); };
     bool readBlob(const std::string &constKey, void *value, size_t size);
+    bool readBlob(const std::string &constKey, std::string &value);
+    void commit();
+    void loop();
     bool erase(const std::string &constKey);
     void erase();
+    std::vector<std::string> keys();
+    void printStats(Print &outputDev);
+    uint32_t writes = 0;      // count of values written, before coalescing
+    uint32_t stored = 0;      // count of values written to flash
+    uint32_t commits = 0;     // count of NVRAM commits
+    uint32_t failures = 0;    // count of values that failed to write, kept pending for retry
+    uint32_t lastStallUs = 0; // time taken by last flush and commit
+    uint32_t maxStallUs = 0;  // longest flush and commit
 };
 extern nvRamClass *nvRam;
 #define read_door_int nvRam->read
@@ -274,4 +507,5 @@ extern nvRamClass *nvRam;
 #define read_door_data nvRam->readBlob
 #define write_door_data nvRam->writeBlob
 #define erase_door_data nvRam->erase
+#define sync_door_data() nvRam->commit()
 #endif
@@ -152,11 +152,13 @@ void homekit_event(homekit_event_t event)
     case homekit_event_t::HOMEKIT_EVENT_PAIRING_ADDED:
     {
         ESP_LOGI(TAG, "Pairing added");
+        gdo_changed(GDO_CHANGED_PAIRED);
         break;
     }
     case homekit_event_t::HOMEKIT_EVENT_PAIRING_REMOVED:
     {
         ESP_LOGI(TAG, "Pairing removed");
+        gdo_changed(GDO_CHANGED_PAIRED);
         break;
     }
     default:
@@ -414,7 +416,8 @@ void connectionCallback(int count)
     if (softAPmode)
         return;
 
-    // IPv4 Config
+    // IPv4 Config, published and saved together
+    userConfig->beginTransaction();
     userConfig->set(cfg_localIP, WiFi.localIP().toString().c_str());
     userConfig->set(cfg_gatewayIP, WiFi.gatewayIP().toString().c_str());
     userConfig->set(cfg_subnetMask, WiFi.subnetMask().toString().c_str());
@@ -422,6 +425,7 @@ void connectionCallback(int count)
     // Only update cfg_nameserverIP if it is an IPv4 address. .dnsIP() can return an IPv6 address if we have one from SLAAC
     if (WiFi.dnsIP().type() == IPv4)
         userConfig->set(cfg_nameserverIP, WiFi.dnsIP().toString().c_str());
+    userConfig->commitTransaction();
 
     // With WiFi connected, we can now initialize the rest of our app.
 #ifdef USE_GDOLIB
@@ -488,10 +492,12 @@ void statusCallback(HS_STATUS status)
     case HS_PAIRING_NEEDED:
         ESP_LOGI(TAG, "Status: Need to pair");
         isPaired = false;
+        gdo_changed(GDO_CHANGED_PAIRED);
         break;
     case HS_PAIRED:
         ESP_LOGI(TAG, "Status: Paired");
         isPaired = true;
+        gdo_changed(GDO_CHANGED_PAIRED);
         break;
     case HS_REBOOTING:
         rebooting = true;
@@ -914,7 +920,7 @@ void setup_homekit()
     enable_service_homekit_room_occupancy(userConfig->getOccupancyDuration() > 0);
 
 #ifdef USE_DHT22
-    int dht22Pin = userConfig->contains(cfg_dht22Pin) ? std::get<int>(userConfig->get(cfg_dht22Pin)) : -1;
+    int dht22Pin = userConfig->getDHT22Pin();
     if (dht22Pin >= 0) {
         ESP_LOGI(TAG, "Creating Temperature and Humidity Sensor accessory (DHT22 on pin %d)", dht22Pin);
         new SpanAccessory(HOMEKIT_AID_TEMP_HUMIDITY);
@@ -1267,7 +1273,7 @@ void notify_homekit_target_door_state_change(GarageDoorTargetState state)
 
 void notify_homekit_current_door_state_change(GarageDoorCurrentState state)
 {
-    garage_door.current_state = state;
+    GDO_SET(current_state, state, GDO_CHANGED_DOOR_STATE);
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1319,7 +1325,7 @@ void notify_homekit_target_lock(LockTargetState state)
 
 void notify_homekit_current_lock(LockCurrentState state)
 {
-    garage_door.current_lock = state;
+    GDO_SET(current_lock, state, GDO_CHANGED_LOCK_STATE);
     // Ignore invalid states
     if (state == 0xFF)
         return;
@@ -1341,7 +1347,7 @@ void notify_homekit_current_lock(LockCurrentState state)
 
 void notify_homekit_obstruction(bool state)
 {
-    garage_door.obstructed = state;
+    GDO_SET(obstructed, state, GDO_CHANGED_OBSTRUCTED);
 #ifdef ESP32
     if (!isPaired)
         return;
@@ -1360,7 +1366,7 @@ void notify_homekit_obstruction(bool state)
 
 void notify_homekit_light(bool state)
 {
-    garage_door.light = state;
+    GDO_SET(light, state, GDO_CHANGED_LIGHT);
 #ifdef ESP32
     if (!isPaired || !light)
         return;
@@ -1405,7 +1411,7 @@ void enable_service_homekit_motion(bool reboot)
 
 void notify_homekit_motion(bool state)
 {
-    garage_door.motion = state;
+    GDO_SET(motion, state, GDO_CHANGED_MOTION);
 #ifdef ESP32
     garage_door.motion_timer = (!state) ? 0 : _millis() + MOTION_TIMER_DURATION;
     if (!isPaired || !motion)
@@ -12,199 +12,204 @@
  * Jonathan Stroud...  https://github.com/jgstroud
  *
  */
+#pragma once
 
-inline char *start_json(char *s)
-{
-    return stpcpy(s, "{\n");
-}
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
 
-inline char *remove_comma_nl(char *s)
-{
-    // remove the comma newline added by last add_xxxx() function
-    if (*(s - 1) == '\n')
-        s--;
-    if (*(s - 1) == ',')
-        s--;
-    return s;
-}
-
-inline char *end_json(char *s, bool remove_nl = true)
+/****************************************************************************
+ * Bounded, allocation free, JSON writer.  Numbers are formatted directly into
+ * the buffer and output is single line, so it can be sent as an SSE event as-is.
+ * A member that will not fit is left out (the document is always valid JSON and
+ * null terminated) and overflow() reports that something was lost.
+ */
+class JsonWriter
 {
-    if (remove_nl)
-        s = remove_comma_nl(s);
-    return stpcpy(s, "\n}");
-}
+private:
+    char *p;
+    char *start;
+    char *end;          // one past last byte of buffer
+    bool first = true;  // next member is first in object, so no leading comma
+    bool lost = false;  // a member did not fit
+    bool closed = false;
 
-inline char *add_int(char *s, const char *k, int64_t v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, std::to_string(v).c_str());
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-inline char *add_int(char *s, const char *k, uint64_t v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, std::to_string(v).c_str());
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-inline char *add_int(char *s, const char *k, int32_t v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, std::to_string(v).c_str());
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-inline char *add_int(char *s, const char *k, uint32_t v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, std::to_string(v).c_str());
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-inline char *add_str(char *s, const char *k, const char *v, bool raw = false, bool comma_nl = true)
-{
-    if (k) // if key provided add it
+    // Keep space for closing brace and null terminator
+    inline bool put(char c)
     {
-        *s++ = '"';
-        s = stpcpy(s, k);
-        *s++ = '"';
-        *s++ = ':';
-        *s++ = ' ';
+        if (end - p < 3)
+            return false;
+        *p++ = c;
+        return true;
     }
-    else
+
+    inline bool put(const char *s)
     {
-        s = remove_comma_nl(s);
+        while (*s)
+            if (!put(*s++))
+                return false;
+        return true;
     }
-    if (v) // if value provided add it
+
+    bool putEscaped(const char *s)
     {
-        if (raw)
+        static const char hex[] = "0123456789abcdef";
+        bool ok = put('"');
+        for (; ok && *s; s++)
         {
-            // Do not wrap the value in quotes
-            s = stpcpy(s, v);
+            uint8_t c = *s;
+            if (c == '"' || c == '\\')
+                ok = put('\\') && put(c);
+            else if (c == '\n')
+                ok = put("\\n");
+            else if (c == '\r')
+                ok = put("\\r");
+            else if (c == '\t')
+                ok = put("\\t");
+            else if (c < 0x20)
+                ok = put("\\u00") && put(hex[c >> 4]) && put(hex[c & 0x0F]);
+            else
+                ok = put(c);
         }
+        return ok && put('"');
+    }
+
+    bool putUnsigned(uint64_t v)
+    {
+        char digits[20];
+        int n = 0;
+        do
+        {
+            digits[n++] = '0' + (v % 10);
+            v /= 10;
+        } while (v);
+        while (n)
+            if (!put(digits[--n]))
+                return false;
+        return true;
+    }
+
+    bool putSigned(int64_t v)
+    {
+        if (v < 0)
+            return put('-') && putUnsigned(-(uint64_t)v);
+        return putUnsigned(v);
+    }
+
+    // Write separator and key for a new member, call done() with result of writing the value.
+    inline bool key(const char *k)
+    {
+        return (first || put(',')) && put('"') && put(k) && put('"') && put(':');
+    }
+
+    // Complete a member, rolling back to mark if it did not fit.
+    bool done(char *mark, bool ok)
+    {
+        if (ok)
+            first = false;
         else
         {
-            // wrap the value in quotes and escape any quotes or backslashes in the value
-            *s++ = '"';
-            while (*v)
-            {
-                if (*v == '"' || *v == '\\')
-                {
-                    *s++ = '\\';
-                }
-                *s++ = *v++;
-            }
-            *s++ = '"';
+            p = mark;
+            lost = true;
         }
+        *p = 0;
+        return ok;
     }
-    if (comma_nl)
+
+public:
+    JsonWriter(char *buf, size_t size) : p(buf), start(buf), end(buf + size)
     {
-        *s++ = ',';
-        *s++ = '\n';
+        *p++ = '{';
+        *p = 0;
     }
-    *s = 0; // null terminate
-    return s;
-}
 
-inline char *add_bool(char *s, const char *k, bool v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, v ? "true" : "false");
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-inline char *add_float(char *s, const char *k, float v)
-{
-    *s++ = '"';
-    s = stpcpy(s, k);
-    *s++ = '"';
-    *s++ = ':';
-    *s++ = ' ';
-    s = stpcpy(s, std::to_string(v).c_str());
-    *s++ = ',';
-    *s++ = '\n';
-    *s = 0; // null terminate
-    return s;
-}
-
-#define JSON_START(buf) char *_json_p = start_json(buf)
-#define JSON_END() end_json(_json_p)
-#define JSON_ADD_INT(k, v) _json_p = add_int(_json_p, k, v)
-#define JSON_ADD_STR(k, v) _json_p = add_str(_json_p, k, v)
-#define JSON_ADD_BOOL(k, v) _json_p = add_bool(_json_p, k, v)
-#define JSON_ADD_FLOAT(k, v) _json_p = add_float(_json_p, k, v)
-#define JSON_ADD_RAW(k, v) _json_p = add_str(_json_p, k, v, true)               // value added without surrounding quotes
-#define JSON_INSERT_COMMA_NL() _json_p = add_str(_json_p, nullptr, ",\n", true) // insert a comma newline
-#define JSON_START_OBJ(k) _json_p = add_str(_json_p, k, "{\n", true, false)     // added without surrounding quotes and no comma newline
-#define JSON_END_OBJ() _json_p = add_str(_json_p, nullptr, "\n}", true)         // close curly without quotes and with comma newline
-#define JSON_START_ARRAY(k) _json_p = add_str(_json_p, k, "[\n", true, false)   // added without surrounding quotes and no comma newline
-#define JSON_END_ARRAY() _json_p = add_str(_json_p, nullptr, "\n]", true)       // close array without quotes and with comma newline
-
-#define JSON_ADD_INT_C(k, v, ov) \
-    {                            \
-        if (v != ov)             \
-        {                        \
-            ov = v;              \
-            JSON_ADD_INT(k, v);  \
-        }                        \
+    template <typename T>
+    bool addInt(const char *k, T v)
+    {
+        static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "addInt() requires integer value");
+        char *mark = p;
+        bool ok = key(k) && (std::is_signed<T>::value ? putSigned((int64_t)v) : putUnsigned((uint64_t)v));
+        return done(mark, ok);
+    }
+
+    // Fixed two decimal places, NaN or infinity is written as null.
+    bool addFloat(const char *k, float v)
+    {
+        char *mark = p;
+        bool ok = key(k);
+        if (ok && (isnan(v) || isinf(v)))
+        {
+            ok = put("null");
+        }
+        else if (ok)
+        {
+            int64_t hundredths = llroundf(v * 100.0f);
+            uint64_t a = (hundredths < 0) ? -(uint64_t)hundredths : hundredths;
+            ok = (hundredths >= 0 || put('-')) && putUnsigned(a / 100) && put('.') && put('0' + (a % 100) / 10) && put('0' + a % 10);
+        }
+        return done(mark, ok);
+    }
+
+    bool addBool(const char *k, bool v)
+    {
+        char *mark = p;
+        return done(mark, key(k) && put(v ? "true" : "false"));
+    }
+
+    bool addStr(const char *k, const char *v)
+    {
+        char *mark = p;
+        return done(mark, key(k) && ((v) ? putEscaped(v) : put("null")));
     }
-#define JSON_ADD_BOOL_C(k, v, ov) \
-    {                             \
-        if (v != ov)              \
-        {                         \
-            ov = v;               \
-            JSON_ADD_BOOL(k, v);  \
-        }                         \
+
+    // Value added without surrounding quotes or escaping, must be valid JSON.
+    bool addRaw(const char *k, const char *v)
+    {
+        char *mark = p;
+        return done(mark, key(k) && put(v));
     }
-#define JSON_ADD_STR_C(k, v, nv, ov) \
-    {                                \
-        if (nv != ov)                \
-        {                            \
-            ov = nv;                 \
-            JSON_ADD_STR(k, v);      \
-        }                            \
+
+    // Append all the members of another complete JSON object of length len.
+    bool addMembers(const char *doc, size_t len)
+    {
+        if (len <= 2)
+            return true;
+        char *mark = p;
+        bool ok = (first || put(',')) && ((size_t)(end - p) >= len - 2 + 2);
+        if (ok)
+        {
+            memcpy(p, doc + 1, len - 2);
+            p += len - 2;
+        }
+        return done(mark, ok);
     }
 
-#define JSON_REMOVE_NL(s)                        \
-    for (unsigned int i = 0; i < strlen(s); i++) \
-    {                                            \
-        if (s[i] == '\n')                        \
-            s[i] = ' ';                          \
+    // Close the document, returns length.
+    size_t finish()
+    {
+        if (!closed)
+        {
+            *p++ = '}';
+            *p = 0;
+            closed = true;
+        }
+        return p - start;
     }
+
+    size_t length() const { return p - start; }
+    bool empty() const { return first; }
+    bool overflow() const { return lost; }
+};
+
+#define JSON_START(buf, size) JsonWriter _json(buf, size)
+#define JSON_END() _json.finish()
+#define JSON_EMPTY() _json.empty()
+#define JSON_LENGTH() _json.length()
+#define JSON_OVERFLOW() _json.overflow()
+#define JSON_ADD_INT(k, v) _json.addInt(k, v)
+#define JSON_ADD_STR(k, v) _json.addStr(k, v)
+#define JSON_ADD_BOOL(k, v) _json.addBool(k, v)
+#define JSON_ADD_FLOAT(k, v) _json.addFloat(k, v)
+#define JSON_ADD_RAW(k, v) _json.addRaw(k, v) // value added without surrounding quotes
+#define JSON_ADD_MEMBERS(doc, len) _json.addMembers(doc, len)
@@ -34,22 +34,27 @@ LED::LED(uint8_t gpio_num, uint8_t state)
     pinMode(pin, OUTPUT);
 }
 
+void LED::setState(uint8_t state)
+{
+    digitalWrite(pin, state);
+    if (changedFlag && state != currentState)
+        gdo_changed(changedFlag);
+    currentState = state;
+}
+
 void LED::on()
 {
-    digitalWrite(pin, onState);
-    currentState = onState;
+    setState(onState);
 }
 
 void LED::off()
 {
-    digitalWrite(pin, offState);
-    currentState = offState;
+    setState(offState);
 }
 
 void LED::idle()
 {
-    digitalWrite(pin, idleState);
-    currentState = idleState;
+    setState(idleState);
 }
 
 void LED::setIdleState(uint8_t state)
@@ -75,8 +80,7 @@ void LED::flash(uint64_t ms)
     // Don't flash if we are already in a flash.
     if (!LEDtimer.active())
     {
-        digitalWrite(pin, activeState);
-        currentState = activeState;
+        setState(activeState);
         LEDtimer.once_ms(ms, [this]()
                          { this->idle(); });
     }
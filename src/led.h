@@ -28,7 +28,9 @@ private:
     uint8_t activeState = 1;
     uint8_t idleState = 0; // opposite of active
     uint8_t currentState = 0;
+    uint32_t changedFlag = 0; // garage_door_changed bits to set on state change
     Ticker LEDtimer;
+    void setState(uint8_t state);
 
 public:
     explicit LED(uint8_t gpio_num, uint8_t state = 1);
@@ -39,6 +41,7 @@ public:
     void flash(uint64_t ms = FLASH_MS);
     void setIdleState(uint8_t state);
     uint8_t getIdleState() { return idleState; };
+    void setChangedFlag(uint32_t flag) { changedFlag = flag; };
 };
 
 extern LED led;
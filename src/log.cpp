@@ -15,6 +15,7 @@
 
 // C/C++ language includes
 #include <stdint.h>
+#include <algorithm>
 
 // Arduino includes
 #include <WiFiUdp.h>
@@ -32,6 +33,10 @@
 // Logger tag
 static const char *TAG = "ratgdo-logger";
 
+// Absolute offsets into the message buffer wrap at a multiple of the buffer size,
+// so that offset modulo buffer size is always the position in the buffer.
+#define LOG_OFFSET_WRAP ((uint32_t)sizeof(logBuffer::buffer) * 0x10000)
+
 // Construct the singleton object for logger access
 LOG *LOG::instancePtr = new LOG();
 LOG *ratgdoLogger = LOG::getInstance();
@@ -114,12 +119,16 @@ void logToBuffer_P(const char *fmt, ...)
 #else
 // There is 8KB of RTC memory that can be set to not initialize on restart.
 // Data saved here will survive a crash and restart, but will not survive a power interruption.
+// Saved logs are compressed to fit more lines of context into the RTC budget, see logzCompress() below.
 typedef struct logSaveBuffer
 {
-    uint32_t wrapped;                                                   // two bytes
-    uint32_t head;                                                      // two bytes
-    char buffer[LOG_SAVE_BUFFER_SIZE - sizeof(wrapped) - sizeof(head)]; // sized so whole struct is LOG_SAVE_BUFFER_SIZE bytes
+    uint32_t magic;  // LOG_SAVE_MAGIC if buffer holds a valid log
+    uint16_t length; // bytes of compressed data in buffer
+    uint16_t size;   // bytes of log text that the data expands to
+    // sized so whole struct is LOG_SAVE_BUFFER_SIZE bytes
+    uint8_t buffer[LOG_SAVE_BUFFER_SIZE - sizeof(magic) - sizeof(length) - sizeof(size)];
 } logSaveBuffer;
+#define LOG_SAVE_MAGIC 0x4C4F475A // "LOGZ"
 
 RTC_NOINIT_ATTR logSaveBuffer rtcRebootLog;
 RTC_NOINIT_ATTR logSaveBuffer rtcCrashLog;
@@ -138,6 +147,243 @@ const int rtcSize = sizeof(rtcRebootLog) + sizeof(rtcCrashLog) + sizeof(rebootTi
 #define TAKE_MUTEX() xSemaphoreTakeRecursive(logMutex, portMAX_DELAY)
 #define GIVE_MUTEX() xSemaphoreGiveRecursive(logMutex)
 
+/****************************************************************************
+ * Compression of saved logs.  Log text is highly repetitive (tags, timestamps,
+ * the same messages over and over) so a simple LZ scheme with a small window
+ * and a dictionary of common strings roughly doubles the lines we can keep.
+ *
+ * We compress the message buffer backwards, newest byte first, so that when the
+ * save buffer fills up we have kept the most recent lines.  Compressed stream
+ * is a sequence of tokens...
+ *   0LLLLLLL            literal run of L+1 bytes follow
+ *   10LLLLLL OOOOOOOO   copy L+LOGZ_MIN_MATCH bytes from O+1 bytes back
+ *   11IIIIII            copy dictionary entry I
+ * Decompressing produces the text in reverse order.
+ */
+#define LOGZ_WINDOW 256
+#define LOGZ_MIN_MATCH 3
+#define LOGZ_MAX_MATCH (LOGZ_MIN_MATCH + 0x3F)
+#define LOGZ_MAX_LITERALS 0x80
+
+// Maximum of 64 entries.  Changing this invalidates any log saved by previous firmware.
+static const char *const logzDictionary[] = {
+    "ratgdo-comms: ",
+    "ratgdo-config: ",
+    "ratgdo-drycontact: ",
+    "ratgdo-homekit: ",
+    "ratgdo-http: ",
+    "ratgdo-improv: ",
+    "ratgdo-led: ",
+    "ratgdo-logger: ",
+    "ratgdo-main: ",
+    "ratgdo-packet: ",
+    "ratgdo-reader: ",
+    "ratgdo-serialCLI: ",
+    "ratgdo-softAP: ",
+    "ratgdo-utils: ",
+    "ratgdo-vehicle: ",
+    "\nI (",
+    "\nE (",
+    "\nW (",
+    "\nD (",
+    "\nV (",
+    "Client ",
+    "GDO event: ",
+    "HomeKit ",
+    "subscription",
+    "SSE ",
+    "requesting: ",
+    "packet",
+    "status",
+    "door",
+    "light",
+    "obstruction",
+    "motion",
+    "error",
+    "HTTP_GET",
+};
+#define LOGZ_DICT_SIZE (sizeof(logzDictionary) / sizeof(logzDictionary[0]))
+
+// Reads the message ring buffer backwards, at(0) is the newest byte.
+struct logzReader
+{
+    const char *buf;
+    uint32_t size;
+    uint32_t end;
+    uint32_t len;
+    inline char at(uint32_t k) const { return (k < end) ? buf[end - 1 - k] : buf[size + end - 1 - k]; }
+};
+
+// Returns length of longest match at position k (zero if none), from dictionary or from window.
+static uint32_t logzFindMatch(const logzReader &in, uint32_t k, uint32_t *offset, int32_t *dict)
+{
+    uint32_t maxLen = std::min((uint32_t)LOGZ_MAX_MATCH, in.len - k);
+    uint32_t bestLen = 0;
+    *dict = -1;
+    for (uint32_t d = 0; d < LOGZ_DICT_SIZE; d++)
+    {
+        const char *w = logzDictionary[d];
+        uint32_t wl = strlen(w);
+        if (wl > in.len - k || wl <= bestLen)
+            continue;
+        uint32_t j = 0;
+        while (j < wl && in.at(k + j) == w[wl - 1 - j])
+            j++;
+        if (j == wl)
+        {
+            bestLen = wl;
+            *dict = d;
+        }
+    }
+    char c0 = in.at(k);
+    for (uint32_t off = 1; off <= LOGZ_WINDOW && off <= k && bestLen < maxLen; off++)
+    {
+        if (in.at(k - off) != c0)
+            continue;
+        uint32_t j = 1;
+        while (j < maxLen && in.at(k - off + j) == in.at(k + j))
+            j++;
+        if (j > bestLen && j >= LOGZ_MIN_MATCH)
+        {
+            bestLen = j;
+            *offset = off;
+            *dict = -1;
+        }
+    }
+    return bestLen;
+}
+
+// Compress as much of the input as fits in outMax bytes.  Returns compressed length and
+// sets consumed to number of input bytes that the compressed data expands to.
+static size_t logzCompress(const logzReader &in, uint8_t *out, size_t outMax, uint32_t *consumed)
+{
+    size_t o = 0;
+    uint32_t k = 0;   // next input byte to encode
+    uint32_t lit = 0; // first of any pending literal bytes
+    while (true)
+    {
+        uint32_t offset = 0;
+        int32_t dict = -1;
+        uint32_t len = (k < in.len) ? logzFindMatch(in, k, &offset, &dict) : 0;
+        uint32_t n = k - lit;
+        if (n && (len || k == in.len || n == LOGZ_MAX_LITERALS))
+        {
+            // Flush pending literals, truncating if we are out of space.
+            if (o + 1 + n > outMax)
+            {
+                n = (outMax > o + 1) ? outMax - o - 1 : 0;
+                if (n == 0)
+                    break;
+            }
+            out[o++] = n - 1;
+            for (uint32_t i = 0; i < n; i++)
+                out[o++] = in.at(lit++);
+            if (lit < k)
+                break;
+        }
+        if (k == in.len)
+            break;
+        if (len)
+        {
+            if (o + ((dict >= 0) ? 1 : 2) > outMax)
+                break;
+            if (dict >= 0)
+            {
+                out[o++] = 0xC0 | dict;
+            }
+            else
+            {
+                out[o++] = 0x80 | (len - LOGZ_MIN_MATCH);
+                out[o++] = offset - 1;
+            }
+            k += len;
+            lit = k;
+        }
+        else
+        {
+            k++;
+        }
+    }
+    *consumed = lit;
+    return o;
+}
+
+// Returns number of bytes written to out, in reverse order.  Stops at first invalid token.
+static size_t logzDecompress(const uint8_t *in, size_t inLen, char *out, size_t outMax)
+{
+    size_t i = 0;
+    size_t o = 0;
+    while (i < inLen)
+    {
+        uint8_t t = in[i++];
+        if (t < 0x80)
+        {
+            size_t n = t + 1;
+            if (i + n > inLen || o + n > outMax)
+                break;
+            memcpy(&out[o], &in[i], n);
+            i += n;
+            o += n;
+        }
+        else if (t < 0xC0)
+        {
+            if (i >= inLen)
+                break;
+            size_t len = (t & 0x3F) + LOGZ_MIN_MATCH;
+            size_t off = in[i++] + 1;
+            if (off > o || o + len > outMax)
+                break;
+            for (size_t j = 0; j < len; j++, o++)
+                out[o] = out[o - off];
+        }
+        else
+        {
+            size_t d = t & 0x3F;
+            if (d >= LOGZ_DICT_SIZE)
+                break;
+            const char *w = logzDictionary[d];
+            size_t wl = strlen(w);
+            if (o + wl > outMax)
+                break;
+            for (size_t j = 0; j < wl; j++)
+                out[o++] = w[wl - 1 - j];
+        }
+    }
+    return o;
+}
+
+// Called from panic handler, so no logging, no mutex and no malloc.
+static void saveLogBuffer(logSaveBuffer *save, const logBuffer *msg)
+{
+    // head points to null terminator, so exclude that when the buffer has wrapped.
+    logzReader in = {msg->buffer, sizeof(msg->buffer), msg->head, (msg->wrapped) ? sizeof(msg->buffer) - 1 : msg->head};
+    uint32_t consumed = 0;
+    save->length = logzCompress(in, save->buffer, sizeof(save->buffer), &consumed);
+    save->size = consumed;
+    save->magic = LOG_SAVE_MAGIC;
+}
+
+static void printSavedLogBuffer(const logSaveBuffer *save, Print &outputDev)
+{
+    if (save->magic != LOG_SAVE_MAGIC || save->length > sizeof(save->buffer))
+    {
+        outputDev.print("No saved message log available.\n");
+        return;
+    }
+    char *text = static_cast<char *>(malloc(save->size + 1));
+    if (!text)
+    {
+        outputDev.print("Insufficient memory to expand saved message log.\n");
+        return;
+    }
+    size_t len = logzDecompress(save->buffer, save->length, text, save->size);
+    std::reverse(text, text + len);
+    outputDev.printf("Saved message log: %d lines, %d bytes (compressed to %d bytes)\n\n",
+                     (int)std::count(text, text + len, '\n'), (int)len, (int)save->length);
+    outputDev.write(text, len);
+    free(text);
+}
+
 void panic_handler(arduino_panic_info_t *info, void *arg)
 {
     // As precaution... reset UART pins as failing to do this could cause the door to open/close
@@ -150,21 +396,8 @@ void panic_handler(arduino_panic_info_t *info, void *arg)
     crashCount = (crashCount < 0) ? 1 : crashCount + 1;
     crashTime = (clockSet) ? time(NULL) : 0;
     esp_rom_printf("Panic Handler, crash count %d\n", crashCount);
-    size_t len = sizeof(rtcCrashLog.buffer);
-    uint32_t end = (ratgdoLogger->msgBuffer->head + 1) % sizeof(ratgdoLogger->msgBuffer->buffer); // include the null terminator
-    uint32_t start = (sizeof(ratgdoLogger->msgBuffer->buffer) + end - len) % sizeof(ratgdoLogger->msgBuffer->buffer);
-    rtcCrashLog.wrapped = 0;
-    rtcCrashLog.head = len - 1; // end of the buffer
-    if (start >= ratgdoLogger->msgBuffer->head)
-    {
-        len = (sizeof(ratgdoLogger->msgBuffer->buffer) - start) * ratgdoLogger->msgBuffer->wrapped;
-        memcpy(&rtcCrashLog.buffer[0], &ratgdoLogger->msgBuffer->buffer[start], len);
-        memcpy(&rtcCrashLog.buffer[len], &ratgdoLogger->msgBuffer->buffer[0], end);
-    }
-    else
-    {
-        memcpy(&rtcCrashLog.buffer[0], &ratgdoLogger->msgBuffer->buffer[start], len);
-    }
+    saveLogBuffer(&rtcCrashLog, ratgdoLogger->msgBuffer);
+    esp_rom_printf("Saved %d bytes of message log in %d bytes\n", rtcCrashLog.size, rtcCrashLog.length);
     strlcpy(reasonString, info->reason, sizeof(reasonString));
     strlcpy(crashVersion, AUTO_VERSION, sizeof(crashVersion));
 }
@@ -206,11 +439,82 @@ LOG::LOG()
     memset(msgBuffer->buffer, 0, sizeof(msgBuffer->buffer));
     msgBuffer->wrapped = 0;
     msgBuffer->head = 0;
+    lineIndex = static_cast<uint32_t *>(malloc(LOG_INDEX_SIZE * sizeof(uint32_t)));
+    lineSeq = 0;
+    totalWritten = 0;
+    memset(&stats, 0, sizeof(stats));
+    memset(rateSites, 0, sizeof(rateSites));
 }
 
+// Returns the log level of a line based on the first character, as set by ESP_LOGx()
+esp_log_level_t logLineLevel(const char *line)
+{
+    switch (*line)
+    {
+    case 'E':
+        return ESP_LOG_ERROR;
+    case 'W':
+        return ESP_LOG_WARN;
+    case 'D':
+        return ESP_LOG_DEBUG;
+    case 'V':
+        return ESP_LOG_VERBOSE;
+    default:
+        return ESP_LOG_INFO;
+    }
+}
+
+// Returns true if line was logged with one of the tags in a comma separated list,
+// format of line is "I (HH:MM:SS.mmm) tag: message"
+bool logLineHasTag(const char *line, const char *tags)
+{
+    const char *p = strchr(line, ')');
+    if (!p || p[1] != ' ')
+        return false;
+    p += 2;
+    const char *colon = strchr(p, ':');
+    if (!colon)
+        return false;
+    size_t len = colon - p;
+    while (*tags)
+    {
+        const char *end = strchr(tags, ',');
+        if (!end)
+            end = tags + strlen(tags);
+        if ((size_t)(end - tags) == len && strncmp(p, tags, len) == 0)
+            return true;
+        tags = (*end) ? end + 1 : end;
+    }
+    return false;
+}
+
+#ifdef LOG_STATS
+// Time each stage of logToBuffer(), build with -D LOG_STATS to measure cost of logging.
+#define LOG_STAGE(t) uint32_t t = micros()
+#else
+#define LOG_STAGE(t)
+#endif
+
 void LOG::logToBuffer(const char *fmt, va_list args)
 {
     TAKE_MUTEX();
+    LOG_STAGE(t0);
+    uint32_t suppressed = 0;
+    // Errors and warnings are never rate limited, they are what we need to see when a fault
+    // floods the log.  Level is the first character of the format string, see logLineLevel().
+#ifdef ESP8266
+    char levelChar = pgm_read_byte(fmt);
+#else
+    char levelChar = *fmt;
+#endif
+    if (levelChar != 'E' && levelChar != 'W' && rateLimited(fmt, &suppressed))
+    {
+        // Drop the line before we spend any time formatting it
+        stats.suppressed++;
+        dropped++;
+        GIVE_MUTEX();
+        return;
+    }
     // parse the format string into lineBuffer
     vsnprintf(lineBuffer, LINE_BUFFER_SIZE, fmt, args);
     // If timestamp is wrapped in () and not [] then message is from one of the ESP_LOGx() functions.
@@ -230,18 +534,43 @@ void LOG::logToBuffer(const char *fmt, va_list args)
         lineBuffer[LINE_BUFFER_SIZE - 2] = '\n';
         lineBuffer[LINE_BUFFER_SIZE - 1] = 0;
     }
+    uint32_t others = evictedSuppressed;
+    evictedSuppressed = 0;
+    if (suppressed || others)
+    {
+        // Note how many lines from this call site were dropped since it was last logged, and
+        // from call sites that lost their rate limit slot before they could report it. Make
+        // room at the end of the line if it was truncated.
+        size_t end = std::min(strlen(lineBuffer), (size_t)LINE_BUFFER_SIZE - 48);
+        if (end && lineBuffer[end - 1] == '\n')
+            end--;
+        if (!others)
+            snprintf(&lineBuffer[end], LINE_BUFFER_SIZE - end, " [%lu similar suppressed]\n", suppressed);
+        else if (!suppressed)
+            snprintf(&lineBuffer[end], LINE_BUFFER_SIZE - end, " [%lu other suppressed]\n", others);
+        else
+            snprintf(&lineBuffer[end], LINE_BUFFER_SIZE - end, " [%lu similar, %lu other suppressed]\n", suppressed, others);
+    }
+    LOG_STAGE(t1);
 
     //  print line to the serial port
     SERIAL_PRINT(lineBuffer);
+    LOG_STAGE(t2);
 
     // copy the line into the message save buffer
     size_t len = strlen(lineBuffer);
     size_t available = sizeof(msgBuffer->buffer) - msgBuffer->head;
+    // note where this line starts, so we can find it again by sequence number
+    lineSeq++;
+    if (lineIndex)
+        lineIndex[lineSeq % LOG_INDEX_SIZE] = totalWritten;
+    totalWritten = (totalWritten + len) % LOG_OFFSET_WRAP;
     memcpy(&msgBuffer->buffer[msgBuffer->head], lineBuffer, min(available, len));
-    if (available < len)
+    if (available <= len)
     {
         // we wrapped on the available buffer space
         msgBuffer->wrapped = 1;
+        stats.wraps++;
         msgBuffer->head = len - available;
         memcpy(msgBuffer->buffer, &lineBuffer[available], msgBuffer->head);
     }
@@ -250,6 +579,7 @@ void LOG::logToBuffer(const char *fmt, va_list args)
         msgBuffer->head += len;
     }
     msgBuffer->buffer[msgBuffer->head] = 0; // null terminate
+    LOG_STAGE(t3);
 
     static bool inFn = false;
     if (!inFn)
@@ -264,10 +594,145 @@ void LOG::logToBuffer(const char *fmt, va_list args)
         logToSyslog(lineBuffer);
         inFn = false;
     }
+    LOG_STAGE(t4);
+
+    esp_log_level_t level = logLineLevel(lineBuffer);
+    stats.count[level]++;
+    stats.bytes += len;
+#ifdef LOG_STATS
+    // accumulate cost of logging, so we can see impact on hot code paths
+    stats.totalUs[level] += t4 - t0;
+    stats.maxUs[level] = std::max(stats.maxUs[level], t4 - t0);
+    stats.formatUs += t1 - t0;
+    stats.serialUs += t2 - t1;
+    stats.bufferUs += t3 - t2;
+    stats.broadcastUs += t4 - t3;
+#endif
     GIVE_MUTEX();
     return;
 }
 
+// Token bucket rate limit per call site, identified by address of the format string.  Returns
+// true if the line should be dropped, otherwise sets suppressed to number of lines dropped since
+// this call site last logged.
+bool LOG::rateLimited(const char *fmt, uint32_t *suppressed)
+{
+    uint32_t now = millis();
+    logRateSite *site = NULL;
+    logRateSite *oldest = &rateSites[0];
+    for (int i = 0; i < LOG_RATE_SITES; i++)
+    {
+        if (rateSites[i].fmt == fmt)
+        {
+            site = &rateSites[i];
+            break;
+        }
+        if (!rateSites[i].fmt || (now - rateSites[i].lastMillis) > (now - oldest->lastMillis))
+            oldest = &rateSites[i];
+    }
+    if (!site)
+    {
+        // Not seen recently, take over the least recently used slot. Carry forward what the
+        // evicted call site dropped, so it is still reported on the next line logged.
+        site = oldest;
+        if (site->fmt)
+        {
+            evictedSuppressed += site->suppressed;
+            stats.evicted += site->total;
+        }
+        site->fmt = fmt;
+        site->tokens = LOG_RATE_BURST * 1000;
+        site->lastMillis = now;
+        site->suppressed = 0;
+        site->total = 0;
+    }
+    // Refill the bucket, limit elapsed time so multiply cannot overflow.
+    uint32_t elapsed = std::min(now - site->lastMillis, (uint32_t)(LOG_RATE_BURST * 1000 / LOG_RATE_PER_SEC));
+    site->tokens = std::min(site->tokens + elapsed * LOG_RATE_PER_SEC, (uint32_t)(LOG_RATE_BURST * 1000));
+    site->lastMillis = now;
+    if (site->tokens < 1000)
+    {
+        site->suppressed++;
+        site->total++;
+        return true;
+    }
+    site->tokens -= 1000;
+    *suppressed = site->suppressed;
+    site->suppressed = 0;
+    return false;
+}
+
+void LOG::resetStats()
+{
+    TAKE_MUTEX();
+    memset(&stats, 0, sizeof(stats));
+    stats.since = millis();
+    for (int i = 0; i < LOG_RATE_SITES; i++)
+        rateSites[i].total = 0;
+    GIVE_MUTEX();
+}
+
+void LOG::printStats(Print &outputDev)
+{
+    static const char levelChar[] = "NEWIDV";
+    TAKE_MUTEX();
+    logStats copy = stats;
+    logRateSite sites[LOG_RATE_SITES];
+    memcpy(sites, rateSites, sizeof(sites));
+    GIVE_MUTEX();
+    uint32_t lines = 0;
+    outputDev.printf("Log statistics for last %lu seconds\n", (millis() - copy.since) / 1000);
+#ifdef LOG_STATS
+    uint64_t totalUs = 0;
+    outputDev.print("Level   Lines   Avg us   Max us\n");
+    for (int i = ESP_LOG_ERROR; i <= ESP_LOG_VERBOSE; i++)
+    {
+        lines += copy.count[i];
+        totalUs += copy.totalUs[i];
+        outputDev.printf("    %c %7lu %8lu %8lu\n", levelChar[i], copy.count[i],
+                         (copy.count[i]) ? (uint32_t)(copy.totalUs[i] / copy.count[i]) : 0, copy.maxUs[i]);
+    }
+#else
+    outputDev.print("Level   Lines\n");
+    for (int i = ESP_LOG_ERROR; i <= ESP_LOG_VERBOSE; i++)
+    {
+        lines += copy.count[i];
+        outputDev.printf("    %c %7lu\n", levelChar[i], copy.count[i]);
+    }
+#endif
+    if (copy.suppressed)
+    {
+        outputDev.printf("Rate limited (%d lines/sec, burst %d), lines suppressed: %lu\n", LOG_RATE_PER_SEC, LOG_RATE_BURST, copy.suppressed);
+        for (int i = 0; i < LOG_RATE_SITES; i++)
+        {
+            if (!sites[i].fmt || !sites[i].total)
+                continue;
+            // format string may be in PROGMEM on ESP8266
+            char fmt[48];
+            strncpy_P(fmt, sites[i].fmt, sizeof(fmt) - 1);
+            fmt[sizeof(fmt) - 1] = 0;
+            for (char *p = fmt; *p; p++)
+                if (*p == '\n')
+                    *p = ' ';
+            outputDev.printf("%9lu  %s\n", sites[i].total, fmt);
+        }
+        if (copy.evicted)
+        {
+            outputDev.printf("%9lu  (call sites no longer tracked)\n", copy.evicted);
+        }
+    }
+    if (lines == 0)
+        return;
+    outputDev.printf("Average line length: %lu bytes, buffer wrapped %lu times\n", copy.bytes / lines, copy.wraps);
+#ifdef LOG_STATS
+    outputDev.printf("Average us per line, format: %lu, serial: %lu, buffer: %lu, SSE/syslog: %lu, total: %lu\n",
+                     (uint32_t)(copy.formatUs / lines), (uint32_t)(copy.serialUs / lines), (uint32_t)(copy.bufferUs / lines),
+                     (uint32_t)(copy.broadcastUs / lines), (uint32_t)(totalUs / lines));
+#else
+    outputDev.print("Build with -D LOG_STATS for time spent per log line\n");
+#endif
+}
+
 void LOG::clearCrashLog()
 {
 #ifdef ESP8266
@@ -319,13 +784,7 @@ void LOG::printCrashLog(Print &outputDev)
         outputDev.printf("Crash reason: %s\n", reasonString);
         outputDev.printf("Firmware version: %s\n\n", crashVersion);
         outputDev.flush();
-        // head points to a zero (null terminator of previous log line) which we need to skip.
-        size_t start = (rtcCrashLog.head + 1) % sizeof(rtcCrashLog.buffer);
-        if (rtcCrashLog.wrapped != 0)
-        {
-            outputDev.write(&rtcCrashLog.buffer[start], sizeof(rtcCrashLog.buffer) - start);
-        }
-        outputDev.print(rtcCrashLog.buffer); // assumes null terminated
+        printSavedLogBuffer(&rtcCrashLog, outputDev);
     }
 
     if (esp_core_dump_image_check() == ESP_OK)
@@ -369,24 +828,11 @@ void LOG::saveMessageLog()
 {
     ESP_LOGI(TAG, "Save message log buffer");
     TAKE_MUTEX();
-    size_t len = sizeof(rtcRebootLog.buffer);
-    uint32_t end = (msgBuffer->head + 1) % sizeof(msgBuffer->buffer); // include the null terminator
-    uint32_t start = (sizeof(msgBuffer->buffer) + end - len) % sizeof(msgBuffer->buffer);
-    rtcRebootLog.wrapped = 0;
-    rtcRebootLog.head = len - 1; // end of the buffer
-    if (start >= msgBuffer->head)
-    {
-        len = (sizeof(msgBuffer->buffer) - start) * msgBuffer->wrapped;
-        memcpy(&rtcRebootLog.buffer[0], &msgBuffer->buffer[start], len);
-        memcpy(&rtcRebootLog.buffer[len], &msgBuffer->buffer[0], end);
-    }
-    else
-    {
-        memcpy(&rtcRebootLog.buffer[0], &msgBuffer->buffer[start], len);
-    }
+    saveLogBuffer(&rtcRebootLog, msgBuffer);
     rebootTime = (clockSet) ? time(NULL) : 0;
     rebootUpTime = _millis();
     GIVE_MUTEX();
+    ESP_LOGI(TAG, "Saved %d bytes of message log in %d bytes", rtcRebootLog.size, rtcRebootLog.length);
 }
 #endif
 
@@ -436,7 +882,7 @@ void LOG::printSavedLog(Print &outputDev)
         outputDev.printf("Server uptime: %llu ms (%s)\n", rebootUpTime, toHHMMSSmmm((_millis_t)rebootUpTime));
         outputDev.println("Firmware version: " AUTO_VERSION);
         outputDev.flush();
-        outputDev.print(rtcRebootLog.buffer);
+        printSavedLogBuffer(&rtcRebootLog, outputDev);
     }
     else
     {
@@ -445,9 +891,8 @@ void LOG::printSavedLog(Print &outputDev)
 #endif
 }
 
-void LOG::printMessageLog(Print &outputDev, bool slow)
+void LOG::printMessageLogHeader(Print &outputDev)
 {
-    TAKE_MUTEX();
     if (clockSet)
     {
         time_t now = time(NULL);
@@ -460,6 +905,12 @@ void LOG::printMessageLog(Print &outputDev, bool slow)
     outputDev.printf_P(PSTR("Free heap: %d\n"), free_heap);
     outputDev.printf_P(PSTR("Minimum heap: %d\n"), min_heap);
     outputDev.flush();
+}
+
+void LOG::printMessageLog(Print &outputDev, bool slow)
+{
+    TAKE_MUTEX();
+    printMessageLogHeader(outputDev);
 
     if (msgBuffer)
     {
@@ -504,6 +955,62 @@ void LOG::printMessageLog(Print &outputDev, bool slow)
     GIVE_MUTEX();
 }
 
+// Print log lines with sequence number greater than "after" and up to and including "upTo",
+// optionally filtered by maximum log level, tag and a string the line must contain.  Lines that
+// are no longer in the buffer are skipped.  Returns the sequence number of the last line that
+// was considered.
+uint32_t LOG::printMessagesSince(Print &outputDev, uint32_t after, uint32_t upTo, esp_log_level_t level, const char *tag, const char *match)
+{
+    char line[LINE_BUFFER_SIZE];
+    if (!msgBuffer || !lineIndex)
+        return after;
+
+    if (tag && *tag == 0)
+        tag = nullptr;
+    if (match && *match == 0)
+        match = nullptr;
+
+    for (uint32_t seq = after + 1; (int32_t)(upTo - seq) >= 0; seq++)
+    {
+        // Copy the line out while holding the mutex, so we do not block
+        // other tasks from logging while we write to (slow) output device.
+        size_t len = 0;
+        TAKE_MUTEX();
+        if ((lineSeq - seq) < LOG_INDEX_SIZE)
+        {
+            uint32_t start = lineIndex[seq % LOG_INDEX_SIZE];
+            uint32_t end = (seq == lineSeq) ? totalWritten : lineIndex[(seq + 1) % LOG_INDEX_SIZE];
+            if (((totalWritten + LOG_OFFSET_WRAP - start) % LOG_OFFSET_WRAP) < sizeof(msgBuffer->buffer))
+            {
+                len = std::min((size_t)((end + LOG_OFFSET_WRAP - start) % LOG_OFFSET_WRAP), sizeof(line) - 1);
+                size_t pos = start % sizeof(msgBuffer->buffer);
+                size_t first = std::min(len, sizeof(msgBuffer->buffer) - pos);
+                memcpy(line, &msgBuffer->buffer[pos], first);
+                memcpy(&line[first], msgBuffer->buffer, len - first);
+            }
+        }
+        else if ((int32_t)(lineSeq - LOG_INDEX_SIZE + 1 - seq) > 0)
+        {
+            // skip forward to oldest line we still have an index for (loop increments seq)
+            seq = lineSeq - LOG_INDEX_SIZE;
+        }
+        GIVE_MUTEX();
+        if (len == 0)
+            continue;
+
+        line[len] = 0;
+        if (logLineLevel(line) > level)
+            continue;
+        if (tag && !logLineHasTag(line, tag))
+            continue;
+        if (match && !strstr(line, match))
+            continue;
+        outputDev.write(line, len);
+    }
+    outputDev.flush();
+    return upTo;
+}
+
 /****************************************************************************
  * Syslog
  */
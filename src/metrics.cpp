@@ -0,0 +1,201 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+// C/C++ language includes
+#include <string.h>
+
+// RATGDO project includes
+#include "ratgdo.h"
+#include "metrics.h"
+
+// Logger tag
+static const char *TAG = "ratgdo-metrics";
+
+// 100us .. 100ms, main loop should normally complete in well under a millisecond
+const uint32_t metricBucketsLoop[METRICS_MAX_BUCKETS] = {100, 250, 500, 1000, 2500, 10000, 25000, 100000};
+// 1ms .. 2.5s, covers everything from cached status to firmware upload chunks
+const uint32_t metricBucketsHttp[METRICS_MAX_BUCKETS] = {1000, 2500, 5000, 10000, 25000, 100000, 500000, 2500000};
+
+static metric metrics[METRICS_MAX];
+static metricHistogram histograms[METRICS_MAX_HISTOGRAMS];
+static uint32_t metricCount = 0;
+static uint32_t histogramCount = 0;
+
+#ifndef ESP8266
+// Registration and observations can happen from main loop and web server task at the same time
+static portMUX_TYPE metricsMux = portMUX_INITIALIZER_UNLOCKED;
+#define METRICS_LOCK() portENTER_CRITICAL(&metricsMux)
+#define METRICS_UNLOCK() portEXIT_CRITICAL(&metricsMux)
+#else
+#define METRICS_LOCK()
+#define METRICS_UNLOCK()
+#endif
+
+// Entry is filled in under the lock, so metrics_render() never sees a partially initialized metric.
+static metric *metric_register(const char *name, const char *help, const char *labels, MetricType type, uint32_t (*fn)(), metricHistogram *hist = NULL, uint8_t nBuckets = 0)
+{
+    metric *m = NULL;
+    METRICS_LOCK();
+    if (metricCount < METRICS_MAX)
+    {
+        m = &metrics[metricCount];
+        m->name = name;
+        m->help = help;
+        m->labels = labels;
+        m->type = type;
+        m->nBuckets = nBuckets;
+        m->fn = fn;
+        if (hist)
+            m->hist = hist;
+        else
+            m->value = 0;
+        metricCount++;
+    }
+    METRICS_UNLOCK();
+    if (!m)
+    {
+        ESP_LOGW(TAG, "Metrics registry full, %s not registered", name);
+    }
+    return m;
+}
+
+metric *metric_counter(const char *name, const char *help, const char *labels, uint32_t (*fn)())
+{
+    return metric_register(name, help, labels, METRIC_COUNTER, fn);
+}
+
+metric *metric_gauge(const char *name, const char *help, const char *labels, uint32_t (*fn)())
+{
+    return metric_register(name, help, labels, METRIC_GAUGE, fn);
+}
+
+metric *metric_histogram(const char *name, const char *help, const uint32_t *bounds, uint8_t nBuckets, const char *labels)
+{
+    metricHistogram *h = NULL;
+    METRICS_LOCK();
+    if (histogramCount < METRICS_MAX_HISTOGRAMS)
+        h = &histograms[histogramCount++];
+    METRICS_UNLOCK();
+    if (!h)
+    {
+        ESP_LOGW(TAG, "Metrics histograms full, %s not registered", name);
+        return NULL;
+    }
+    memset(h, 0, sizeof(metricHistogram));
+    h->bounds = bounds;
+    return metric_register(name, help, labels, METRIC_HISTOGRAM, NULL, h, (nBuckets < METRICS_MAX_BUCKETS) ? nBuckets : METRICS_MAX_BUCKETS);
+}
+
+void metric_observe(metric *m, uint32_t us)
+{
+    if (!m || m->type != METRIC_HISTOGRAM)
+        return;
+    metricHistogram *h = m->hist;
+    METRICS_LOCK();
+    for (uint8_t i = 0; i < m->nBuckets; i++)
+    {
+        if (us <= h->bounds[i])
+        {
+            h->buckets[i]++;
+            break;
+        }
+    }
+    h->count++;
+    h->sum += us;
+    METRICS_UNLOCK();
+}
+
+// Prometheus values are in seconds, print microseconds without going through floating point.
+static void printSeconds(Print &out, uint64_t us)
+{
+    out.printf("%lu.%06lu", (uint32_t)(us / 1000000), (uint32_t)(us % 1000000));
+}
+
+// Print name, suffix and label set, adding the "le" label for histogram buckets.
+static void printSeries(Print &out, const metric *m, const char *suffix, const uint32_t *le = NULL, bool inf = false)
+{
+    out.print(m->name);
+    if (suffix)
+        out.print(suffix);
+    bool hasLabels = m->labels && *m->labels;
+    if (!hasLabels && !le && !inf)
+    {
+        out.print(' ');
+        return;
+    }
+    out.print('{');
+    if (hasLabels)
+        out.print(m->labels);
+    if (le || inf)
+    {
+        if (hasLabels)
+            out.print(',');
+        out.print("le=\"");
+        if (inf)
+            out.print("+Inf");
+        else
+            printSeconds(out, *le);
+        out.print('"');
+    }
+    out.print("} ");
+}
+
+static void renderOne(Print &out, const metric *m)
+{
+    if (m->type != METRIC_HISTOGRAM)
+    {
+        printSeries(out, m, NULL);
+        out.printf("%lu\n", m->fn ? m->fn() : m->value);
+        return;
+    }
+    // Copy under the lock so that bucket counts, sum and count are consistent with each other,
+    // a scraper rejects a +Inf bucket that is less than the buckets below it.
+    METRICS_LOCK();
+    metricHistogram h = *m->hist;
+    METRICS_UNLOCK();
+    uint32_t cumulative = 0;
+    for (uint8_t i = 0; i < m->nBuckets; i++)
+    {
+        cumulative += h.buckets[i];
+        printSeries(out, m, "_bucket", &h.bounds[i]);
+        out.printf("%lu\n", cumulative);
+    }
+    printSeries(out, m, "_bucket", NULL, true);
+    out.printf("%lu\n", h.count);
+    printSeries(out, m, "_sum");
+    printSeconds(out, h.sum);
+    out.print('\n');
+    printSeries(out, m, "_count");
+    out.printf("%lu\n", h.count);
+}
+
+void metrics_render(Print &out)
+{
+    static const char *typeNames[] = {"counter", "gauge", "histogram"};
+    uint32_t count = metricCount;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        // Members of a family are output together, under the first one registered
+        bool seen = false;
+        for (uint32_t j = 0; j < i && !seen; j++)
+            seen = !strcmp(metrics[j].name, metrics[i].name);
+        if (seen)
+            continue;
+
+        out.printf("# HELP %s %s\n# TYPE %s %s\n", metrics[i].name, metrics[i].help, metrics[i].name, typeNames[metrics[i].type]);
+        renderOne(out, &metrics[i]);
+        for (uint32_t k = i + 1; k < count; k++)
+        {
+            if (!strcmp(metrics[k].name, metrics[i].name))
+                renderOne(out, &metrics[k]);
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+// C/C++ language includes
+#include <stdint.h>
+
+// Arduino includes
+#include <Print.h>
+
+/****************************************************************************
+ * Fixed memory metrics registry, rendered in Prometheus text exposition format.
+ * Any module can register counters, gauges and histograms at any time, there is
+ * no allocation and registration fails (returns NULL) when the registry is full.
+ * All update functions accept NULL so callers need not check.  Metrics with the
+ * same name and different labels are one family, name and label strings must
+ * remain valid for the life of the program (literals or static storage).
+ * Histogram values are in microseconds and are exported in seconds.
+ */
+#ifdef ESP8266
+#define METRICS_MAX 32
+#define METRICS_MAX_HISTOGRAMS 8
+#else
+#define METRICS_MAX 48
+#define METRICS_MAX_HISTOGRAMS 24
+#endif
+#define METRICS_MAX_BUCKETS 8
+
+enum MetricType : uint8_t
+{
+    METRIC_COUNTER = 0,
+    METRIC_GAUGE = 1,
+    METRIC_HISTOGRAM = 2,
+};
+
+typedef struct metricHistogram
+{
+    const uint32_t *bounds;                // upper bound of each bucket in microseconds, ascending
+    uint32_t buckets[METRICS_MAX_BUCKETS]; // observations per bucket (not cumulative)
+    uint32_t count;                        // total observations, including those over last bound
+    uint64_t sum;                          // total of all observations in microseconds
+} metricHistogram;
+
+typedef struct metric
+{
+    const char *name;   // family name, e.g. "ratgdo_gdo_rx_frames_total"
+    const char *help;   // one line description, same for all in family
+    const char *labels; // optional, e.g. "route=\"/status.json\"", NULL if none
+    MetricType type;
+    uint8_t nBuckets;
+    uint32_t (*fn)(); // if set, called for counter/gauge value at render time
+    union
+    {
+        uint32_t value;
+        metricHistogram *hist;
+    };
+} metric;
+
+extern metric *metric_counter(const char *name, const char *help, const char *labels = NULL, uint32_t (*fn)() = NULL);
+extern metric *metric_gauge(const char *name, const char *help, const char *labels = NULL, uint32_t (*fn)() = NULL);
+extern metric *metric_histogram(const char *name, const char *help, const uint32_t *bounds, uint8_t nBuckets, const char *labels = NULL);
+extern void metric_observe(metric *m, uint32_t us);
+extern void metrics_render(Print &out);
+
+inline void metric_inc(metric *m, uint32_t n = 1)
+{
+    if (m)
+        m->value += n;
+}
+
+inline void metric_set(metric *m, uint32_t v)
+{
+    if (m)
+        m->value = v;
+}
+
+// Commonly used bucket bounds, in microseconds.
+extern const uint32_t metricBucketsLoop[METRICS_MAX_BUCKETS];
+extern const uint32_t metricBucketsHttp[METRICS_MAX_BUCKETS];
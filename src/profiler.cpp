@@ -0,0 +1,196 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+
+// C/C++ language includes
+#include <algorithm>
+#include <string.h>
+
+// RATGDO project includes
+#include "ratgdo.h"
+#include "profiler.h"
+
+// Logger tag
+// static const char *TAG = "ratgdo-profiler";
+
+typedef struct stageStats
+{
+    uint32_t count;                   // times stage was run
+    uint32_t minUs;                   // shortest time
+    uint32_t maxUs;                   // longest time
+    uint64_t totalUs;                 // total time, for average
+    uint32_t hist[LOOP_HIST_BUCKETS]; // log2 histogram of times, for percentiles
+} stageStats;
+
+typedef struct slowIteration
+{
+    uint32_t atMs;    // millis() at end of iteration
+    uint32_t totalUs; // iteration time
+    uint32_t stageUs; // time of longest stage
+    LoopStage stage;  // longest stage
+} slowIteration;
+
+static const char *const stageNames[LOOP_STAGES] = {
+    "setup", "comms", "drycontact", "wifi", "homekit", "vehicle", "web", "improv", "softap", "service"};
+
+// One entry per stage plus one for the whole iteration
+static stageStats stats[LOOP_STAGES + 1];
+static slowIteration slowTrace[LOOP_SLOW_TRACE];
+static uint32_t slowCount = 0;    // slow iterations since reset, slowTrace is indexed modulo this
+static uint32_t profileSince = 0; // millis() when statistics last reset
+
+// Cycle counts for current iteration
+static uint32_t iterationStart = 0;
+static uint32_t stageStart = 0;
+static uint32_t stageUs[LOOP_STAGES];
+static uint32_t cyclesPerUs = 1;
+
+static inline void accumulate(stageStats *s, uint32_t us)
+{
+    if (s->count == 0 || us < s->minUs)
+        s->minUs = us;
+    if (us > s->maxUs)
+        s->maxUs = us;
+    s->count++;
+    s->totalUs += us;
+    uint32_t bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+    s->hist[(bucket < LOOP_HIST_BUCKETS) ? bucket : LOOP_HIST_BUCKETS - 1]++;
+}
+
+void loop_profile_begin()
+{
+    if (profileSince == 0)
+        resetLoopProfile();
+    iterationStart = stageStart = ESP.getCycleCount();
+    memset(stageUs, 0, sizeof(stageUs));
+}
+
+// Call at end of each stage, time since previous stage (or start of iteration) is charged to it.
+void loop_profile_stage(LoopStage stage)
+{
+    uint32_t now = ESP.getCycleCount();
+    uint32_t us = (now - stageStart) / cyclesPerUs;
+    stageStart = now;
+    stageUs[stage] = us;
+    accumulate(&stats[stage], us);
+}
+
+// Returns iteration time in microseconds.
+uint32_t loop_profile_end()
+{
+    uint32_t totalUs = (ESP.getCycleCount() - iterationStart) / cyclesPerUs;
+    accumulate(&stats[LOOP_STAGES], totalUs);
+    if (totalUs > LOOP_SLOW_BUDGET_US)
+    {
+        slowIteration *slow = &slowTrace[slowCount++ % LOOP_SLOW_TRACE];
+        slow->atMs = millis();
+        slow->totalUs = totalUs;
+        slow->stage = STAGE_SETUP;
+        slow->stageUs = 0;
+        for (uint8_t i = 0; i < LOOP_STAGES; i++)
+        {
+            if (stageUs[i] > slow->stageUs)
+            {
+                slow->stage = (LoopStage)i;
+                slow->stageUs = stageUs[i];
+            }
+        }
+    }
+    return totalUs;
+}
+
+void resetLoopProfile()
+{
+    memset(stats, 0, sizeof(stats));
+    memset(slowTrace, 0, sizeof(slowTrace));
+    slowCount = 0;
+    cyclesPerUs = ESP.getCpuFreqMHz();
+    if (cyclesPerUs == 0)
+        cyclesPerUs = 1;
+    profileSince = millis();
+    if (profileSince == 0)
+        profileSince = 1;
+}
+
+// Estimated from histogram, so is the upper bound of the bucket (no more than max).
+static uint32_t percentile99(const stageStats *s)
+{
+    uint32_t target = s->count - s->count / 100;
+    uint32_t cumulative = 0;
+    for (uint32_t i = 0; i < LOOP_HIST_BUCKETS - 1; i++)
+    {
+        cumulative += s->hist[i];
+        if (cumulative >= target)
+            return std::min((uint32_t)((1UL << i) - 1), s->maxUs);
+    }
+    return s->maxUs;
+}
+
+static uint32_t loopsPerSecond(uint32_t iterations)
+{
+    uint32_t elapsed = millis() - profileSince;
+    return (elapsed) ? (uint32_t)((uint64_t)iterations * 1000 / elapsed) : 0;
+}
+
+void printLoopProfile(Print &outputDev)
+{
+    // Copy, the loop keeps running while we print (on ESP32 when called from web server)
+    stageStats copy[LOOP_STAGES + 1];
+    memcpy(copy, stats, sizeof(copy));
+    uint32_t elapsed = millis() - profileSince;
+
+    outputDev.printf("Main loop profile over %lu ms, %lu iterations, %lu loops/sec, %lu slower than %dus\n",
+                     elapsed, copy[LOOP_STAGES].count, loopsPerSecond(copy[LOOP_STAGES].count), slowCount, LOOP_SLOW_BUDGET_US);
+    outputDev.print("Stage            Count   Min us   Avg us   Max us   p99 us\n");
+    for (uint8_t i = 0; i <= LOOP_STAGES; i++)
+    {
+        const stageStats *s = &copy[i];
+        if (s->count == 0)
+            continue;
+        outputDev.printf("%-12s %9lu %8lu %8lu %8lu %8lu\n", (i < LOOP_STAGES) ? stageNames[i] : "total",
+                         s->count, s->minUs, (uint32_t)(s->totalUs / s->count), s->maxUs, percentile99(s));
+    }
+    uint32_t n = std::min(slowCount, (uint32_t)LOOP_SLOW_TRACE);
+    if (n)
+        outputDev.print("Slow iterations (most recent first):\n");
+    for (uint32_t i = 1; i <= n; i++)
+    {
+        const slowIteration *slow = &slowTrace[(slowCount - i) % LOOP_SLOW_TRACE];
+        outputDev.printf("  at %lu ms, %lu us, longest stage %s %lu us\n", slow->atMs, slow->totalUs, stageNames[slow->stage], slow->stageUs);
+    }
+}
+
+void printLoopProfileJSON(Print &outputDev)
+{
+    stageStats copy[LOOP_STAGES + 1];
+    memcpy(copy, stats, sizeof(copy));
+
+    outputDev.printf("{\"sinceMs\":%lu,\"iterations\":%lu,\"loopsPerSec\":%lu,\"slowBudgetUs\":%d,\"slowCount\":%lu,\"stages\":{",
+                     (uint32_t)(millis() - profileSince), copy[LOOP_STAGES].count, loopsPerSecond(copy[LOOP_STAGES].count), LOOP_SLOW_BUDGET_US, slowCount);
+    bool first = true;
+    for (uint8_t i = 0; i <= LOOP_STAGES; i++)
+    {
+        const stageStats *s = &copy[i];
+        if (s->count == 0)
+            continue;
+        outputDev.printf("%s\"%s\":{\"count\":%lu,\"minUs\":%lu,\"avgUs\":%lu,\"maxUs\":%lu,\"p99Us\":%lu}", first ? "" : ",",
+                         (i < LOOP_STAGES) ? stageNames[i] : "total", s->count, s->minUs, (uint32_t)(s->totalUs / s->count), s->maxUs, percentile99(s));
+        first = false;
+    }
+    outputDev.print("},\"slow\":[");
+    uint32_t n = std::min(slowCount, (uint32_t)LOOP_SLOW_TRACE);
+    for (uint32_t i = 1; i <= n; i++)
+    {
+        const slowIteration *slow = &slowTrace[(slowCount - i) % LOOP_SLOW_TRACE];
+        outputDev.printf("%s{\"atMs\":%lu,\"totalUs\":%lu,\"stage\":\"%s\",\"stageUs\":%lu}", (i == 1) ? "" : ",",
+                         slow->atMs, slow->totalUs, stageNames[slow->stage], slow->stageUs);
+    }
+    outputDev.print("]}\n");
+}
@@ -0,0 +1,49 @@
+/****************************************************************************
+ * RATGDO HomeKit
+ * https://ratcloud.llc
+ * https://github.com/PaulWieland/ratgdo
+ *
+ * Copyright (c) 2023-25 David A Kerr... https://github.com/dkerr64/
+ * All Rights Reserved.
+ * Licensed under terms of the GPL-3.0 License.
+ *
+ */
+#pragma once
+
+// C/C++ language includes
+#include <stdint.h>
+
+// Arduino includes
+#include <Print.h>
+
+/****************************************************************************
+ * Main loop profiler.  Each stage of loop() is timed with the CPU cycle counter
+ * and accumulated into min/max/total and a log2 histogram of microseconds, from
+ * which p99 is estimated.  Iterations that take longer than LOOP_SLOW_BUDGET_US
+ * are recorded in a small ring, with the stage that took the longest.
+ */
+#define LOOP_SLOW_BUDGET_US 10000 // iteration longer than this is traced as slow
+#define LOOP_SLOW_TRACE 8         // number of slow iterations kept
+#define LOOP_HIST_BUCKETS 16      // bucket n counts times of 2^(n-1) to 2^n-1 us, last is open ended
+
+enum LoopStage : uint8_t
+{
+    STAGE_SETUP = 0, // initialization after IP address acquired
+    STAGE_COMMS,
+    STAGE_DRYCONTACT,
+    STAGE_WIFI,
+    STAGE_HOMEKIT,
+    STAGE_VEHICLE,
+    STAGE_WEB,
+    STAGE_IMPROV,
+    STAGE_SOFTAP,
+    STAGE_SERVICE,
+    LOOP_STAGES
+};
+
+extern void loop_profile_begin();
+extern void loop_profile_stage(LoopStage stage);
+extern uint32_t loop_profile_end();
+extern void resetLoopProfile();
+extern void printLoopProfile(Print &outputDev);
+extern void printLoopProfileJSON(Print &outputDev);
@@ -25,6 +25,7 @@
 #include <esp_core_dump.h>
 #include <esp_log.h>
 #include <ping/ping_sock.h>
+#include <esp_heap_caps.h>
 #endif
 
 // RATGDO project includes
@@ -36,6 +37,8 @@
 #include "led.h"
 #include "provision.h"
 #include "softAP.h"
+#include "metrics.h"
+#include "profiler.h"
 #ifdef ESP8266
 #include "wifi_8266.h"
 #endif
@@ -49,6 +52,10 @@
 // Logger tag
 static const char *TAG = "ratgdo-main";
 
+// Main loop iteration time, for /metrics
+static metric *loopTime = NULL;
+static void setup_metrics();
+
 // Initialize GDO status
 GarageDoor garage_door = {
     .pinModeObstructionSensor = false,
@@ -77,6 +84,8 @@ GarageDoor garage_door = {
     .builtInTTCremaining = 0,
     .builtInTTChold = false,
 };
+volatile uint32_t garage_door_changed = 0;
+volatile uint32_t garage_door_generation = 0;
 
 // Some initialization is postponed until after we have an IP address
 bool wifi_got_ip = false;
@@ -247,6 +256,7 @@ void setup()
     }
 
     // We only reach here if not in softAPmode
+    setup_metrics();
     if (userConfig->getWifiChanged())
     {
         wifiConnectTimeout = _millis() + WIFI_CONNECT_TIMEOUT;
@@ -296,6 +306,7 @@ void setup()
 void loop()
 {
     static bool setup_after_IP_done = false;
+    loop_profile_begin();
 
     // Some initialization is postponed until after we have an IP address
     if (!setup_after_IP_done && wifi_got_ip && !softAPmode)
@@ -349,23 +360,70 @@ void loop()
         }
 #endif
     }
+    loop_profile_stage(STAGE_SETUP);
 
     comms_loop();
+    loop_profile_stage(STAGE_COMMS);
 #ifndef USE_GDOLIB
     drycontact_loop();
+    loop_profile_stage(STAGE_DRYCONTACT);
 #endif
 #ifdef ESP8266
     // On ESP8266 we handle WiFi and HomeKit ourselves
     wifi_loop();
+    loop_profile_stage(STAGE_WIFI);
     homekit_loop();
+    loop_profile_stage(STAGE_HOMEKIT);
 #endif
 #ifdef RATGDO32_DISCO
     vehicle_loop();
+    loop_profile_stage(STAGE_VEHICLE);
 #endif
     web_loop();
+    loop_profile_stage(STAGE_WEB);
     improv_loop();
+    loop_profile_stage(STAGE_IMPROV);
     soft_ap_loop();
+    loop_profile_stage(STAGE_SOFTAP);
     service_timer_loop();
+    loop_profile_stage(STAGE_SERVICE);
+    metric_observe(loopTime, loop_profile_end());
+}
+
+/****************************************************************************
+ * System wide metrics, other modules register their own.
+ */
+static void setup_metrics()
+{
+    loopTime = metric_histogram("ratgdo_loop_duration_seconds", "Main loop iteration time", metricBucketsLoop, METRICS_MAX_BUCKETS);
+    metric_gauge("ratgdo_uptime_seconds", "Time since boot", NULL, []() -> uint32_t
+                 { return (uint32_t)(_millis() / 1000); });
+    metric_gauge("ratgdo_heap_free_bytes", "Current free heap", NULL, []() -> uint32_t
+                 { return ESP.getFreeHeap(); });
+    metric_gauge("ratgdo_heap_min_free_bytes", "Lowest free heap since boot", NULL, []() -> uint32_t
+                 { return min_heap; });
+    metric_gauge("ratgdo_heap_largest_free_block_bytes", "Largest block that can be allocated", NULL, []() -> uint32_t
+                 {
+#ifdef ESP8266
+                     return ESP.getMaxFreeBlockSize();
+#else
+                     return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#endif
+                 });
+    metric_counter("ratgdo_log_dropped_total", "Log lines dropped by rate limiting", NULL, []() -> uint32_t
+                   { return ratgdoLogger->getDropped(); });
+#ifndef ESP8266
+    metric_counter("ratgdo_nvs_writes_total", "Values written to NVS, before coalescing", NULL, []() -> uint32_t
+                   { return nvRam->writes; });
+    metric_counter("ratgdo_nvs_commits_total", "NVS commits", NULL, []() -> uint32_t
+                   { return nvRam->commits; });
+    metric_counter("ratgdo_nvs_stored_total", "Values written to NVS flash after coalescing", NULL, []() -> uint32_t
+                   { return nvRam->stored; });
+    metric_gauge("ratgdo_nvs_commit_stall_max_microseconds", "Longest NVS flush and commit", NULL, []() -> uint32_t
+                 { return nvRam->maxStallUs; });
+#endif
+    metric_gauge("ratgdo_crash_count", "Crash logs saved since last cleared", NULL, []() -> uint32_t
+                 { return abs(crashCount); });
 }
 
 /****************************************************************************
@@ -384,6 +442,11 @@ void service_timer_loop()
         led.flash(250);
     }
 
+#ifndef ESP8266
+    // Write-behind NVRAM timer
+    nvRam->loop();
+#endif
+
     if (suspend_service_loop)
         return;
 
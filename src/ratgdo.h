@@ -239,13 +239,78 @@ struct __attribute__((aligned(4))) GarageDoor
 #endif
 };
 extern GarageDoor garage_door;
-extern GarageDoor last_reported_garage_door;
+
+// Bits set in garage_door_changed when a value reported to browsers on the status
+// stream changes, so web_loop only has to serialize what is new.
+enum GarageDoorChanged : uint32_t
+{
+    GDO_CHANGED_DOOR_STATE = (1 << 0),
+    GDO_CHANGED_LOCK_STATE = (1 << 1),
+    GDO_CHANGED_LIGHT = (1 << 2),
+    GDO_CHANGED_MOTION = (1 << 3),
+    GDO_CHANGED_PIN_OBST = (1 << 4),
+    GDO_CHANGED_OBSTRUCTED = (1 << 5),
+    GDO_CHANGED_SEC1_EMULATED = (1 << 6),
+    GDO_CHANGED_BATTERY = (1 << 7),
+    GDO_CHANGED_OPENINGS = (1 << 8),
+    GDO_CHANGED_BUILTIN_TTC = (1 << 9),
+    GDO_CHANGED_TTC_REMAINING = (1 << 10),
+    GDO_CHANGED_TTC_HOLD = (1 << 11),
+    GDO_CHANGED_OPEN_DURATION = (1 << 12),
+    GDO_CHANGED_CLOSE_DURATION = (1 << 13),
+    GDO_CHANGED_TTC_ACTIVE = (1 << 14),
+    GDO_CHANGED_PAIRED = (1 << 15),
+    GDO_CHANGED_LASER = (1 << 16),
+    GDO_CHANGED_VEHICLE = (1 << 17),
+    GDO_CHANGED_DHT22 = (1 << 18),
+};
+extern volatile uint32_t garage_door_changed;
+// Incremented on every change, used as an ETag by pollers of the compact status endpoint.
+extern volatile uint32_t garage_door_generation;
+
+// Flag values as changed, may be called from timer callbacks and the HomeKit task.
+inline void gdo_changed(uint32_t bits)
+{
+#ifdef ESP8266
+    garage_door_changed |= bits;
+    garage_door_generation++;
+#else
+    __atomic_fetch_or(&garage_door_changed, bits, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&garage_door_generation, 1, __ATOMIC_RELAXED);
+#endif
+}
+
+// Return all values flagged as changed and clear the flags.
+inline uint32_t gdo_take_changed()
+{
+#ifdef ESP8266
+    uint32_t bits = garage_door_changed;
+    garage_door_changed = 0;
+    return bits;
+#else
+    return __atomic_exchange_n(&garage_door_changed, 0, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Assign a garage_door field, flagging it as changed only if the value is different.
+#define GDO_SET(field, value, bits)                             \
+    do                                                          \
+    {                                                           \
+        decltype(garage_door.field) _gdo_v = (value);           \
+        if (garage_door.field != _gdo_v)                        \
+        {                                                       \
+            garage_door.field = _gdo_v;                         \
+            gdo_changed(bits);                                  \
+        }                                                       \
+    } while (0)
 
 // JSON response caching
 #ifdef ESP8266
 #define STATUS_JSON_BUFFER_SIZE (256 * 8)
+#define STATUS_STATIC_BUFFER_SIZE (256 * 4) // config values part of status, cached until config changes
 #else
 #define STATUS_JSON_BUFFER_SIZE (256 * 10)
+#define STATUS_STATIC_BUFFER_SIZE (256 * 5) // config values part of status, cached until config changes
 #endif
 #define LOOP_JSON_BUFFER_SIZE 512
 extern char *status_json;
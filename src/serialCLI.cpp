@@ -22,6 +22,7 @@
 #include "web.h"
 #include "comms.h"
 #include "provision.h"
+#include "profiler.h"
 
 // Logger tag
 static const char *TAG = "ratgdo-serialCLI";
@@ -41,7 +42,7 @@ void serialCLI(char cmd)
         _millis_t upTime = _millis();
         Serial.printf_P(PSTR("\n----------> RATGDO <----------\n"));
         Serial.printf_P(PSTR("Hostname:              http://%s.local\n"), device_name_rfc952);
-        Serial.printf_P(PSTR("IP Address:            %s\n"), userConfig->getLocalIP());
+        Serial.printf_P(PSTR("IP Address:            %s\n"), userConfig->getLocalIP().c_str());
         Serial.printf_P(PSTR("Server uptime:         %llums (%s)\n"), (int64_t)upTime, toHHMMSSmmm(upTime));
         if (enableNTP && clockSet)
         {
@@ -84,6 +85,14 @@ void serialCLI(char cmd)
         Serial.println();
         Serial.printf_P(PSTR(" l - print RATGDO buffered message log\n"));
         Serial.printf_P(PSTR(" L - print RATGDO saved reboot log\n"));
+        Serial.printf_P(PSTR(" m - print message log statistics (M to reset)\n"));
+        Serial.printf_P(PSTR(" o - print main loop profile (O to reset)\n"));
+        Serial.printf_P(PSTR(" b - print cost of reading a user setting\n"));
+#ifndef ESP8266
+        Serial.printf_P(PSTR(" n - print NVRAM write statistics\n"));
+#endif
+        Serial.printf_P(PSTR(" e - print server sent event statistics\n"));
+        Serial.printf_P(PSTR(" w - print web server rate limit statistics\n"));
         Serial.printf_P(PSTR(" P - print RATGDO crash log\n"));
         Serial.printf_P(PSTR(" S - print RATGDO status JSON\n"));
         Serial.printf_P(PSTR(" s - %s log to serial port\n"), suppressSerialLog ? "enable" : "disable");
@@ -115,6 +124,18 @@ void serialCLI(char cmd)
     }
 #endif
 
+    case 'e':
+    {
+        printSSEStats(Serial);
+        break;
+    }
+
+    case 'w':
+    {
+        printRateStats(Serial);
+        break;
+    }
+
     case 'F':
     {
         if (areYouSure(PSTR("Factory reset reqested? Are you sure Y/N: ")))
@@ -140,7 +161,7 @@ void serialCLI(char cmd)
     case 'j':
     {
         userConfig->set(cfg_builtInTTC, 0);
-        garage_door.builtInTTC = 0;
+        GDO_SET(builtInTTC, 0, GDO_CHANGED_BUILTIN_TTC);
         send_cancel_ttc();
         break;
     }
@@ -151,7 +172,7 @@ void serialCLI(char cmd)
         if (areYouSure(PSTR("Set built-in automatic close to 10 seconds? Are you sure Y/N: ")))
         {
             userConfig->set(cfg_builtInTTC, secs);
-            garage_door.builtInTTC = secs;
+            GDO_SET(builtInTTC, secs, GDO_CHANGED_BUILTIN_TTC);
             send_set_ttc(secs);
         }
         break;
@@ -185,6 +206,49 @@ void serialCLI(char cmd)
         break;
     }
 
+    case 'm':
+    {
+        // Print cost of logging
+        bool saved = suppressSerialLog;
+        suppressSerialLog = true;
+        ratgdoLogger->printStats(Serial);
+        suppressSerialLog = saved;
+        break;
+    }
+
+    case 'o':
+    {
+        printLoopProfile(Serial);
+        break;
+    }
+
+    case 'O':
+    {
+        resetLoopProfile();
+        break;
+    }
+
+    case 'b':
+    {
+        userConfig->printGetterCost(Serial);
+        break;
+    }
+
+#ifndef ESP8266
+    case 'n':
+    {
+        nvRam->printStats(Serial);
+        break;
+    }
+#endif
+
+    case 'M':
+    {
+        ratgdoLogger->resetStats();
+        Serial.printf_P(PSTR("Message log statistics reset\n"));
+        break;
+    }
+
     case 'P':
     {
         // Print last crash log
@@ -226,9 +290,11 @@ void serialCLI(char cmd)
     case 'S':
     {
         static char *json = status_json;
-        build_status_json(json);
+        uint32_t buildUs = micros();
+        size_t len = build_status_json(json, STATUS_JSON_BUFFER_SIZE);
+        buildUs = micros() - buildUs;
         Serial.println(json);
-        Serial.printf_P(PSTR("JSON length: %d, max: %d, used: %d%%\n"), strlen(json), STATUS_JSON_BUFFER_SIZE, strlen(json) * 100 / STATUS_JSON_BUFFER_SIZE);
+        Serial.printf_P(PSTR("JSON length: %d, max: %d, used: %d%%, build time: %luus\n"), len, STATUS_JSON_BUFFER_SIZE, len * 100 / STATUS_JSON_BUFFER_SIZE, buildUs);
         break;
     }
 
@@ -249,7 +315,7 @@ void serialCLI(char cmd)
             // This will send a light press / release / release without checking whether necessary or not.
             set_light(false,false);
             // This will force us to send current state to browser, so it reports correct state.
-            last_reported_garage_door.current_state = (GarageDoorCurrentState)0xFF; });
+            gdo_changed(GDO_CHANGED_DOOR_STATE); });
         break;
     }
 
@@ -68,7 +68,7 @@ bool get_auto_timezone()
             String tz = http.getString();
             tz.trim();
             userConfig->set(cfg_timeZone, tz.c_str());
-            ESP_LOGI(TAG, "Automatic timezone set to: %s", userConfig->getTimeZone());
+            ESP_LOGI(TAG, "Automatic timezone set to: %s", userConfig->getTimeZone().c_str());
             success = true;
         }
         http.end();
@@ -207,7 +207,9 @@ char *make_rfc952(char *dest, const char *src, int size)
 void load_all_config_settings()
 {
     ESP_LOGI(TAG, "=== Load all config settings for %s", device_name);
+    uint32_t loadStart = micros();
     userConfig->load();
+    ESP_LOGI(TAG, "   loaded in:           %luus", micros() - loadStart);
     // Set globals...
     strlcpy(device_name, userConfig->getDeviceName(), sizeof(device_name));
     make_rfc952(device_name_rfc952, device_name, sizeof(device_name_rfc952));
@@ -219,21 +221,21 @@ void load_all_config_settings()
     syslogEn = userConfig->getSyslogEn();
     syslogFacility = userConfig->getSyslogFacility();
     rebootSeconds = userConfig->getRebootSeconds();
-    garage_door.builtInTTC = userConfig->getBuiltInTTC();
+    GDO_SET(builtInTTC, userConfig->getBuiltInTTC(), GDO_CHANGED_BUILTIN_TTC);
 
     // Now log what we have loaded
-    ESP_LOGI(TAG, "   deviceName:          %s", userConfig->getDeviceName());
+    ESP_LOGI(TAG, "   deviceName:          %s", userConfig->getDeviceName().c_str());
     ESP_LOGI(TAG, "   wifiChanged:         %s", userConfig->getWifiChanged() ? "true" : "false");
     ESP_LOGI(TAG, "   wifiPower:           %d", userConfig->getWifiPower());
     ESP_LOGI(TAG, "   wifiPhyMode:         %d", userConfig->getWifiPhyMode());
     ESP_LOGI(TAG, "   staticIP:            %s", userConfig->getStaticIP() ? "true" : "false");
-    ESP_LOGI(TAG, "   localIP:             %s", userConfig->getLocalIP());
-    ESP_LOGI(TAG, "   subnetMask:          %s", userConfig->getSubnetMask());
-    ESP_LOGI(TAG, "   gatewayIP:           %s", userConfig->getGatewayIP());
-    ESP_LOGI(TAG, "   nameserverIP:        %s", userConfig->getNameserverIP());
+    ESP_LOGI(TAG, "   localIP:             %s", userConfig->getLocalIP().c_str());
+    ESP_LOGI(TAG, "   subnetMask:          %s", userConfig->getSubnetMask().c_str());
+    ESP_LOGI(TAG, "   gatewayIP:           %s", userConfig->getGatewayIP().c_str());
+    ESP_LOGI(TAG, "   nameserverIP:        %s", userConfig->getNameserverIP().c_str());
     ESP_LOGI(TAG, "   wwwPWrequired:       %s", userConfig->getPasswordRequired() ? "true" : "false");
-    ESP_LOGI(TAG, "   wwwUsername:         %s", userConfig->getwwwUsername());
-    ESP_LOGI(TAG, "   wwwCredentials:      %s", userConfig->getwwwCredentials());
+    ESP_LOGI(TAG, "   wwwUsername:         %s", userConfig->getwwwUsername().c_str());
+    ESP_LOGI(TAG, "   wwwCredentials:      %s", userConfig->getwwwCredentials().c_str());
     ESP_LOGI(TAG, "   GDOSecurityType:     %d", userConfig->getGDOSecurityType());
     ESP_LOGI(TAG, "   TTCseconds:          %d", userConfig->getTTCseconds());
     ESP_LOGI(TAG, "   rebootSeconds:       %d", userConfig->getRebootSeconds());
@@ -244,10 +246,10 @@ void load_all_config_settings()
     ESP_LOGI(TAG, "   doorUpdateAt:        %d (%s)", userConfig->getDoorUpdateAt(), timeString(userConfig->getDoorUpdateAt()));
     ESP_LOGI(TAG, "   doorOpenAt:          %d (%s)", userConfig->getDoorOpenAt(), timeString(userConfig->getDoorOpenAt()));
     ESP_LOGI(TAG, "   doorCloseAt:         %d (%s)", userConfig->getDoorCloseAt(), timeString(userConfig->getDoorCloseAt()));
-    ESP_LOGI(TAG, "   timeZone:            %s", userConfig->getTimeZone());
+    ESP_LOGI(TAG, "   timeZone:            %s", userConfig->getTimeZone().c_str());
     ESP_LOGI(TAG, "   softAPmode:          %s", userConfig->getSoftAPmode() ? "true" : "false");
     ESP_LOGI(TAG, "   syslogEn:            %s", userConfig->getSyslogEn() ? "true" : "false");
-    ESP_LOGI(TAG, "   syslogIP:            %s", userConfig->getSyslogIP());
+    ESP_LOGI(TAG, "   syslogIP:            %s", userConfig->getSyslogIP().c_str());
     ESP_LOGI(TAG, "   syslogPort:          %d", userConfig->getSyslogPort());
     ESP_LOGI(TAG, "   syslogFacility:      %d", userConfig->getSyslogFacility());
 #ifdef RATGDO32_DISCO
@@ -278,8 +280,8 @@ void load_all_config_settings()
         sntp_set_time_sync_notification_cb(time_is_set);
         sntp_set_sync_interval(SNTP_SYNC_INTERVAL);
 #endif
-        ESP_LOGI(TAG, "Timezone: %s", userConfig->getTimeZone());
-        std::string tz = userConfig->getTimeZone();
+        std::string tz = userConfig->getTimeZone().c_str();
+        ESP_LOGI(TAG, "Timezone: %s", tz.c_str());
         size_t pos = tz.find(';');
         if (pos != std::string::npos)
         {
@@ -317,6 +319,8 @@ void sync_and_restart()
         // In soft AP mode we never initialized garage door comms, so don't save rolling code.
         save_rolling_code();
     }
+    // Flush anything still waiting to be written to NVRAM
+    sync_door_data();
 #ifdef ESP8266
     WiFi.mode(WIFI_OFF);
     WiFi.forceSleepBegin();
@@ -37,7 +37,6 @@ static const int32_t MAX_DISTANCE = 4500; // 4.5 meters, maximum range of the se
 int16_t vehicleDistance = 0;
 int16_t vehicleThresholdDistance = 1000; // set by user
 char vehicleStatus[16] = "Away";         // or Arriving or Departing or Parked
-bool vehicleStatusChange = false;
 
 static bool vehicleDetected = false;
 static bool vehicleArriving = false;
@@ -158,6 +157,9 @@ void setup_vehicle()
 
     garage_door.has_distance_sensor = true;
     nvRam->write(nvram_has_distance, 1);
+    // Report laser on / off to browsers on the status stream
+    laser.setChangedFlag(GDO_CHANGED_LASER);
+    gdo_changed(GDO_CHANGED_VEHICLE | GDO_CHANGED_LASER);
     vehicleThresholdDistance = userConfig->getVehicleThreshold() * 10; // convert centimeters to millimeters
     enable_service_homekit_vehicle(userConfig->getVehicleHomeKit());
     vehicle_setup_done = true;
@@ -248,7 +250,7 @@ void vehicle_loop()
     {
         vehicleArriving = false;
         strlcpy(vehicleStatus, vehicleDetected ? "Parked" : "Away", sizeof(vehicleStatus));
-        vehicleStatusChange = true;
+        gdo_changed(GDO_CHANGED_VEHICLE);
         ESP_LOGI(TAG, "Vehicle %s at %s", vehicleStatus, timeString());
         notify_homekit_vehicle_arriving(false);
     }
@@ -257,7 +259,7 @@ void vehicle_loop()
     {
         vehicleDeparting = false;
         strlcpy(vehicleStatus, vehicleDetected ? "Parked" : "Away", sizeof(vehicleStatus));
-        vehicleStatusChange = true;
+        gdo_changed(GDO_CHANGED_VEHICLE);
         ESP_LOGI(TAG, "Vehicle %s at %s", vehicleStatus, timeString());
         notify_homekit_vehicle_departing(false);
     }
@@ -284,7 +286,7 @@ void setArriveDepart(bool vehiclePresent)
             strlcpy(vehicleStatus, "Arriving", sizeof(vehicleStatus));
             if (userConfig->getAssistDuration() > 0)
                 laser.flash(userConfig->getAssistDuration() * 1000);
-            vehicleStatusChange = true;
+            gdo_changed(GDO_CHANGED_VEHICLE);
             ESP_LOGI(TAG, "Vehicle %s at %s", vehicleStatus, timeString());
             notify_homekit_vehicle_arriving(true);
         }
@@ -297,7 +299,7 @@ void setArriveDepart(bool vehiclePresent)
             vehicleDeparting = true;
             vehicle_motion_timer = lastVehicleChangeAt;
             strlcpy(vehicleStatus, "Departing", sizeof(vehicleStatus));
-            vehicleStatusChange = true;
+            gdo_changed(GDO_CHANGED_VEHICLE);
             ESP_LOGI(TAG, "Vehicle %s at %s", vehicleStatus, timeString());
             notify_homekit_vehicle_departing(true);
         }
@@ -375,7 +377,7 @@ void calculatePresence(int32_t distance)
             strlcpy(vehicleStatus, vehicleDetected ? "Parked" : "Away", sizeof(vehicleStatus));
             ESP_LOGI(TAG, "Vehicle %s at %s", vehicleStatus, timeString());
         }
-        vehicleStatusChange = true;
+        gdo_changed(GDO_CHANGED_VEHICLE);
         notify_homekit_vehicle_occupancy(vehicleDetected);
     }
 }
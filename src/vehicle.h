@@ -22,6 +22,5 @@ extern void doorClosing();
 extern int16_t vehicleDistance;
 extern int16_t vehicleThresholdDistance;
 extern char vehicleStatus[];
-extern bool vehicleStatusChange;
 extern bool vehicle_setup_done;
 extern _millis_t lastVehicleChangeAt;
@@ -15,6 +15,7 @@
  */
 
 // C/C++ language includes
+#include <algorithm>
 #include <string>
 #include <tuple>
 #include <unordered_map>
@@ -31,9 +32,15 @@
 #include <arduino_homekit_server.h>
 #include <eboot_command.h>
 #include <ESP8266mDNS.h>
+#include <Hash.h>
+#include <bearssl/bearssl_hmac.h>
 #else
 #include "esp_core_dump.h"
 #include <ESPmDNS.h>
+#include <lwip/sockets.h>
+#include <mbedtls/sha1.h>
+#include <mbedtls/md.h>
+#include <esp_random.h>
 #endif
 
 // RATGDO project includes
@@ -47,7 +54,10 @@
 #include "homekit.h"
 #include "softAP.h"
 #include "json.h"
+#include "cbor.h"
 #include "led.h"
+#include "metrics.h"
+#include "profiler.h"
 #ifdef ESP8266
 #include "wifi_8266.h"
 #endif
@@ -60,13 +70,13 @@
 // Logger tag
 static const char *TAG = "ratgdo-http";
 
-// Browser cache control, time in seconds after which browser cache invalid
-// This is used for CSS, JS and IMAGE file types.  Set to 30 days !!
-#define CACHE_CONTROL (60 * 60 * 24 * 30)
-
 // Forward declare the internal URI handling functions...
 void handle_reset();
 void handle_status();
+void handle_status_cbor();
+void handle_metrics();
+void handle_profile();
+void handle_timing();
 void handle_everything();
 void handle_setgdo();
 void handle_logout();
@@ -85,6 +95,10 @@ char *test_str = NULL;
 void handle_update();
 void handle_firmware_upload();
 void SSEHandler(uint32_t channel);
+void SSEheartbeat();
+static void SSEdrainAll();
+void handle_websocket();
+static bool WSpoll(struct SSESubscription *s);
 void add_static_mdns();
 void add_dynamic_mdns();
 
@@ -92,6 +106,10 @@ void add_dynamic_mdns();
 const char restEvents[] = "/rest/events/";
 const std::unordered_map<std::string, std::pair<const HTTPMethod, void (*)()>> builtInUri = {
     {"/status.json", {HTTP_GET, handle_status}},
+    {"/status.cbor", {HTTP_GET, handle_status_cbor}},
+    {"/metrics", {HTTP_GET, handle_metrics}},
+    {"/profile.json", {HTTP_GET, handle_profile}},
+    {"/timing.json", {HTTP_GET, handle_timing}},
     {"/reset", {HTTP_POST, handle_reset}},
     {"/reboot", {HTTP_POST, handle_reboot}},
     {"/setgdo", {HTTP_POST, handle_setgdo}},
@@ -109,7 +127,8 @@ const std::unordered_map<std::string, std::pair<const HTTPMethod, void (*)()>> b
     {"/forcecrash", {HTTP_POST, handle_forcecrash}},
     {"/crashoom", {HTTP_POST, handle_crash_oom}},
 #endif
-    {"/rest/events/subscribe", {HTTP_GET, handle_subscribe}}};
+    {"/rest/events/subscribe", {HTTP_GET, handle_subscribe}},
+    {"/rest/ws", {HTTP_GET, handle_websocket}}};
 
 // Declare web server on HTTP port 80.
 #ifdef ESP8266
@@ -119,9 +138,6 @@ WebServer server(80);
 #endif
 
 // Local copy of door status
-GarageDoor last_reported_garage_door;
-bool last_reported_paired = false;
-bool last_reported_assist_laser = false;
 _millis_t lastDoorUpdateAt;
 _millis_t lastDoorOpenAt;
 _millis_t lastDoorCloseAt;
@@ -133,14 +149,19 @@ bool web_setup_done = false;
 // Based on ESP8266HTTPUpdateServer
 std::string _updaterError;
 bool _authenticatedUpdate;
+static uint32_t uploadRetryAfter = 0;
 char firmwareMD5[36] = "";
 size_t firmwareSize = 0;
+#define UUID_FIELD_SIZE 48 // browser client UUID passed in updateUnderway
+
+// Largest username, credentials or password accepted in setgdo credentials
+#define CREDENTIALS_FIELD_SIZE 64
 
 // Common HTTP responses
 constexpr char response400missing[] = "400: Bad Request, missing argument\n";
 constexpr char response400invalid[] = "400: Bad Request, invalid argument\n";
 constexpr char response404[] = "404: Not Found\n";
-constexpr char response503[] = "503: Service Unavailable.\n";
+constexpr char response429[] = "429: Too Many Requests.\n";
 constexpr char response200[] = "HTTP/1.1 200 OK\nContent-Type: text/plain\nConnection: close\n\n";
 
 const char *http_methods[] = {"HTTP_ANY", "HTTP_GET", "HTTP_HEAD", "HTTP_POST", "HTTP_PUT", "HTTP_PATCH", "HTTP_DELETE", "HTTP_OPTIONS"};
@@ -183,34 +204,164 @@ struct SSESubscription
 {
     IPAddress clientIP;
     WiFiClient client;
-    Ticker heartbeatTimer;
     uint32_t heartbeatInterval;
     bool SSEconnected;
     int SSEfailCount;
     String clientUUID;
     bool logViewer;
+    esp_log_level_t logMaxLevel; // only send log lines at or below this level
+    String logTags;              // only send log lines with one of these (comma separated) tags
+    String logMatch;             // only send log lines that contain this string
+    uint8_t *queue;              // outbound frames waiting to be written to client
+    uint16_t queueUsed;          // bytes in queue
+    uint16_t queueSent;          // bytes of first frame in queue already written
+    uint16_t queueMax;           // high water mark of queue
+    uint32_t droppedBytes;       // bytes of log messages dropped because queue was full
+    _millis_t lastProgress;      // when we last wrote to client, or queue became non-empty
+    bool websocket;              // WebSocket client, frames are sent with WebSocket framing instead of SSE
+    bool wsAuthorized;           // WebSocket client may send commands
+    uint8_t *wsRx;               // inbound WebSocket frames, allocated after the queue
+    uint16_t wsRxUsed;           // bytes in wsRx
 };
 SSESubscription subscription[SSE_MAX_CHANNELS];
 // During firmware update note which subscribed client is updating
 SSESubscription *firmwareUpdateSub = NULL;
 uint32_t subscriptionCount = 0;
+// Heartbeats for all subscribers are sent from one timer, so that subscribers
+// due a heartbeat in the same tick share one payload.
+Ticker SSEheartbeatTimer;
+uint32_t SSEheartbeatTicks = 0;
+
+// An SSE event frame, formatted once per broadcast and the same bytes written to every
+// subscriber.  Frames too large for the static buffer are allocated for the broadcast.
+#define SSE_FRAME_SIZE 512
+struct SSEFrame
+{
+    char *data;
+    int len;
+    char buffer[SSE_FRAME_SIZE];
+};
+// Cost of broadcasts, indexed by number of subscribers the frame was written to.
+uint32_t SSEbroadcastCount[SSE_MAX_CHANNELS + 1];
+uint64_t SSEbroadcastUs[SSE_MAX_CHANNELS + 1];
+
+// Each subscriber has a bounded queue of outbound frames, drained with non-blocking writes
+// so that one slow client cannot stall the loop.  When the queue is full we drop the oldest
+// log messages.  Status messages are never dropped, if they do not fit the client is evicted,
+// as it is if it makes no progress for SSE_STALL_TIMEOUT_MS.
+#ifdef ESP8266
+#define SSE_QUEUE_SIZE 1024
+#else
+#define SSE_QUEUE_SIZE 2048
+#endif
+#define SSE_RECORD_HDR 3 // each frame in queue is preceded by type and 16-bit length
+#define SSE_STALL_TIMEOUT_MS 10000
+uint32_t SSEevictions = 0;
+
+// WebSocket clients share the subscription slots and queues with SSE.  Each queued record
+// gets a WebSocket frame header instead of SSE formatting, and commands are read from
+// the client in small frames.
+#define WS_RX_SIZE 128
+#define WS_OP_TEXT 0x1
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+uint32_t WScommandCount = 0;
+
+#ifndef ESP8266
+// On ESP32 the web server runs in its own task, on the same core as HomeSpan, so that
+// requests are not serialized behind the main loop and HTTP work never delays GDO comms.
+#define WEB_TASK_STACK_SIZE (1024 * 10)
+#define WEB_TASK_PRIORITY 1
+#define WEB_TASK_CORE 0
+#define WEB_TASK_IDLE_MS 2
+static TaskHandle_t webTaskHandle = NULL;
+static void webTask(void *arg);
+#endif
+
+// Session tokens.  A client that passes digest authentication at /auth is given a cookie, which
+// is then accepted in place of digest authentication until it expires.  Token is session id and
+// expiry (seconds since boot) followed by HMAC-SHA256 of those, truncated, keyed with a random
+// per-boot key.  So a reboot, or a password change (which generates a new key), ends all sessions.
+// Logout adds the session id to a small revocation table, if that is full the key is replaced.
+#define SESSION_TTL_SECONDS (15 * 60)
+#define SESSION_REVOKED_MAX 8
+#define SESSION_MAC_LEN 16
+#define SESSION_TOKEN_LEN ((8 + SESSION_MAC_LEN) * 2) // hex encoded
+static const char sessionCookie[] = "ratgdo_session=";
+static uint8_t sessionKey[32];
+#ifdef ESP8266
+static br_hmac_key_context sessionKeyContext;
+#endif
+static uint32_t sessionNextId = 1;
+static uint32_t sessionRevoked[SESSION_REVOKED_MAX]; // zero is unused entry
+static uint32_t sessionAuthCount = 0;                 // requests accepted on session token
+static uint32_t digestAuthCount = 0;                  // requests that needed digest authentication
 
-// Performance management - removed redundant connection tracking
-#define MIN_REQUEST_INTERVAL_MS 100
+static void sessionNewKey();
 
 // Performance monitoring
 static uint32_t request_count = 0;
 static uint32_t max_response_time = 0;
 
+// Each request is timed by phase.  recv is accept and header parsing within handleClient() up to
+// our handler being called, auth is digest authentication, handler is building the response and
+// send is from first response byte until handler returns.  Handlers mark the start of sending with
+// timingSendStart(), if they do not then send is counted as part of handler.
+enum RequestPhase : uint8_t
+{
+    PHASE_RECV = 0,
+    PHASE_AUTH,
+    PHASE_HANDLER,
+    PHASE_SEND,
+    REQUEST_PHASES
+};
+static const char *const phaseNames[REQUEST_PHASES] = {"recv", "auth", "handler", "send"};
+static struct
+{
+    uint32_t start;    // micros() when handleClient() called
+    uint32_t dispatch; // micros() when our handler called
+    uint32_t sendAt;   // micros() when response started, 0 if not marked
+    uint32_t authUs;   // time in isAuthenticated()
+} reqTiming;
+static void timingSendStart(bool header);
+
+// Request latency histogram and phase times per built-in route, registered on first request to the
+// route.  Static content and SSE channels are each counted as a single route.
+#define ROUTE_METRICS_MAX 24
+static const char routeStatic[] = "static";
+static const char routeEvents[] = "/rest/events";
+typedef struct routeMetric
+{
+    const char *route; // key of builtInUri entry or one of the above, pointer identifies route
+    metric *latency;   // in /metrics registry
+    uint32_t count;
+    uint64_t sumUs[REQUEST_PHASES];
+    uint32_t maxUs[REQUEST_PHASES];
+} routeMetric;
+static routeMetric routeMetrics[ROUTE_METRICS_MAX];
+static uint32_t routeMetricsCount = 0;
+static void observeRoute(const char *route);
+
 #ifdef ESP8266
 // ESP8266 is single core / single threaded, no mutex's.
 #define TAKE_MUTEX()
 #define GIVE_MUTEX()
+#define SSE_TAKE_MUTEX()
+#define SSE_GIVE_MUTEX()
 #else
 // ESP32 is multi-core, need to serialize access to JSON buffers
 static SemaphoreHandle_t jsonMutex = NULL;
 #define TAKE_MUTEX() xSemaphoreTake(jsonMutex, portMAX_DELAY)
 #define GIVE_MUTEX() xSemaphoreGive(jsonMutex)
+// and to SSE queues, which are written from logger, heartbeat timer and web loop.
+// Never log while holding this, logging can take the mutex to broadcast the message.
+static SemaphoreHandle_t sseMutex = NULL;
+#define SSE_TAKE_MUTEX() xSemaphoreTake(sseMutex, portMAX_DELAY)
+#define SSE_GIVE_MUTEX() xSemaphoreGive(sseMutex)
+// status.json for the web task, whole document so it can be sent without holding jsonMutex
+#define STATUS_SEND_BUFFER_SIZE (STATUS_JSON_BUFFER_SIZE + STATUS_STATIC_BUFFER_SIZE)
+static char *statusSend = NULL;
 #endif
 
 // mDNS update management... re-announcing every 2 minutes.
@@ -220,23 +371,43 @@ static SemaphoreHandle_t jsonMutex = NULL;
 static _millis_t lastMDNSupdate = 0;
 static bool mdnsUpdatePending = false;
 
-// Connection throttling
-#define MAX_CONCURRENT_REQUESTS 8
-#define REQUEST_TIMEOUT_MS 2000
-struct ActiveRequest
+// Admission control.  Each client (by IP) has a token bucket for each class of request, so one
+// client polling too fast is throttled without affecting anyone else.  A request takes one token,
+// tokens are added back at a fixed interval up to the burst size.  Clients are tracked in a small
+// table, when it is full the least recently seen client is replaced.
+enum RateClass : uint8_t
+{
+    RATE_STATIC = 0, // web page content
+    RATE_API = 1,    // status, settings, logs, SSE and WebSocket
+    RATE_UPLOAD = 2, // firmware upload
+    RATE_CLASSES
+};
+struct RateBudget
+{
+    uint16_t burst;
+    uint16_t refillMs; // time to add one token
+};
+// Loading the web page fetches about 20 files in a burst, the page then polls status and
+// subscribes for SSE.  A firmware upload is normally preceded by a verify upload.
+static const RateBudget rateBudget[RATE_CLASSES] = {{40, 50}, {20, 250}, {3, 20000}};
+static const char *rateClassName[RATE_CLASSES] = {"static", "api", "upload"};
+#define RATE_MAX_CLIENTS 8
+struct RateClient
 {
     IPAddress clientIP;
-    _millis_t startTime;
-    bool inUse;
+    _millis_t lastSeen;
+    uint16_t tokens[RATE_CLASSES];
+    _millis_t lastRefill[RATE_CLASSES];
 };
-ActiveRequest activeRequests[MAX_CONCURRENT_REQUESTS];
-int activeRequestCount = 0;
+RateClient rateClients[RATE_MAX_CLIENTS];
+uint32_t rateAdmitted[RATE_CLASSES];
+uint32_t rateThrottled[RATE_CLASSES];
+uint32_t rateEvictions = 0;
 
 #define CLIENT_WRITE_TIMEOUT 500
 static char writeBuffer[512];
-bool clientWrite(WiFiClient client, const char *data)
+bool clientWrite(WiFiClient client, const char *data, size_t len)
 {
-    size_t len = strlen(data);
     size_t written = 0;
 #ifdef ESP8266
     client.flush(); // make sure previous data all sent.
@@ -252,60 +423,202 @@ bool clientWrite(WiFiClient client, const char *data)
     return true;
 }
 
-// Helper functions for connection throttling
-bool registerRequest()
+bool clientWrite(WiFiClient client, const char *data)
 {
-    IPAddress clientIP = server.client().remoteIP();
-    _millis_t now = _millis();
+    return clientWrite(client, data, strlen(data));
+}
 
-    // Clean up timed-out requests
-    for (int i = 0; i < MAX_CONCURRENT_REQUESTS; i++)
-    {
-        if (activeRequests[i].inUse && (now - activeRequests[i].startTime > REQUEST_TIMEOUT_MS))
+// Format an SSE event frame.  Returns false if unable to allocate space for a large frame.
+static bool SSEbuildFrame(SSEFrame &frame, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    frame.data = frame.buffer;
+    frame.len = vsnprintf_P(frame.buffer, sizeof(frame.buffer), fmt, args);
+    va_end(args);
+    if (frame.len >= (int)sizeof(frame.buffer))
+    {
+        frame.data = static_cast<char *>(malloc(frame.len + 1));
+        if (!frame.data)
         {
-            ESP_LOGD(TAG, "Request timeout for client %s", activeRequests[i].clientIP.toString().c_str());
-            activeRequests[i].inUse = false;
-            activeRequestCount--;
+            ESP_LOGE(TAG, "Unable to allocate %d bytes for SSE frame", frame.len + 1);
+            frame.len = 0;
+            return false;
         }
+        va_start(args, fmt);
+        vsnprintf_P(frame.data, frame.len + 1, fmt, args);
+        va_end(args);
     }
+    return true;
+}
 
-    // Check if we're at capacity
-    if (activeRequestCount >= MAX_CONCURRENT_REQUESTS)
-    {
-        ESP_LOGE(TAG, "Max concurrent requests reached, rejecting %s", clientIP.toString().c_str());
+static void SSEfreeFrame(SSEFrame &frame)
+{
+    if (frame.data != frame.buffer)
+        free(frame.data);
+    frame.data = frame.buffer;
+    frame.len = 0;
+}
+
+static inline size_t SSErecordLen(const uint8_t *record)
+{
+    return SSE_RECORD_HDR + (record[1] | (record[2] << 8));
+}
+
+// Write as much as the socket will take without blocking.  Returns bytes written, or -1 if connection failed.
+static int SSEwriteNonBlocking(WiFiClient &client, const uint8_t *data, size_t len)
+{
+#ifdef ESP8266
+    size_t room = client.availableForWrite();
+    if (room == 0)
+        return (client.connected()) ? 0 : -1;
+    return client.write(data, std::min(len, room));
+#else
+    int n = send(client.fd(), data, len, MSG_DONTWAIT);
+    if (n < 0)
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+    return n;
+#endif
+}
+
+// Add frame to subscriber's queue, dropping oldest log messages if necessary to make room.
+// Returns false if client must be evicted because a status message will not fit.
+// Call with SSE mutex held.
+static bool SSEenqueue(SSESubscription *s, const SSEFrame &frame, BroadcastType type, uint8_t opcode = WS_OP_TEXT)
+{
+    // WebSocket frames from server are not masked, length is 7 bits or 126 followed by 16 bits.
+    size_t wsHdr = (!s->websocket) ? 0 : (frame.len < 126) ? 2 : 4;
+    size_t need = SSE_RECORD_HDR + wsHdr + frame.len;
+    if (!s->queue)
         return false;
+
+    // Do not drop the first frame if partially written, it would corrupt the event stream.
+    size_t pos = (s->queueSent) ? SSErecordLen(s->queue) : 0;
+    while (SSE_QUEUE_SIZE - s->queueUsed < need && pos < s->queueUsed)
+    {
+        size_t len = SSErecordLen(&s->queue[pos]);
+        if (s->queue[pos] == LOG_MESSAGE)
+        {
+            memmove(&s->queue[pos], &s->queue[pos + len], s->queueUsed - pos - len);
+            s->queueUsed -= len;
+            s->droppedBytes += len - SSE_RECORD_HDR;
+        }
+        else
+        {
+            pos += len;
+        }
+    }
+    if (SSE_QUEUE_SIZE - s->queueUsed < need)
+    {
+        if (type != LOG_MESSAGE)
+            return false;
+        s->droppedBytes += frame.len;
+        return true;
     }
 
-    // Find a free slot
-    for (int i = 0; i < MAX_CONCURRENT_REQUESTS; i++)
+    if (s->queueUsed == 0)
+        s->lastProgress = _millis();
+    uint8_t *record = &s->queue[s->queueUsed];
+    record[0] = type;
+    record[1] = (wsHdr + frame.len) & 0xFF;
+    record[2] = (wsHdr + frame.len) >> 8;
+    if (wsHdr)
     {
-        if (!activeRequests[i].inUse)
+        record[SSE_RECORD_HDR] = 0x80 | opcode; // FIN
+        if (wsHdr == 2)
         {
-            activeRequests[i].clientIP = clientIP;
-            activeRequests[i].startTime = now;
-            activeRequests[i].inUse = true;
-            activeRequestCount++;
-            return true;
+            record[SSE_RECORD_HDR + 1] = frame.len;
+        }
+        else
+        {
+            record[SSE_RECORD_HDR + 1] = 126;
+            record[SSE_RECORD_HDR + 2] = frame.len >> 8;
+            record[SSE_RECORD_HDR + 3] = frame.len & 0xFF;
         }
     }
+    memcpy(&record[SSE_RECORD_HDR + wsHdr], frame.data, frame.len);
+    s->queueUsed += need;
+    s->queueMax = std::max(s->queueMax, s->queueUsed);
+    return true;
+}
 
-    return false;
+// Write queued frames until the socket would block.  Returns false if connection failed.
+// Call with SSE mutex held.
+static bool SSEdrain(SSESubscription *s)
+{
+    while (s->queueUsed)
+    {
+        size_t len = SSErecordLen(s->queue);
+        int n = SSEwriteNonBlocking(s->client, &s->queue[SSE_RECORD_HDR + s->queueSent], len - SSE_RECORD_HDR - s->queueSent);
+        if (n < 0)
+            return false;
+        if (n == 0)
+            break;
+        s->lastProgress = _millis();
+        s->queueSent += n;
+        if (s->queueSent < len - SSE_RECORD_HDR)
+            break;
+        memmove(s->queue, &s->queue[len], s->queueUsed - len);
+        s->queueUsed -= len;
+        s->queueSent = 0;
+    }
+    return true;
 }
 
-void unregisterRequest()
+// Take a token from the client's bucket for this class of request.  Returns 0 if the request
+// is admitted, else the number of seconds until a token will be available.
+static uint32_t admitRequest(RateClass rateClass)
 {
     IPAddress clientIP = server.client().remoteIP();
+    _millis_t now = _millis();
+    const RateBudget &budget = rateBudget[rateClass];
 
-    for (int i = 0; i < MAX_CONCURRENT_REQUESTS; i++)
+    RateClient *c = &rateClients[0];
+    for (uint32_t i = 0; i < RATE_MAX_CLIENTS; i++)
     {
-        if (activeRequests[i].inUse && activeRequests[i].clientIP == clientIP)
+        if (rateClients[i].clientIP == clientIP)
         {
-            activeRequests[i].inUse = false;
-            if (activeRequestCount > 0)
-                activeRequestCount--; // Prevent negative count
+            c = &rateClients[i];
             break;
         }
+        if (rateClients[i].lastSeen < c->lastSeen)
+            c = &rateClients[i];
     }
+    if (c->clientIP != clientIP)
+    {
+        // New client, take over the least recently seen slot with full buckets
+        if (c->clientIP)
+            rateEvictions++;
+        c->clientIP = clientIP;
+        for (uint32_t i = 0; i < RATE_CLASSES; i++)
+        {
+            c->tokens[i] = rateBudget[i].burst;
+            c->lastRefill[i] = now;
+        }
+    }
+    c->lastSeen = now;
+
+    uint32_t add = (now - c->lastRefill[rateClass]) / budget.refillMs;
+    if (add > 0)
+    {
+        c->tokens[rateClass] = std::min((uint32_t)budget.burst, c->tokens[rateClass] + add);
+        c->lastRefill[rateClass] = (c->tokens[rateClass] == budget.burst) ? now : c->lastRefill[rateClass] + add * budget.refillMs;
+    }
+    if (c->tokens[rateClass] > 0)
+    {
+        c->tokens[rateClass]--;
+        rateAdmitted[rateClass]++;
+        return 0;
+    }
+    rateThrottled[rateClass]++;
+    return (budget.refillMs - (now - c->lastRefill[rateClass]) + 999) / 1000;
+}
+
+static void sendTooManyRequests(RateClass rateClass, uint32_t retryAfter)
+{
+    ESP_LOGW(TAG, "Client %s throttled (%s requests), retry after %lus: %s", server.client().remoteIP().toString().c_str(), rateClassName[rateClass], retryAfter, server.uri().c_str());
+    server.sendHeader(F("Retry-After"), String(retryAfter));
+    server.send_P(429, type_txt, response429);
 }
 
 void web_loop()
@@ -315,7 +628,6 @@ void web_loop()
 
     static char *json = loop_json;
     _millis_t upTime = _millis();
-    static _millis_t last_request_time = 0;
 
     // manage frequency of mDNS updates
     if (mdnsUpdatePending) {
@@ -330,22 +642,27 @@ void web_loop()
         add_dynamic_mdns();
     }
 
-    TAKE_MUTEX();
-    JSON_START(json);
+    // Everything reported below is flagged in garage_door_changed when it is set, so when
+    // nothing has changed this is all we need to check.
+    uint32_t changed = gdo_take_changed();
+    // Time-to-close countdown changes every second, poll it until we report that it stopped.
+    static uint32_t lastTTCactive = 0;
+    if (lastTTCactive)
+        changed |= GDO_CHANGED_TTC_ACTIVE;
 #ifdef USE_DHT22
     // DHT22 sensor read and config
-    int dht22Pin = userConfig->contains(cfg_dht22Pin) ? std::get<int>(userConfig->get(cfg_dht22Pin)) : -1;
-    std::string tempFormat = userConfig->contains(cfg_dht22TempFormat) ? std::get<configStr>(userConfig->get(cfg_dht22TempFormat)).str : "C";
+    int dht22Pin = userConfig->getDHT22Pin();
+    bool fahrenheit = (toupper(*userConfig->getDHT22TempFormat()) == 'F');
     static float dht22Temp = NAN;
     static float dht22Hum = NAN;
     static unsigned long lastDHT22Read = 0;
-    static std::string lastTempFormat = "";
+    static bool lastFahrenheit = false;
     const unsigned long DHT22_READ_INTERVAL = 60000; // 60 seconds
 
     // Reset cache if temperature format changes
-    if (tempFormat != lastTempFormat) {
+    if (fahrenheit != lastFahrenheit) {
         lastDHT22Read = 0;
-        lastTempFormat = tempFormat;
+        lastFahrenheit = fahrenheit;
     }
 
     if (dht22Pin >= 0) {
@@ -354,84 +671,111 @@ void web_loop()
         if (lastDHT22Read == 0 || (currentMillis - lastDHT22Read >= DHT22_READ_INTERVAL)) {
             static DHT dht(dht22Pin, DHT22);
             dht.begin();
-            if (tempFormat == "F" || tempFormat == "f") {
+            if (fahrenheit) {
                 dht22Temp = dht.readTemperature(true);
             } else {
                 dht22Temp = dht.readTemperature();
             }
             dht22Hum = dht.readHumidity();
             lastDHT22Read = currentMillis;
+            changed |= GDO_CHANGED_DHT22;
 
 #ifndef ESP8266
             if (!isnan(dht22Temp) && !isnan(dht22Hum)) {
                 // HomeKit always expects temperature in Celsius
                 float tempCelsius = dht22Temp;
-                if (tempFormat == "F" || tempFormat == "f") {
+                if (fahrenheit) {
                     tempCelsius = (dht22Temp - 32.0) * 5.0 / 9.0;
                 }
                 notify_homekit_temperature_humidity(tempCelsius, dht22Hum);
             }
 #endif
         }
-
-        if (!isnan(dht22Temp)) {
-            JSON_ADD_FLOAT("dht22Temp", dht22Temp);
-        }
-        if (!isnan(dht22Hum)) {
-            JSON_ADD_FLOAT("dht22Hum", dht22Hum);
-        }
     }
 #endif // USE_DHT22
-    // ...existing code...
-#ifdef RATGDO32_DISCO
-    // Feature not available on ESP8266
-    if (garage_door.has_distance_sensor)
+    if (changed)
     {
-        if (vehicleStatusChange)
+        TAKE_MUTEX();
+        JSON_START(json, LOOP_JSON_BUFFER_SIZE);
+#ifdef USE_DHT22
+        if ((changed & GDO_CHANGED_DHT22) && !isnan(dht22Temp))
+            JSON_ADD_FLOAT("dht22Temp", dht22Temp);
+        if ((changed & GDO_CHANGED_DHT22) && !isnan(dht22Hum))
+            JSON_ADD_FLOAT("dht22Hum", dht22Hum);
+#endif
+#ifdef RATGDO32_DISCO
+        // Feature not available on ESP8266
+        if (garage_door.has_distance_sensor)
         {
-            vehicleStatusChange = false;
-            JSON_ADD_STR("vehicleStatus", vehicleStatus);
+            if (changed & GDO_CHANGED_VEHICLE)
+                JSON_ADD_STR("vehicleStatus", vehicleStatus);
+            if (changed & GDO_CHANGED_LASER)
+                JSON_ADD_BOOL("assistLaser", laser.state());
         }
-        JSON_ADD_BOOL_C("assistLaser", laser.state(), last_reported_assist_laser);
-    }
 #endif
-    // Conditional macros, only add if value has changed
-    JSON_ADD_BOOL_C("paired", homekit_is_paired(), last_reported_paired);
-    JSON_ADD_STR_C("garageDoorState", DOOR_STATE(garage_door.current_state), garage_door.current_state, last_reported_garage_door.current_state);
-    JSON_ADD_STR_C("garageLockState", REMOTES_STATE(garage_door.current_lock), garage_door.current_lock, last_reported_garage_door.current_lock);
-    JSON_ADD_BOOL_C("garageLightOn", garage_door.light, last_reported_garage_door.light);
-    JSON_ADD_BOOL_C("garageMotion", garage_door.motion, last_reported_garage_door.motion);
-    JSON_ADD_BOOL_C("pinBasedObst", garage_door.pinModeObstructionSensor, last_reported_garage_door.pinModeObstructionSensor);
-    JSON_ADD_BOOL_C("garageObstructed", garage_door.obstructed, last_reported_garage_door.obstructed);
-    JSON_ADD_BOOL_C("garageSec1Emulated", garage_door.wallPanelEmulated, last_reported_garage_door.wallPanelEmulated);
-    if (doorControlType == 2)
-    {
-        JSON_ADD_INT_C("batteryState", garage_door.batteryState, last_reported_garage_door.batteryState);
-        JSON_ADD_INT_C("openingsCount", garage_door.openingsCount, last_reported_garage_door.openingsCount);
-        JSON_ADD_INT_C(cfg_builtInTTC, garage_door.builtInTTC, last_reported_garage_door.builtInTTC);
-        JSON_ADD_INT_C("builtInTTCremaining", garage_door.builtInTTCremaining, last_reported_garage_door.builtInTTCremaining);
-        JSON_ADD_BOOL_C("builtInTTChold", garage_door.builtInTTChold, last_reported_garage_door.builtInTTChold);
-    }
-    JSON_ADD_INT_C("openDuration", garage_door.openDuration, last_reported_garage_door.openDuration);
-    JSON_ADD_INT_C("closeDuration", garage_door.closeDuration, last_reported_garage_door.closeDuration);
-    JSON_ADD_INT_C("ttcActive", is_ttc_active(), last_reported_garage_door.ttcActive);
-    // got any json?
-    if (strlen(json) > 2)
-    {
-        // Have we added anything to the JSON string?
-        JSON_ADD_INT("upTime", upTime);
-        JSON_END();
-        if (strlen(json) > LOOP_JSON_BUFFER_SIZE * 8 / 10)
+        if (changed & GDO_CHANGED_PAIRED)
+            JSON_ADD_BOOL("paired", homekit_is_paired());
+        if (changed & GDO_CHANGED_DOOR_STATE)
+            JSON_ADD_STR("garageDoorState", DOOR_STATE(garage_door.current_state));
+        if (changed & GDO_CHANGED_LOCK_STATE)
+            JSON_ADD_STR("garageLockState", REMOTES_STATE(garage_door.current_lock));
+        if (changed & GDO_CHANGED_LIGHT)
+            JSON_ADD_BOOL("garageLightOn", garage_door.light);
+        if (changed & GDO_CHANGED_MOTION)
+            JSON_ADD_BOOL("garageMotion", garage_door.motion);
+        if (changed & GDO_CHANGED_PIN_OBST)
+            JSON_ADD_BOOL("pinBasedObst", garage_door.pinModeObstructionSensor);
+        if (changed & GDO_CHANGED_OBSTRUCTED)
+            JSON_ADD_BOOL("garageObstructed", garage_door.obstructed);
+        if (changed & GDO_CHANGED_SEC1_EMULATED)
+            JSON_ADD_BOOL("garageSec1Emulated", garage_door.wallPanelEmulated);
+        if (doorControlType == 2)
+        {
+            if (changed & GDO_CHANGED_BATTERY)
+                JSON_ADD_INT("batteryState", garage_door.batteryState);
+            if (changed & GDO_CHANGED_OPENINGS)
+                JSON_ADD_INT("openingsCount", garage_door.openingsCount);
+            if (changed & GDO_CHANGED_BUILTIN_TTC)
+                JSON_ADD_INT(cfg_builtInTTC, garage_door.builtInTTC);
+            if (changed & GDO_CHANGED_TTC_REMAINING)
+                JSON_ADD_INT("builtInTTCremaining", garage_door.builtInTTCremaining);
+            if (changed & GDO_CHANGED_TTC_HOLD)
+                JSON_ADD_BOOL("builtInTTChold", garage_door.builtInTTChold);
+        }
+        if (changed & GDO_CHANGED_OPEN_DURATION)
+            JSON_ADD_INT("openDuration", garage_door.openDuration);
+        if (changed & GDO_CHANGED_CLOSE_DURATION)
+            JSON_ADD_INT("closeDuration", garage_door.closeDuration);
+        if (changed & GDO_CHANGED_TTC_ACTIVE)
         {
-            ESP_LOGW(TAG, "WARNING web_loop JSON length: %d is over 80%% of available buffer", strlen(json));
+            uint32_t ttcActive = is_ttc_active();
+            if (ttcActive != lastTTCactive)
+            {
+                lastTTCactive = ttcActive;
+                JSON_ADD_INT("ttcActive", ttcActive);
+            }
         }
-        JSON_REMOVE_NL(json);
-        if (!firmwareUpdateSub) // Only send if we are not in middle of firmware upgrade.
-            SSEBroadcastState(json);
+        // got any json?
+        if (!JSON_EMPTY())
+        {
+            // Have we added anything to the JSON string?
+            JSON_ADD_INT("upTime", upTime);
+            size_t len = JSON_END();
+            if (JSON_OVERFLOW())
+            {
+                ESP_LOGE(TAG, "web_loop JSON truncated at length: %d, buffer: %d", len, LOOP_JSON_BUFFER_SIZE);
+            }
+            else if (len > LOOP_JSON_BUFFER_SIZE * 8 / 10)
+            {
+                ESP_LOGW(TAG, "WARNING web_loop JSON length: %d is over 80%% of available buffer", len);
+            }
+            if (!firmwareUpdateSub) // Only send if we are not in middle of firmware upgrade.
+                SSEBroadcastState(json);
 
-        mdnsUpdatePending = true;
+            mdnsUpdatePending = true;
+        }
+        GIVE_MUTEX();
     }
-    GIVE_MUTEX();
     static time_t mdnsDoorUpdateAt = 0;
     if (lastDoorUpdateAt && !mdnsDoorUpdateAt)
     {
@@ -439,17 +783,30 @@ void web_loop()
         mdnsDoorUpdateAt = lastDoorUpdateAt;
         mdnsUpdatePending = true;
     }
-    // Rate limiting - minimum interval between requests
-    _millis_t current_time = _millis();
-    if (current_time - last_request_time < MIN_REQUEST_INTERVAL_MS)
-    {
-        return; // Skip this cycle to enforce rate limit
-    }
+#ifdef ESP8266
+    // Continue writing to SSE clients that could not keep up
+    SSEdrainAll();
 
+    reqTiming.start = micros();
     server.handleClient();
-    // Update last request time after handling client
-    last_request_time = current_time;
+#endif
+}
+
+#ifndef ESP8266
+static void webTask(void *arg)
+{
+    ESP_LOGI(TAG, "Web server task started on core %d", xPortGetCoreID());
+    while (true)
+    {
+        reqTiming.start = micros();
+        server.handleClient();
+        // Continue writing to SSE clients that could not keep up
+        SSEdrainAll();
+        // Block briefly so lower priority tasks can run, requests are still handled as soon as they arrive.
+        vTaskDelay(pdMS_TO_TICKS(WEB_TASK_IDLE_MS));
+    }
 }
+#endif
 
 void setup_web()
 {
@@ -474,8 +831,15 @@ void setup_web()
 #ifndef ESP8266
     // We allocated json as a global block.  We are on dual core CPU.  We need to serialize access to the resource.
     jsonMutex = xSemaphoreCreateMutex();
+    sseMutex = xSemaphoreCreateMutex();
+    // Web task builds status.json into its own buffer, see handle_status()
+    statusSend = static_cast<char *>(malloc(STATUS_SEND_BUFFER_SIZE));
+    if (!statusSend)
+    {
+        ESP_LOGE(TAG, "Failed to allocated buffer for status send, size: %d", STATUS_SEND_BUFFER_SIZE);
+        return;
+    }
 #endif
-    last_reported_paired = homekit_is_paired();
 
     if (!garage_door.has_motion_sensor && (bool)motionTriggers.bit.motion)
     {
@@ -502,25 +866,44 @@ void setup_web()
     server.on("/update", HTTP_POST, handle_update, handle_firmware_upload);
     server.onNotFound(handle_everything);
     // here the list of headers to be recorded
-    const char *headerkeys[] = {"If-None-Match"};
+    const char *headerkeys[] = {"If-None-Match", "Accept-Encoding", "Cookie", "Upgrade", "Sec-WebSocket-Key", "Sec-WebSocket-Version"};
     size_t headerkeyssize = sizeof(headerkeys) / sizeof(char *);
     // ask server to track these headers
     server.collectHeaders(headerkeys, headerkeyssize);
+    sessionNewKey();
     server.begin();
+    metric_counter("ratgdo_http_requests_total", "Status requests served", NULL, []() -> uint32_t
+                   { return request_count; });
+    metric_counter("ratgdo_http_throttled_total", "HTTP requests refused by rate limiting", NULL, []() -> uint32_t
+                   { return rateThrottled[RATE_STATIC] + rateThrottled[RATE_API] + rateThrottled[RATE_UPLOAD]; });
+    metric_counter("ratgdo_http_auth_total", "Authentication checks by method", "method=\"session\"", []() -> uint32_t
+                   { return sessionAuthCount; });
+    metric_counter("ratgdo_http_auth_total", "Authentication checks by method", "method=\"digest\"", []() -> uint32_t
+                   { return digestAuthCount; });
+    metric_counter("ratgdo_sse_evictions_total", "Event subscribers disconnected for not keeping up", NULL, []() -> uint32_t
+                   { return SSEevictions; });
     // initialize all the Server-Sent Events (SSE) slots.
     for (uint32_t i = 0; i < SSE_MAX_CHANNELS; i++)
     {
         subscription[i].SSEconnected = false;
         subscription[i].clientIP = INADDR_NONE;
         subscription[i].clientUUID.clear();
+        subscription[i].queue = NULL;
+        subscription[i].websocket = false;
     }
-
-    // Initialize connection tracking
-    for (int i = 0; i < MAX_CONCURRENT_REQUESTS; i++)
-    {
-        activeRequests[i].inUse = false;
-    }
-    activeRequestCount = 0;
+    SSEheartbeatTimer.attach_ms(1000, []
+                                {
+#ifdef ESP8266
+                                    schedule_recurrent_function_us([]()
+                                                                   {
+                                                                       SSEheartbeat();
+                                                                       return false; // run the fn only once
+                                                                   },
+                                                                   0); // zero micro seconds (run asap)
+#else
+                                    SSEheartbeat();
+#endif
+                                });
 
     IRAM_END(TAG);
 
@@ -545,6 +928,11 @@ void setup_web()
     }
 
     web_setup_done = true;
+#ifndef ESP8266
+    xTaskCreatePinnedToCore(webTask, "webServer", WEB_TASK_STACK_SIZE, NULL, WEB_TASK_PRIORITY, &webTaskHandle, WEB_TASK_CORE);
+    if (!webTaskHandle)
+        ESP_LOGE(TAG, "Failed to start web server task");
+#endif
     return;
 }
 
@@ -555,11 +943,7 @@ void handle_notfound()
     return;
 }
 
-#ifdef ESP8266
-#define AUTHENTICATE()                                                                                                                  \
-    if (userConfig->getPasswordRequired() && !server.authenticateDigest(userConfig->getwwwUsername(), userConfig->getwwwCredentials())) \
-        return server.requestAuthentication(DIGEST_AUTH, www_realm);
-#else
+#ifndef ESP8266
 String *ratgdoAuthenticate(HTTPAuthMethod mode, String enteredUsernameOrReq, String extraParams[])
 {
     // ESP_LOGI(TAG, "Auth method: %d", mode);                // DIGEST_AUTH
@@ -569,15 +953,169 @@ String *ratgdoAuthenticate(HTTPAuthMethod mode, String enteredUsernameOrReq, Str
     String *pw = new String(read_door_str(nvram_ratgdo_pw, "password").c_str());
     return pw;
 }
+#endif
+
+static void sessionNewKey()
+{
+#ifdef ESP8266
+    ESP.random(sessionKey, sizeof(sessionKey));
+    br_hmac_key_init(&sessionKeyContext, &br_sha256_vtable, sessionKey, sizeof(sessionKey));
+#else
+    esp_fill_random(sessionKey, sizeof(sessionKey));
+#endif
+    memset(sessionRevoked, 0, sizeof(sessionRevoked));
+}
 
-#define AUTHENTICATE()                                                                 \
-    if (userConfig->getPasswordRequired() && !server.authenticate(ratgdoAuthenticate)) \
+static void sessionMAC(const uint8_t *payload, size_t len, uint8_t *mac)
+{
+    uint8_t full[32];
+#ifdef ESP8266
+    br_hmac_context ctx;
+    br_hmac_init(&ctx, &sessionKeyContext, 0);
+    br_hmac_update(&ctx, payload, len);
+    br_hmac_out(&ctx, full);
+#else
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), sessionKey, sizeof(sessionKey), payload, len, full);
+#endif
+    memcpy(mac, full, SESSION_MAC_LEN);
+}
+
+static bool hexDecode(const char *hex, uint8_t *out, size_t len)
+{
+    for (size_t i = 0; i < len * 2; i++)
+    {
+        char c = hex[i];
+        uint8_t v;
+        if (c >= '0' && c <= '9')
+            v = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            v = c - 'a' + 10;
+        else
+            return false;
+        out[i / 2] = (i & 1) ? (out[i / 2] | v) : (v << 4);
+    }
+    return true;
+}
+
+// Returns session id from the request cookie if it is valid, unexpired and not revoked, else zero.
+static uint32_t sessionFromRequest()
+{
+    if (!server.hasHeader(F("Cookie")))
+        return 0;
+    const String &cookies = server.header(F("Cookie"));
+    const char *token = strstr(cookies.c_str(), sessionCookie);
+    if (!token)
+        return 0;
+    token += sizeof(sessionCookie) - 1;
+    if (strnlen(token, SESSION_TOKEN_LEN) < SESSION_TOKEN_LEN)
+        return 0;
+
+    uint8_t payload[8];
+    uint8_t presented[SESSION_MAC_LEN];
+    uint8_t expected[SESSION_MAC_LEN];
+    if (!hexDecode(token, payload, sizeof(payload)) || !hexDecode(token + 16, presented, sizeof(presented)))
+        return 0;
+    sessionMAC(payload, sizeof(payload), expected);
+    // Constant time compare
+    uint8_t diff = 0;
+    for (size_t i = 0; i < SESSION_MAC_LEN; i++)
+        diff |= presented[i] ^ expected[i];
+    if (diff)
+        return 0;
+
+    uint32_t id, expiry;
+    memcpy(&id, payload, 4);
+    memcpy(&expiry, payload + 4, 4);
+    if ((uint32_t)(_millis() / 1000) > expiry)
+        return 0;
+    for (size_t i = 0; i < SESSION_REVOKED_MAX; i++)
+    {
+        if (sessionRevoked[i] == id)
+            return 0;
+    }
+    return id;
+}
+
+// Add Set-Cookie header for a new session to the response about to be sent.
+static void sessionIssue()
+{
+    uint8_t payload[8];
+    uint8_t mac[SESSION_MAC_LEN];
+    uint32_t id = sessionNextId++;
+    uint32_t expiry = (uint32_t)(_millis() / 1000) + SESSION_TTL_SECONDS;
+    memcpy(payload, &id, 4);
+    memcpy(payload + 4, &expiry, 4);
+    sessionMAC(payload, sizeof(payload), mac);
+
+    static const char hex[] = "0123456789abcdef";
+    char cookie[sizeof(sessionCookie) + SESSION_TOKEN_LEN + 64];
+    char *p = cookie + strlcpy(cookie, sessionCookie, sizeof(cookie));
+    for (size_t i = 0; i < sizeof(payload); i++)
+    {
+        *p++ = hex[payload[i] >> 4];
+        *p++ = hex[payload[i] & 0x0F];
+    }
+    for (size_t i = 0; i < SESSION_MAC_LEN; i++)
+    {
+        *p++ = hex[mac[i] >> 4];
+        *p++ = hex[mac[i] & 0x0F];
+    }
+    snprintf_P(p, sizeof(cookie) - (p - cookie), PSTR("; Path=/; Max-Age=%d; HttpOnly; SameSite=Strict"), SESSION_TTL_SECONDS);
+    server.sendHeader(F("Set-Cookie"), cookie);
+    ESP_LOGI(TAG, "Session %lu issued to client %s", id, server.client().remoteIP().toString().c_str());
+}
+
+static void sessionRevoke(uint32_t id)
+{
+    for (size_t i = 0; i < SESSION_REVOKED_MAX; i++)
+    {
+        if (sessionRevoked[i] == 0)
+        {
+            sessionRevoked[i] = id;
+            return;
+        }
+    }
+    // Table full, new key ends every session
+    ESP_LOGI(TAG, "Session revocation table full, ending all sessions");
+    sessionNewKey();
+}
+
+#define AUTHENTICATE()      \
+    if (!isAuthenticated()) \
         return server.requestAuthentication(DIGEST_AUTH, www_realm);
+
+// True if no password is required or the request carries valid credentials, does not send a response.
+static bool isAuthenticated()
+{
+    if (!userConfig->getPasswordRequired())
+        return true;
+    uint32_t startMicros = micros();
+    bool ok = (sessionFromRequest() != 0);
+    if (ok)
+    {
+        sessionAuthCount++;
+    }
+    else
+    {
+#ifdef ESP8266
+        ok = server.authenticateDigest(userConfig->getwwwUsername().c_str(), userConfig->getwwwCredentials().c_str());
+#else
+        ok = server.authenticate(ratgdoAuthenticate);
 #endif
+        digestAuthCount++;
+    }
+    reqTiming.authUs += micros() - startMicros;
+    return ok;
+}
 
 void handle_auth()
 {
-    AUTHENTICATE();
+    // Login, a client without a valid session that passes digest authentication is given one.
+    if (userConfig->getPasswordRequired() && !sessionFromRequest())
+    {
+        AUTHENTICATE();
+        sessionIssue();
+    }
     server.send_P(200, type_txt, PSTR("Authenticated"));
     return;
 }
@@ -612,6 +1150,26 @@ void handle_reboot()
     return;
 }
 
+// Returns true if the Accept-Encoding header lists the encoding, without q=0
+static bool acceptsEncoding(const char *header, const char *encoding)
+{
+    size_t len = strlen(encoding);
+    const char *p = header;
+    while (*p)
+    {
+        while (*p == ' ' || *p == ',')
+            p++;
+        const char *end = p + strcspn(p, ",");
+        if (!strncasecmp(p, encoding, len) && (p + len == end || p[len] == ';' || p[len] == ' '))
+        {
+            const char *q = strstr(p, "q=");
+            return !(q && q < end && atof(q + 2) == 0);
+        }
+        p = end;
+    }
+    return false;
+}
+
 void load_page(const char *page)
 {
     IPAddress clientIP = server.client().remoteIP();
@@ -638,86 +1196,79 @@ void load_page(const char *page)
         server.send_P(303, type_txt, "", 0);
         return;
     }
-    else if (webcontent.count(page) == 0)
-        return handle_notfound();
 
-    const unsigned char *data = webcontent.at(page).data;
-    int length = webcontent.at(page).length;
-    const char *typeP = webcontent.at(page).type;
-    const char *crc32 = webcontent.at(page).crc32.c_str();
-    // need local copy as strcmp_P cannot take two PSTR()'s
-    char type[MAX_MIME_TYPE_LEN];
-    strncpy_P(type, typeP, MAX_MIME_TYPE_LEN);
+    const pageContent *pc = webcontent_find(page);
+    if (!pc)
+        return handle_notfound();
 
-    bool cache = false;
-    char cacheHdr[24] = "no-cache, no-store";
-    char matchHdr[8] = "";
-    if ((CACHE_CONTROL > 0) &&
-        (!strcmp_P(type, type_css) || !strcmp_P(type, type_html) || !strcmp_P(type, type_js) || strstr_P(type, PSTR("image"))))
+    // Response headers are prebuilt at compile time (see build_web_content.py), we only
+    // need to pick the encoding, decide between 200 and 304 and write them straight out of flash.
+    HTTPMethod method = server.method();
+    const pageVariant *pv = &pc->gzip;
+    if (pc->br.data && server.hasHeader(F("Accept-Encoding")) && acceptsEncoding(server.header(F("Accept-Encoding")).c_str(), "br"))
+        pv = &pc->br;
+    timingSendStart(false);
+    if (pc->cache && server.hasHeader(F("If-None-Match")) && !strcmp(pv->etag, server.header(F("If-None-Match")).c_str()))
+    {
+        ESP_LOGD(TAG, "Sending 304 not modified to client %s requesting: %s (method: %s)", clientIP.toString().c_str(), page, http_methods[method]);
+        server.sendContent_P(pv->notModified, pv->notModifiedLength);
+        return;
+    }
+    server.sendContent_P(pv->header, pv->headerLength);
+    if (method == HTTP_HEAD)
     {
-        snprintf_P(cacheHdr, sizeof(cacheHdr), PSTR("max-age=%d"), CACHE_CONTROL);
-        cache = true;
+        ESP_LOGD(TAG, "Client %s requesting: %s (HTTP_HEAD)", clientIP.toString().c_str(), page);
+        return;
     }
-    if (server.hasHeader(F("If-None-Match")))
-        strlcpy(matchHdr, server.header(F("If-None-Match")).c_str(), sizeof(matchHdr));
-
-    HTTPMethod method = server.method();
-    if (strcmp(crc32, matchHdr))
+    ESP_LOGD(TAG, "Client %s requesting: %s (HTTP_GET, encoding: %s, length: %d)", clientIP.toString().c_str(), page, (pv == &pc->br) ? "br" : "gzip", pv->length);
+    // Stream from flash one TCP segment at a time, stop early if the client goes away.
+    for (uint32_t sent = 0; sent < pv->length; sent += WEBCONTENT_CHUNK_SIZE)
     {
-        server.sendHeader(F("Content-Encoding"), F("gzip"));
-        server.sendHeader(F("Cache-Control"), cacheHdr);
-        if (cache)
-            server.sendHeader(F("ETag"), crc32);
-        if (method == HTTP_HEAD)
-        {
-            ESP_LOGD(TAG, "Client %s requesting: %s (HTTP_HEAD, type: %s)", clientIP.toString().c_str(), page, type);
-            server.send_P(200, type, "", 0);
-        }
-        else
+        if (!server.client().connected())
         {
-            ESP_LOGD(TAG, "Client %s requesting: %s (HTTP_GET, type: %s, length: %d)", clientIP.toString().c_str(), page, type, length);
-            server.send_P(200, type, reinterpret_cast<const char *>(data), length);
+            ESP_LOGD(TAG, "Client %s disconnected after %lu of %d bytes", clientIP.toString().c_str(), sent, pv->length);
+            break;
         }
-    }
-    else
-    {
-        ESP_LOGD(TAG, "Sending 304 not modified to client %s requesting: %s (method: %s, type: %s)", clientIP.toString().c_str(), page, http_methods[method], type);
-        server.send_P(304, type, "", 0);
+        server.sendContent_P(reinterpret_cast<const char *>(pv->data) + sent, std::min((uint32_t)WEBCONTENT_CHUNK_SIZE, pv->length - sent));
     }
     return;
 }
 
 void handle_everything()
 {
-    // Connection throttling
-    if (!registerRequest())
-    {
-        server.send(503, type_txt, response503);
-        ESP_LOGW(TAG, "Reject request, server too busy (handle_everything)");
-        return;
-    }
-
+    reqTiming.dispatch = micros();
+    reqTiming.sendAt = 0;
+    reqTiming.authUs = 0;
     HTTPMethod method = server.method();
     String page = server.uri();
     const char *uri = page.c_str();
+    bool builtIn = builtInUri.count(uri) > 0;
+    bool events = (method == HTTP_GET) && !strncmp_P(uri, restEvents, strlen(restEvents));
+
+    // Admission control, web page content and API calls have separate budgets
+    RateClass rateClass = (builtIn || events) ? RATE_API : RATE_STATIC;
+    uint32_t retryAfter = admitRequest(rateClass);
+    if (retryAfter)
+        return sendTooManyRequests(rateClass, retryAfter);
 
     // too verbose... ESP_LOGI(TAG, "Handle everything for %s", uri);
-    if (builtInUri.count(uri) > 0)
+    if (builtIn)
     {
         // requested page matches one of our built-in handlers
         ESP_LOGD(TAG, "Client %s requesting: %s (method: %s)", server.client().remoteIP().toString().c_str(), uri, http_methods[method]);
-        if (method == builtInUri.at(uri).first)
+        auto route = builtInUri.find(uri);
+        if (method == route->second.first)
         {
-            builtInUri.at(uri).second();
+            route->second.second();
+            observeRoute(route->first.c_str());
         }
         else
         {
             handle_notfound();
         }
-        unregisterRequest();
         return;
     }
-    else if ((method == HTTP_GET) && (!strncmp_P(uri, restEvents, strlen(restEvents))))
+    else if (events)
     {
         // Request for "/rest/events/" with a channel number appended
         uri += strlen(restEvents);
@@ -725,12 +1276,12 @@ void handle_everything()
         if (channel < SSE_MAX_CHANNELS)
         {
             SSEHandler(channel);
+            observeRoute(routeEvents);
         }
         else
         {
             handle_notfound();
         }
-        unregisterRequest();
         return;
     }
     else if (method == HTTP_GET || method == HTTP_HEAD)
@@ -744,26 +1295,43 @@ void handle_everything()
         {
             load_page(uri);
         }
-        unregisterRequest();
+        observeRoute(routeStatic);
         return;
     }
     // it is a HTTP_POST for unknown URI
     handle_notfound();
-    unregisterRequest();
     return;
 }
 
-void build_status_json(char *json)
+// Status values that only change on a config write, or never during this boot. Rendered once
+// into statusStatic and rebuilt when the userConfig version changes.
+static const char *build_status_static(size_t *length)
 {
-    // Build the JSON string
-    _millis_t upTime = _millis();
-    JSON_START(json);
+    static char *statusStatic = nullptr;
+    static size_t statusStaticLen = 0;
+    static uint32_t statusStaticVersion = 0;
+
+    if (statusStatic && statusStaticVersion == userConfig->getVersion())
+    {
+        *length = statusStaticLen;
+        return statusStatic;
+    }
+    if (!statusStatic)
+    {
+        statusStatic = static_cast<char *>(malloc(STATUS_STATIC_BUFFER_SIZE));
+        if (!statusStatic)
+        {
+            ESP_LOGE(TAG, "Failed to allocate buffer for static status JSON, size: %d", STATUS_STATIC_BUFFER_SIZE);
+            *length = 0;
+            return nullptr;
+        }
+    }
+    statusStaticVersion = userConfig->getVersion();
+    JSON_START(statusStatic, STATUS_STATIC_BUFFER_SIZE);
     JSON_ADD_STR("gitRepo", gitRepo);
-    JSON_ADD_INT("upTime", upTime);
     JSON_ADD_STR(cfg_deviceName, userConfig->getDeviceName());
     JSON_ADD_STR("userName", userConfig->getwwwUsername());
-    JSON_ADD_BOOL("paired", homekit_is_paired());
-    JSON_ADD_STR("firmwareVersion", std::string(AUTO_VERSION).c_str());
+    JSON_ADD_STR("firmwareVersion", AUTO_VERSION);
 #ifdef GRGDO1_V1
     JSON_ADD_STR("hardwareRevision", "rev1");
 #else
@@ -774,16 +1342,82 @@ void build_status_json(char *json)
     JSON_ADD_STR(cfg_gatewayIP, userConfig->getGatewayIP());
     JSON_ADD_STR(cfg_nameserverIP, userConfig->getNameserverIP());
     JSON_ADD_STR("macAddress", WiFi.macAddress().c_str());
+    JSON_ADD_INT("wifiPower", userConfig->getWifiPower());
+    JSON_ADD_INT(cfg_GDOSecurityType, (uint32_t)userConfig->getGDOSecurityType());
+    JSON_ADD_BOOL(cfg_passwordRequired, userConfig->getPasswordRequired());
+    JSON_ADD_INT(cfg_rebootSeconds, (uint32_t)userConfig->getRebootSeconds());
+    JSON_ADD_BOOL(cfg_staticIP, userConfig->getStaticIP());
+    JSON_ADD_BOOL(cfg_syslogEn, userConfig->getSyslogEn());
+    JSON_ADD_STR(cfg_syslogIP, userConfig->getSyslogIP());
+    JSON_ADD_INT(cfg_syslogPort, userConfig->getSyslogPort());
+    JSON_ADD_INT(cfg_syslogFacility, userConfig->getSyslogFacility());
+    JSON_ADD_INT(cfg_logLevel, userConfig->getLogLevel());
+    JSON_ADD_INT(cfg_TTCseconds, userConfig->getTTCseconds());
+    JSON_ADD_BOOL(cfg_TTClight, userConfig->getTTClight());
+    JSON_ADD_INT(cfg_motionTriggers, (uint32_t)motionTriggers.asInt);
+    JSON_ADD_INT(cfg_LEDidle, userConfig->getLEDidle());
+    JSON_ADD_BOOL("enableNTP", enableNTP);
+    // Send default timezone if configuration is empty to prevent JavaScript errors
+    configString tz = userConfig->getTimeZone();
+    JSON_ADD_STR(cfg_timeZone, (strlen(tz) > 0) ? tz.c_str() : "Etc/UTC;UTC0");
+    JSON_ADD_BOOL(cfg_dcOpenClose, userConfig->getDCOpenClose());
+    JSON_ADD_BOOL(cfg_dcBypassTTC, userConfig->getDCBypassTTC());
+    JSON_ADD_BOOL(cfg_obstFromStatus, userConfig->getObstFromStatus());
+    JSON_ADD_INT(cfg_dcDebounceDuration, userConfig->getDCDebounceDuration());
+    JSON_ADD_STR("qrPayload", qrPayload);
+#ifdef ESP8266
+    JSON_ADD_INT("wifiPhyMode", userConfig->getWifiPhyMode());
+#else
+    JSON_ADD_INT(cfg_occupancyDuration, userConfig->getOccupancyDuration());
+    JSON_ADD_BOOL(cfg_enableIPv6, userConfig->getEnableIPv6());
+#ifdef USE_GDOLIB
+    JSON_ADD_BOOL(cfg_useSWserial, userConfig->getUseSWserial());
+#endif
+#ifdef RATGDO32_DISCO
+    JSON_ADD_BOOL(cfg_vehicleHomeKit, userConfig->getVehicleHomeKit());
+    JSON_ADD_BOOL(cfg_vehicleOccupancyHomeKit, userConfig->getVehicleOccupancyHomeKit());
+    JSON_ADD_BOOL(cfg_vehicleArrivingHomeKit, userConfig->getVehicleArrivingHomeKit());
+    JSON_ADD_BOOL(cfg_vehicleDepartingHomeKit, userConfig->getVehicleDepartingHomeKit());
+    JSON_ADD_INT(cfg_vehicleThreshold, userConfig->getVehicleThreshold());
+    JSON_ADD_BOOL(cfg_laserEnabled, userConfig->getLaserEnabled());
+    JSON_ADD_BOOL(cfg_laserHomeKit, userConfig->getLaserHomeKit());
+    JSON_ADD_INT(cfg_assistDuration, userConfig->getAssistDuration());
+#endif
+    JSON_ADD_BOOL(cfg_homespanCLI, userConfig->getEnableHomeSpanCLI());
+    JSON_ADD_BOOL(cfg_lightHomeKit, userConfig->getLightHomeKit());
+    JSON_ADD_BOOL(cfg_motionHomeKit, userConfig->getMotionHomeKit());
+#endif
+#ifdef USE_DHT22
+    JSON_ADD_INT(cfg_dht22Pin, (int32_t)userConfig->getDHT22Pin());
+    JSON_ADD_STR(cfg_dht22TempFormat, userConfig->getDHT22TempFormat());
+#endif
+    statusStaticLen = JSON_END();
+    if (JSON_OVERFLOW())
+    {
+        ESP_LOGE(TAG, "Static JSON status truncated at length: %d, buffer: %d", statusStaticLen, STATUS_STATIC_BUFFER_SIZE);
+    }
+    ESP_LOGD(TAG, "Static JSON status rebuilt for config version %lu, length: %d", statusStaticVersion, statusStaticLen);
+    *length = statusStaticLen;
+    return statusStatic;
+}
+
+// Status values that change at runtime, added to a JSON document started by caller.
+static void build_status_dynamic(JsonWriter &_json)
+{
+    _millis_t upTime = _millis();
+    char rssi[32];
+    char history[160];
+    JSON_ADD_INT("upTime", upTime);
+    JSON_ADD_BOOL("paired", homekit_is_paired());
     JSON_ADD_STR("wifiSSID", WiFi.SSID().c_str());
-    JSON_ADD_STR("wifiRSSI", (std::to_string(WiFi.RSSI()) + " dBm, Channel " + std::to_string(WiFi.channel())).c_str());
+    snprintf_P(rssi, sizeof(rssi), PSTR("%d dBm, Channel %d"), WiFi.RSSI(), WiFi.channel());
+    JSON_ADD_STR("wifiRSSI", rssi);
     JSON_ADD_STR("wifiBSSID", WiFi.BSSIDstr().c_str());
 #ifdef ESP8266
     JSON_ADD_BOOL("lockedAP", wifiConf.bssid_set);
 #else
     JSON_ADD_BOOL("lockedAP", false);
 #endif
-    JSON_ADD_INT("wifiPower", userConfig->getWifiPower());
-    JSON_ADD_INT(cfg_GDOSecurityType, (uint32_t)userConfig->getGDOSecurityType());
     JSON_ADD_BOOL("garageSec1Emulated", garage_door.wallPanelEmulated);
     JSON_ADD_STR("garageDoorState", garage_door.active ? DOOR_STATE(garage_door.current_state) : DOOR_STATE(255));
     JSON_ADD_STR("garageLockState", REMOTES_STATE(garage_door.current_lock));
@@ -791,38 +1425,17 @@ void build_status_json(char *json)
     JSON_ADD_BOOL("garageMotion", garage_door.motion);
     JSON_ADD_BOOL("garageObstructed", garage_door.obstructed);
     JSON_ADD_BOOL("pinBasedObst", garage_door.pinModeObstructionSensor);
-    JSON_ADD_BOOL(cfg_passwordRequired, userConfig->getPasswordRequired());
-    JSON_ADD_INT(cfg_rebootSeconds, (uint32_t)userConfig->getRebootSeconds());
     JSON_ADD_INT("freeHeap", free_heap);
     JSON_ADD_INT("minHeap", min_heap);
     JSON_ADD_INT("crashCount", abs(crashCount));
-    JSON_ADD_BOOL(cfg_staticIP, userConfig->getStaticIP());
-    JSON_ADD_BOOL(cfg_syslogEn, userConfig->getSyslogEn());
-    JSON_ADD_STR(cfg_syslogIP, userConfig->getSyslogIP());
-    JSON_ADD_INT(cfg_syslogPort, userConfig->getSyslogPort());
-    JSON_ADD_INT(cfg_syslogFacility, userConfig->getSyslogFacility());
-    JSON_ADD_INT(cfg_logLevel, userConfig->getLogLevel());
-    JSON_ADD_INT(cfg_TTCseconds, userConfig->getTTCseconds());
-    JSON_ADD_BOOL(cfg_TTClight, userConfig->getTTClight());
-    JSON_ADD_INT(cfg_motionTriggers, (uint32_t)motionTriggers.asInt);
-    JSON_ADD_INT(cfg_LEDidle, userConfig->getLEDidle());
     // We send milliseconds relative to current time... ie updated X milliseconds ago
     JSON_ADD_INT(cfg_doorUpdateAt, (upTime - lastDoorUpdateAt));
     JSON_ADD_INT(cfg_doorOpenAt, (upTime - lastDoorOpenAt));
     JSON_ADD_INT(cfg_doorCloseAt, (upTime - lastDoorCloseAt));
-    JSON_ADD_BOOL("enableNTP", enableNTP);
     if (enableNTP && (bool)clockSet)
     {
         JSON_ADD_INT("serverTime", time(NULL));
     }
-    // Send default timezone if configuration is empty to prevent JavaScript errors
-    const char *tz = userConfig->getTimeZone();
-    JSON_ADD_STR(cfg_timeZone, (tz && strlen(tz) > 0) ? tz : "Etc/UTC;UTC0");
-    JSON_ADD_BOOL(cfg_dcOpenClose, userConfig->getDCOpenClose());
-    JSON_ADD_BOOL(cfg_dcBypassTTC, userConfig->getDCBypassTTC());
-    JSON_ADD_BOOL(cfg_obstFromStatus, userConfig->getObstFromStatus());
-    JSON_ADD_INT(cfg_dcDebounceDuration, userConfig->getDCDebounceDuration());
-    JSON_ADD_STR("qrPayload", qrPayload);
     if (doorControlType == 2)
     {
         JSON_ADD_INT("batteryState", garage_door.batteryState);
@@ -835,64 +1448,62 @@ void build_status_json(char *json)
     if (garage_door.openDuration)
     {
         JSON_ADD_INT("openDuration", garage_door.openDuration);
-        snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"max\": %d, \"count\": %d, \"duration\": [ %d, %d, %d, %d, %d, %d ] }"),
+        snprintf_P(history, sizeof(history), PSTR("{ \"max\": %d, \"count\": %d, \"duration\": [ %d, %d, %d, %d, %d, %d ] }"),
                    openHistory.max, openHistory.count,
                    openHistory(1), openHistory(2), openHistory(3), openHistory(4), openHistory(5), openHistory(6));
-        JSON_ADD_RAW("openHistory", writeBuffer);
+        JSON_ADD_RAW("openHistory", history);
     }
     if (garage_door.closeDuration)
     {
         JSON_ADD_INT("closeDuration", garage_door.closeDuration);
-        snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("{ \"max\": %d, \"count\": %d, \"duration\": [ %d, %d, %d, %d, %d, %d ] }"),
+        snprintf_P(history, sizeof(history), PSTR("{ \"max\": %d, \"count\": %d, \"duration\": [ %d, %d, %d, %d, %d, %d ] }"),
                    closeHistory.max, closeHistory.count,
                    closeHistory(1), closeHistory(2), closeHistory(3), closeHistory(4), closeHistory(5), closeHistory(6));
-        JSON_ADD_RAW("closeHistory", writeBuffer);
+        JSON_ADD_RAW("closeHistory", history);
     }
 #ifdef ESP8266
 #define accessoryID arduino_homekit_get_running_server() ? arduino_homekit_get_running_server()->accessory_id : "Inactive"
 #define clientCount arduino_homekit_get_running_server() ? arduino_homekit_get_running_server()->nfds : 0
     JSON_ADD_STR("accessoryID", accessoryID);
     JSON_ADD_INT("clients", clientCount);
-    JSON_ADD_BOOL("lockedAP", wifiConf.bssid_set);
-    JSON_ADD_INT("wifiPhyMode", userConfig->getWifiPhyMode());
     JSON_ADD_INT("minStack", ESP.getFreeContStack());
 #else
-    JSON_ADD_INT(cfg_occupancyDuration, userConfig->getOccupancyDuration());
-    JSON_ADD_BOOL(cfg_enableIPv6, userConfig->getEnableIPv6());
     JSON_ADD_STR("ipv6Addresses", ipv6_addresses);
-#ifdef USE_GDOLIB
-    JSON_ADD_BOOL(cfg_useSWserial, userConfig->getUseSWserial());
-#endif
 #ifdef RATGDO32_DISCO
     JSON_ADD_BOOL("distanceSensor", garage_door.has_distance_sensor);
     if (garage_door.has_distance_sensor)
     {
         JSON_ADD_STR("vehicleStatus", vehicleStatus);
         JSON_ADD_INT("vehicleDist", (uint32_t)vehicleDistance);
-        last_reported_assist_laser = laser.state();
-        JSON_ADD_BOOL("assistLaser", last_reported_assist_laser);
+        JSON_ADD_BOOL("assistLaser", laser.state());
     }
-    JSON_ADD_BOOL(cfg_vehicleHomeKit, userConfig->getVehicleHomeKit());
-    JSON_ADD_BOOL(cfg_vehicleOccupancyHomeKit, userConfig->getVehicleOccupancyHomeKit());
-    JSON_ADD_BOOL(cfg_vehicleArrivingHomeKit, userConfig->getVehicleArrivingHomeKit());
-    JSON_ADD_BOOL(cfg_vehicleDepartingHomeKit, userConfig->getVehicleDepartingHomeKit());
-    JSON_ADD_INT(cfg_vehicleThreshold, userConfig->getVehicleThreshold());
-    JSON_ADD_BOOL(cfg_laserEnabled, userConfig->getLaserEnabled());
-    JSON_ADD_BOOL(cfg_laserHomeKit, userConfig->getLaserHomeKit());
-    JSON_ADD_INT(cfg_assistDuration, userConfig->getAssistDuration());
 #endif
-    JSON_ADD_BOOL(cfg_homespanCLI, userConfig->getEnableHomeSpanCLI());
-    JSON_ADD_BOOL(cfg_lightHomeKit, userConfig->getLightHomeKit());
-    JSON_ADD_BOOL(cfg_motionHomeKit, userConfig->getMotionHomeKit());
-#endif
-#ifdef USE_DHT22
-    JSON_ADD_INT(cfg_dht22Pin, (int32_t)userConfig->getDHT22Pin());
-    JSON_ADD_STR(cfg_dht22TempFormat, userConfig->getDHT22TempFormat());
 #endif
     JSON_ADD_INT("webRequests", request_count);
     JSON_ADD_INT("webMaxResponseTime", max_response_time);
+    JSON_ADD_INT("webThrottled", rateThrottled[RATE_STATIC] + rateThrottled[RATE_API] + rateThrottled[RATE_UPLOAD]);
     JSON_ADD_INT("ttcActive", is_ttc_active());
-    JSON_END();
+}
+
+// Build the complete status document into a buffer owned by the caller. The static segment
+// cache is shared by the web task and the serial console on the main loop, so it is read under
+// jsonMutex. Do not call while holding jsonMutex.
+size_t build_status_json(char *json, size_t size)
+{
+    size_t staticLen;
+    TAKE_MUTEX();
+    const char *statusStatic = build_status_static(&staticLen);
+    JSON_START(json, size);
+    JSON_ADD_MEMBERS(statusStatic, staticLen);
+    build_status_dynamic(_json);
+    size_t len = JSON_END();
+    bool overflow = JSON_OVERFLOW();
+    GIVE_MUTEX();
+    if (overflow)
+    {
+        ESP_LOGE(TAG, "JSON status truncated at length: %d, buffer: %d", len, size);
+    }
+    return len;
 }
 
 void add_static_mdns()
@@ -961,38 +1572,347 @@ void add_dynamic_mdns()
     lastMDNSupdate = _millis();
 }
 
-void handle_status()
+void handle_status()
+{
+    _millis_t startTime = _millis();
+    uint32_t startMicros = micros();
+    uint32_t response_time;
+    uint32_t build_time;
+    uint32_t first_byte_time;
+    size_t len;
+
+    request_count++;
+#ifdef ESP8266
+    static char *json = status_json;
+    size_t staticLen;
+    // Static segment is cached, only the dynamic segment is built per request. Send both
+    // without copying them together, dropping closing brace of the first and opening brace
+    // of the second.
+    const char *statusStatic = build_status_static(&staticLen);
+    JSON_START(json, STATUS_JSON_BUFFER_SIZE);
+    build_status_dynamic(_json);
+    len = JSON_END();
+    build_time = micros() - startMicros;
+    if (JSON_OVERFLOW())
+    {
+        ESP_LOGE(TAG, "JSON status truncated at length: %d, buffer: %d", len, STATUS_JSON_BUFFER_SIZE);
+    }
+
+    timingSendStart(true);
+    server.sendHeader(F("Cache-Control"), F("no-cache, no-store"));
+    if (staticLen > 2)
+    {
+        server.setContentLength(staticLen + len - 1);
+        server.send_P(200, type_json, "", 0);
+        first_byte_time = micros() - startMicros;
+        server.sendContent(statusStatic, staticLen - 1);
+        server.sendContent(",", 1);
+        server.sendContent(json + 1, len - 1);
+        len += staticLen - 1;
+    }
+    else
+    {
+        server.send_P(200, type_json, json);
+        first_byte_time = micros() - startMicros;
+    }
+#else
+    // We run on the web task. Copy the whole document into a buffer that only this task uses,
+    // so that jsonMutex is released before writing to the socket. A slow client must not
+    // block web_loop() on the main loop.
+    len = build_status_json(statusSend, STATUS_SEND_BUFFER_SIZE);
+    build_time = micros() - startMicros;
+
+    timingSendStart(true);
+    server.sendHeader(F("Cache-Control"), F("no-cache, no-store"));
+    server.send_P(200, type_json, statusSend, len);
+    first_byte_time = micros() - startMicros;
+#endif
+    response_time = _millis() - startTime;
+    max_response_time = std::max(max_response_time, response_time);
+    if (len > (STATUS_JSON_BUFFER_SIZE + STATUS_STATIC_BUFFER_SIZE) * 95 / 100)
+    {
+        ESP_LOGW(TAG, "WARNING JSON status: %d is over 95%% of available buffer (%d), build time %luus, first byte %luus, response time: %lums", len, STATUS_JSON_BUFFER_SIZE + STATUS_STATIC_BUFFER_SIZE, build_time, first_byte_time, response_time);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "JSON status: %d (%d%%), build time %luus, first byte %luus, response time: %lums", len, len * 100 / (STATUS_JSON_BUFFER_SIZE + STATUS_STATIC_BUFFER_SIZE), build_time, first_byte_time, response_time);
+    }
+    return;
+}
+
+// Door state fields available in compact (CBOR) status, using same keys as status.json.
+// Select with e.g. /status.cbor?fields=door,light,lock,obstruction, default is all of them.
+// Only values that are flagged in garage_door_changed are included, so that the
+// garage_door_generation counter can be used as the ETag.  That counter restarts at
+// zero on every boot, so the ETag also carries a random per-boot value, otherwise a
+// client could be told "not modified" for a different state after a reboot.
+static uint32_t statusBootNonce = 0;
+struct StatusField
+{
+    const char *name;
+    void (*add)(CborWriter &cbor);
+};
+static const StatusField statusFields[] = {
+    {"door", [](CborWriter &c)
+     { c.addStr("garageDoorState", garage_door.active ? DOOR_STATE(garage_door.current_state) : DOOR_STATE(255)); }},
+    {"lock", [](CborWriter &c)
+     { c.addStr("garageLockState", REMOTES_STATE(garage_door.current_lock)); }},
+    {"light", [](CborWriter &c)
+     { c.addBool("garageLightOn", garage_door.light); }},
+    {"motion", [](CborWriter &c)
+     { c.addBool("garageMotion", garage_door.motion); }},
+    {"obstruction", [](CborWriter &c)
+     { c.addBool("garageObstructed", garage_door.obstructed); }},
+    {"paired", [](CborWriter &c)
+     { c.addBool("paired", homekit_is_paired()); }},
+    {"battery", [](CborWriter &c)
+     { c.addUint("batteryState", garage_door.batteryState); }},
+    {"openings", [](CborWriter &c)
+     { c.addUint("openingsCount", garage_door.openingsCount); }},
+    {"openDuration", [](CborWriter &c)
+     { c.addUint("openDuration", garage_door.openDuration); }},
+    {"closeDuration", [](CborWriter &c)
+     { c.addUint("closeDuration", garage_door.closeDuration); }},
+    {"builtInTTC", [](CborWriter &c)
+     { c.addUint(cfg_builtInTTC, garage_door.builtInTTC); }},
+    // Must be last, see STATUS_FIELD_TTC
+    {"ttc", [](CborWriter &c)
+     { c.addUint("ttcActive", is_ttc_active()); }},
+};
+#define STATUS_FIELD_COUNT (sizeof(statusFields) / sizeof(statusFields[0]))
+#define STATUS_FIELD_TTC (1 << (STATUS_FIELD_COUNT - 1))
+#define STATUS_CBOR_BUFFER_SIZE 256
+
+void handle_status_cbor()
+{
+    _millis_t startTime = _millis();
+    uint32_t build_time = micros();
+    static uint8_t cbor[STATUS_CBOR_BUFFER_SIZE];
+    uint32_t fields = (1 << STATUS_FIELD_COUNT) - 1;
+
+    request_count++;
+    if (server.hasArg(F("fields")))
+    {
+        char list[128];
+        char *save = nullptr;
+        fields = 0;
+        strlcpy(list, server.arg(F("fields")).c_str(), sizeof(list));
+        for (char *name = strtok_r(list, ",", &save); name; name = strtok_r(nullptr, ",", &save))
+        {
+            uint32_t i = 0;
+            while (i < STATUS_FIELD_COUNT && strcmp(name, statusFields[i].name))
+                i++;
+            if (i == STATUS_FIELD_COUNT)
+            {
+                ESP_LOGW(TAG, "Unknown status field: %s", name);
+                server.send_P(400, type_txt, response400invalid);
+                return;
+            }
+            fields |= (1 << i);
+        }
+    }
+
+    while (statusBootNonce == 0)
+    {
+#ifdef ESP8266
+        statusBootNonce = ESP.random();
+#else
+        statusBootNonce = esp_random();
+#endif
+    }
+    // Time-to-close countdown is not flagged as a change every second, and door comms
+    // becoming active may not change the door state, so add both to the ETag.
+    char etag[48];
+    snprintf_P(etag, sizeof(etag), PSTR("\"%08lx-%lx-%lx-%x-%lx\""), statusBootNonce, garage_door_generation,
+               fields, garage_door.active, (fields & STATUS_FIELD_TTC) ? is_ttc_active() : 0);
+    server.sendHeader(F("Cache-Control"), F("no-cache"));
+    server.sendHeader(F("ETag"), etag);
+    if (server.hasHeader(F("If-None-Match")) && server.header(F("If-None-Match")) == etag)
+    {
+        server.send_P(304, type_cbor, "", 0);
+        ESP_LOGD(TAG, "CBOR status: not modified, response time: %luus", micros() - build_time);
+        return;
+    }
+
+    CborWriter writer(cbor, sizeof(cbor));
+    for (uint32_t i = 0; i < STATUS_FIELD_COUNT; i++)
+    {
+        if (fields & (1 << i))
+            statusFields[i].add(writer);
+    }
+    size_t len = writer.finish();
+    build_time = micros() - build_time;
+    if (writer.overflow())
+    {
+        ESP_LOGE(TAG, "CBOR status truncated at length: %d, buffer: %d", len, STATUS_CBOR_BUFFER_SIZE);
+    }
+    timingSendStart(true);
+    server.send_P(200, type_cbor, reinterpret_cast<const char *>(cbor), len);
+    uint32_t response_time = _millis() - startTime;
+    max_response_time = std::max(max_response_time, response_time);
+    ESP_LOGI(TAG, "CBOR status: %d bytes, build time %luus, response time: %lums", len, build_time, response_time);
+}
+
+// Small staging buffer between a renderer and socket, so that each printf does
+// not become a TCP segment, while the document is never held in RAM as a whole.
+class ClientWriter : public Print
+{
+private:
+    WiFiClient client;
+    uint8_t buf[256];
+    size_t used = 0;
+
+public:
+    explicit ClientWriter(WiFiClient c) : client(c) {}
+    ~ClientWriter() { send(); }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            if (used == sizeof(buf))
+                send();
+            buf[used++] = data[i];
+        }
+        return len;
+    }
+    void send()
+    {
+        if (used && client.connected())
+            client.write(buf, used);
+        used = 0;
+    }
+};
+
+void handle_metrics()
+{
+    // Prometheus text exposition format, streamed as it is rendered.
+    timingSendStart(false);
+    server.client().print(F("HTTP/1.1 200 OK\nContent-Type: text/plain; version=0.0.4\nCache-Control: no-cache, no-store\nConnection: close\n\n"));
+    ClientWriter out(server.client());
+    metrics_render(out);
+}
+
+void handle_profile()
+{
+    // Main loop profile, optional reset=1 to clear statistics after they are returned.
+    timingSendStart(false);
+    server.client().print(F("HTTP/1.1 200 OK\nContent-Type: application/json\nCache-Control: no-cache, no-store\nConnection: close\n\n"));
+    {
+        ClientWriter out(server.client());
+        printLoopProfileJSON(out);
+    }
+    if (server.arg(F("reset")) == "1")
+        resetLoopProfile();
+}
+
+// Add Server-Timing header with phases so far, if handler sends response with server.send().
+// Call immediately before starting the response, only the first call in a request counts.
+static void timingSendStart(bool header)
+{
+    if (reqTiming.sendAt)
+        return;
+    reqTiming.sendAt = micros();
+    if (!header)
+        return;
+    uint32_t recvUs = reqTiming.dispatch - reqTiming.start;
+    uint32_t handlerUs = reqTiming.sendAt - reqTiming.dispatch - reqTiming.authUs;
+    char timing[96];
+    snprintf_P(timing, sizeof(timing), PSTR("recv;dur=%lu.%03lu, auth;dur=%lu.%03lu, handler;dur=%lu.%03lu"),
+               recvUs / 1000, recvUs % 1000, reqTiming.authUs / 1000, reqTiming.authUs % 1000, handlerUs / 1000, handlerUs % 1000);
+    server.sendHeader(F("Server-Timing"), timing);
+}
+
+static void observeRoute(const char *route)
 {
-    _millis_t startTime = _millis();
-    uint32_t response_time;
-    uint32_t build_time;
-    static char *json = status_json;
-
-    TAKE_MUTEX();
-    request_count++;
-    build_status_json(json);
-    build_time = (uint32_t)(_millis() - startTime);
-
-    last_reported_garage_door = garage_door;
-    server.sendHeader(F("Cache-Control"), F("no-cache, no-store"));
-    server.send_P(200, type_json, json);
-    response_time = _millis() - startTime;
-    max_response_time = std::max(max_response_time, response_time);
-    if (strlen(json) > STATUS_JSON_BUFFER_SIZE * 95 / 100)
+    uint32_t now = micros();
+    uint32_t phase[REQUEST_PHASES];
+    uint32_t sendAt = (reqTiming.sendAt) ? reqTiming.sendAt : now;
+    phase[PHASE_RECV] = reqTiming.dispatch - reqTiming.start;
+    phase[PHASE_AUTH] = reqTiming.authUs;
+    phase[PHASE_HANDLER] = sendAt - reqTiming.dispatch - reqTiming.authUs;
+    phase[PHASE_SEND] = now - sendAt;
+
+    routeMetric *r = NULL;
+    for (uint32_t i = 0; i < routeMetricsCount && !r; i++)
+    {
+        if (routeMetrics[i].route == route)
+            r = &routeMetrics[i];
+    }
+    if (!r && routeMetricsCount < ROUTE_METRICS_MAX)
+    {
+        // Label must outlive the metric, allocated once per route and never freed
+        size_t len = strlen(route) + sizeof("route=\"\"");
+        char *labels = static_cast<char *>(malloc(len));
+        if (!labels)
+            return;
+        snprintf(labels, len, "route=\"%s\"", route);
+        r = &routeMetrics[routeMetricsCount];
+        memset(r, 0, sizeof(routeMetric));
+        r->route = route;
+        r->latency = metric_histogram("ratgdo_http_request_duration_seconds", "Time spent handling HTTP request", metricBucketsHttp, METRICS_MAX_BUCKETS, labels);
+        routeMetricsCount++;
+    }
+    if (!r)
+        return;
+    metric_observe(r->latency, now - reqTiming.start);
+    r->count++;
+    for (uint8_t i = 0; i < REQUEST_PHASES; i++)
     {
-        ESP_LOGW(TAG, "WARNING JSON status: %d is over 95%% of available buffer (%d), build time %lums, response time: %lums", strlen(json), STATUS_JSON_BUFFER_SIZE, build_time, response_time);
+        r->sumUs[i] += phase[i];
+        r->maxUs[i] = std::max(r->maxUs[i], phase[i]);
     }
-    else
-    {
-        ESP_LOGI(TAG, "JSON status: %d (%d%%), build time %lums, response time: %lums", strlen(json), strlen(json) * 100 / STATUS_JSON_BUFFER_SIZE, build_time, response_time);
+}
+
+void handle_timing()
+{
+    // Per route request latency histogram (from /metrics registry) and average / max time per phase.
+    timingSendStart(false);
+    server.client().print(F("HTTP/1.1 200 OK\nContent-Type: application/json\nCache-Control: no-cache, no-store\nConnection: close\n\n"));
+    ClientWriter out(server.client());
+    out.print("{\"boundsUs\":[");
+    for (uint8_t i = 0; i < METRICS_MAX_BUCKETS; i++)
+        out.printf("%s%lu", i ? "," : "", metricBucketsHttp[i]);
+    out.print("],\"routes\":{");
+    uint32_t count = routeMetricsCount;
+    for (uint32_t n = 0; n < count; n++)
+    {
+        const routeMetric *r = &routeMetrics[n];
+        out.printf("%s\"%s\":{\"count\":%lu", n ? "," : "", r->route, r->count);
+        if (r->latency)
+        {
+            // Last entry is requests over the largest bound
+            metricHistogram h = *r->latency->hist;
+            uint32_t inBuckets = 0;
+            out.print(",\"buckets\":[");
+            for (uint8_t i = 0; i < METRICS_MAX_BUCKETS; i++)
+            {
+                inBuckets += h.buckets[i];
+                out.printf("%lu,", h.buckets[i]);
+            }
+            out.printf("%lu]", h.count - inBuckets);
+        }
+        for (uint8_t i = 0; i < REQUEST_PHASES; i++)
+        {
+            out.printf(",\"%s\":{\"avgUs\":%lu,\"maxUs\":%lu}", phaseNames[i],
+                       r->count ? (uint32_t)(r->sumUs[i] / r->count) : 0, r->maxUs[i]);
+        }
+        out.print('}');
     }
-    GIVE_MUTEX();
-    return;
+    out.print("}}\n");
 }
 
 void handle_logout()
 {
     ESP_LOGI(TAG, "Handle logout");
+    uint32_t id = sessionFromRequest();
+    if (id)
+    {
+        ESP_LOGI(TAG, "Session %lu ended", id);
+        sessionRevoke(id);
+    }
+    server.sendHeader(F("Set-Cookie"), F("ratgdo_session=; Path=/; Max-Age=0; HttpOnly; SameSite=Strict"));
     return server.requestAuthentication(DIGEST_AUTH, www_realm);
 }
 
@@ -1023,32 +1943,47 @@ bool helperGarageLockState(const std::string &key, const char *value, configSett
     return true;
 }
 
+// Very basic parsing of a flat JSON object, not using library functions to save memory.
+// Copies the string value of member name into out, returns false if it is missing, not a
+// string, or does not fit.
+static bool jsonStrValue(const char *json, const char *name, char *out, size_t size)
+{
+    const char *p = strstr(json, name);
+    if (!p || !(p = strchr(p, ':')) || !(p = strchr(p, '"')))
+        return false;
+    p++;
+    const char *end = strchr(p, '"');
+    if (!end || (size_t)(end - p) >= size)
+        return false;
+    memcpy(out, p, end - p);
+    out[end - p] = 0;
+    return true;
+}
+
+// Parse the credentials JSON string into its three values, used by both validation and helper.
+static bool parseCredentials(const char *value, char *username, char *credentials, char *password)
+{
+    return jsonStrValue(value, "username", username, CREDENTIALS_FIELD_SIZE) &&
+           jsonStrValue(value, "credentials", credentials, CREDENTIALS_FIELD_SIZE) &&
+           jsonStrValue(value, "password", password, CREDENTIALS_FIELD_SIZE) &&
+           userConfig->validate(cfg_wwwUsername, username) &&
+           userConfig->validate(cfg_wwwCredentials, credentials);
+}
+
 bool helperCredentials(const std::string &key, const char *value, configSetting *action)
 {
-    const char *newUsername = strstr(value, "username");
-    const char *newCredentials = strstr(value, "credentials");
-    const char *newPassword = strstr(value, "password");
-    if (!(newUsername && newCredentials && newPassword))
+    char newUsername[CREDENTIALS_FIELD_SIZE];
+    char newCredentials[CREDENTIALS_FIELD_SIZE];
+    char newPassword[CREDENTIALS_FIELD_SIZE];
+    if (!parseCredentials(value, newUsername, newCredentials, newPassword))
         return false;
 
-    // JSON string passed in.
-    // Very basic parsing, not using library functions to save memory
-    // find the colon after the key string
-    newUsername = strchr(newUsername, ':') + 1;
-    newCredentials = strchr(newCredentials, ':') + 1;
-    newPassword = strchr(newPassword, ':') + 1;
-    // for strings find the double quote
-    newUsername = strchr(newUsername, '"') + 1;
-    newCredentials = strchr(newCredentials, '"') + 1;
-    newPassword = strchr(newPassword, '"') + 1;
-    // null terminate the strings (at closing quote).
-    *strchr(newUsername, '"') = (char)0;
-    *strchr(newCredentials, '"') = (char)0;
-    *strchr(newPassword, '"') = (char)0;
     // save values...
     ESP_LOGI(TAG, "Set credentials for user: %s", newUsername);
     userConfig->set(cfg_wwwUsername, newUsername);
     userConfig->set(cfg_wwwCredentials, newCredentials);
+    // End all sessions authenticated with the old password
+    sessionNewKey();
 #ifndef ESP8266
     // We only need to save password (distinct from credentials) on ESP32
     write_door_str(nvram_ratgdo_pw, newPassword);
@@ -1057,33 +1992,31 @@ bool helperCredentials(const std::string &key, const char *value, configSetting
     return true;
 }
 
+// Parse the firmware update JSON string, used by both validation and helper.
+static bool parseUpdateUnderway(const char *value, char *md5, char *uuid, uint32_t *size)
+{
+    const char *p = strstr(value, "size");
+    if (!p || !(p = strchr(p, ':')))
+        return false;
+    *size = atoi(p + 1);
+    return jsonStrValue(value, "md5", md5, sizeof(firmwareMD5)) &&
+           jsonStrValue(value, "uuid", uuid, UUID_FIELD_SIZE);
+}
+
 bool helperUpdateUnderway(const std::string &key, const char *value, configSetting *action)
 {
+    char md5[sizeof(firmwareMD5)];
+    char uuid[UUID_FIELD_SIZE];
+    uint32_t size;
     firmwareSize = 0;
     firmwareUpdateSub = NULL;
-    const char *md5 = strstr(value, "md5");
-    const char *size = strstr(value, "size");
-    const char *uuid = strstr(value, "uuid");
-
-    if (!(md5 && size && uuid))
+    if (!parseUpdateUnderway(value, md5, uuid, &size))
         return false;
 
-    // JSON string of passed in.
-    // Very basic parsing, not using library functions to save memory
-    // find the colon after the key string
-    md5 = strchr(md5, ':') + 1;
-    size = strchr(size, ':') + 1;
-    uuid = strchr(uuid, ':') + 1;
-    // for strings find the double quote
-    md5 = strchr(md5, '"') + 1;
-    uuid = strchr(uuid, '"') + 1;
-    // null terminate the strings (at closing quote).
-    *strchr(md5, '"') = (char)0;
-    *strchr(uuid, '"') = (char)0;
-    // ESP_LOGI(TAG,"MD5: %s, UUID: %s, Size: %d", md5, uuid, atoi(size));
+    // ESP_LOGI(TAG,"MD5: %s, UUID: %s, Size: %d", md5, uuid, size);
     // save values...
     strlcpy(firmwareMD5, md5, sizeof(firmwareMD5));
-    firmwareSize = atoi(size);
+    firmwareSize = size;
     for (uint32_t channel = 0; channel < SSE_MAX_CHANNELS; channel++)
     {
         if (subscription[channel].SSEconnected && subscription[channel].clientUUID == uuid && subscription[channel].client.connected())
@@ -1095,6 +2028,28 @@ bool helperUpdateUnderway(const std::string &key, const char *value, configSetti
     return true;
 }
 
+// Check that a value for one of the setGDO handlers can be applied. Handlers act on the door
+// or device as soon as they are called, so anything that can fail must be caught before the
+// first setting of a request is applied.
+static bool validateSetGDO(const std::string &key, const char *value)
+{
+    if (key == "credentials")
+    {
+        char username[CREDENTIALS_FIELD_SIZE];
+        char credentials[CREDENTIALS_FIELD_SIZE];
+        char password[CREDENTIALS_FIELD_SIZE];
+        return parseCredentials(value, username, credentials, password);
+    }
+    if (key == "updateUnderway")
+    {
+        char md5[sizeof(firmwareMD5)];
+        char uuid[UUID_FIELD_SIZE];
+        uint32_t size;
+        return parseUpdateUnderway(value, md5, uuid, &size);
+    }
+    return true;
+}
+
 bool helperFactoryReset(const std::string &key, const char *value, configSetting *action)
 {
 #ifdef ESP8266
@@ -1158,7 +2113,28 @@ void handle_setgdo()
         AUTHENTICATE();
     }
 
-    // Loop over all the GDO settings passed in...
+    // Validate every setting before applying any. Helpers change device state as they are
+    // called, which a rollback cannot undo, so an invalid value must be rejected here.
+    for (int i = 0; i < server.args(); i++)
+    {
+        std::string key(server.argName(i).c_str());
+        bool valid = setGDOhandlers.count(key) ? validateSetGDO(key, server.arg(i).c_str()) : userConfig->validate(key, server.arg(i).c_str());
+        if (!valid)
+        {
+            ESP_LOGW(TAG, "Invalid Key: %s, Value: %s", key.c_str(), (key == cfg_wwwCredentials || key == "credentials") ? "****" : server.arg(i).c_str());
+            ESP_LOGE(TAG, "Sending %s, for: %s", response400invalid, server.uri().c_str());
+            server.send_P(400, type_txt, response400invalid);
+            return;
+        }
+    }
+
+    // Then apply them in memory as one transaction, values are persisted together when all succeed.
+    uint32_t startUs = micros();
+#ifndef ESP8266
+    uint32_t nvWrites = nvRam->writes;
+    uint32_t nvCommits = nvRam->commits;
+#endif
+    userConfig->beginTransaction();
     for (int i = 0; i < server.args(); i++)
     {
         std::string key(server.argName(i).c_str());
@@ -1210,17 +2186,25 @@ void handle_setgdo()
 
     if (error)
     {
-        // Simple error handling...
+        // Should not happen after validation above. Configuration is rolled back, but side
+        // effects of helpers that already ran are not.
+        userConfig->rollbackTransaction();
         ESP_LOGE(TAG, "Sending %s, for: %s", response400invalid, server.uri().c_str());
         server.send_P(400, type_txt, response400invalid);
         return;
     }
 
     if (saveSettings)
-    {
         userConfig->set(cfg_wifiChanged, wifiChanged);
+    userConfig->commitTransaction();
+    if (saveSettings)
         ESP8266_SAVE_CONFIG();
-    }
+#ifdef ESP8266
+    ESP_LOGI(TAG, "Settings saved in %luus", micros() - startUs);
+#else
+    ESP_LOGI(TAG, "Settings saved in %luus, NVRAM writes: %lu, commits: %lu", micros() - startUs, nvRam->writes - nvWrites, nvRam->commits - nvCommits);
+#endif
+    timingSendStart(true);
     if (reboot)
     {
         // Some settings require reboot to take effect
@@ -1237,86 +2221,176 @@ void handle_setgdo()
     return;
 }
 
+// Called from main loop, web task, heartbeat timer and logger, any two of which may try
+// to evict the same slot. Only the first one to take the mutex frees it and counts it.
 void removeSSEsubscription(SSESubscription *s)
 {
+    SSE_TAKE_MUTEX();
+    if (!s->SSEconnected && !s->clientIP)
+    {
+        // Already removed
+        SSE_GIVE_MUTEX();
+        return;
+    }
     if (subscriptionCount > 0)
         subscriptionCount--; // Prevent negative count
-    s->heartbeatTimer.detach();
-    ESP_LOGD(TAG, "Remove SSE subscription. Total subscribed: %d", subscriptionCount);
+    uint32_t count = subscriptionCount;
+    free(s->queue);
+    s->queue = NULL;
+    s->queueUsed = 0;
+    s->queueSent = 0;
     s->client.stop();
     s->clientIP = INADDR_NONE;
     s->clientUUID.clear();
     s->SSEconnected = false;
+    s->websocket = false;
+    s->wsAuthorized = false;
+    s->wsRx = NULL;
+    s->wsRxUsed = 0;
+    SSE_GIVE_MUTEX();
+    ESP_LOGD(TAG, "Remove SSE subscription. Total subscribed: %d", count);
 }
 
-void SSEheartbeat(SSESubscription *s)
+// Queue frame for subscriber and write as much as we can without blocking.
+static void SSEsend(SSESubscription *s, const SSEFrame &frame, BroadcastType type, uint8_t opcode = WS_OP_TEXT)
 {
-    if (!s)
-        return;
-
-    if (!(s->clientIP))
+    if (!frame.len && !s->websocket)
         return;
+    SSE_TAKE_MUTEX();
+    bool ok = SSEenqueue(s, frame, type, opcode) && SSEdrain(s);
+    SSE_GIVE_MUTEX();
+    if (!ok)
+    {
+        ESP_LOGD(TAG, "Client %s (%s) SSE queue full or write failed, remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+        SSEevictions++;
+        removeSSEsubscription(s);
+    }
+}
 
-    if (!(s->SSEconnected))
+// Called from web loop to continue writing frames that were queued and evict stalled clients.
+static void SSEdrainAll()
+{
+    for (uint32_t i = 0; i < SSE_MAX_CHANNELS; i++)
     {
-        if (s->SSEfailCount++ >= 5)
+        SSESubscription *s = &subscription[i];
+        if (s->websocket && s->SSEconnected && !WSpoll(s))
         {
-            // 5 heartbeats have failed... assume client will not connect
-            // and free up the slot
-            ESP_LOGD(TAG, "Client %s (%s) >5 heartbeat fails, remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+            ESP_LOGD(TAG, "Client %s WebSocket closed, remove subscription", s->clientIP.toString().c_str());
             removeSSEsubscription(s);
+            continue;
         }
-        else
+        if (!s->SSEconnected || !s->queueUsed)
+            continue;
+        SSE_TAKE_MUTEX();
+        bool ok = SSEdrain(s);
+        bool stalled = s->queueUsed && (_millis() - s->lastProgress > SSE_STALL_TIMEOUT_MS);
+        SSE_GIVE_MUTEX();
+        if (!ok || stalled)
         {
-            ESP_LOGE(TAG, "Client %s (%s) not yet listening for SSE", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+            ESP_LOGD(TAG, "Client %s (%s) SSE write %s, remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str(), (ok) ? "stalled" : "failed");
+            SSEevictions++;
+            removeSSEsubscription(s);
         }
-        return;
     }
+}
 
-    if (s->client.connected())
-    {
-        static int8_t lastRSSI = 0;
-        static char *json = loop_json;
-        TAKE_MUTEX();
-        JSON_START(json);
-        JSON_ADD_INT("upTime", _millis());
-        JSON_ADD_INT("freeHeap", free_heap);
-        JSON_ADD_INT("minHeap", min_heap);
-        // TODO monitor stack... JSON_ADD_INT("minStack", ESP.getFreeContStack());
+// Build the heartbeat payload into frame, called once per tick shared by all subscribers.
+static void SSEbuildHeartbeat(SSEFrame &frame, SSEFrame &wsFrame)
+{
+    static int8_t lastRSSI = 0;
+    static char *json = loop_json;
+    TAKE_MUTEX();
+    JSON_START(json, LOOP_JSON_BUFFER_SIZE);
+    JSON_ADD_INT("upTime", _millis());
+    JSON_ADD_INT("freeHeap", free_heap);
+    JSON_ADD_INT("minHeap", min_heap);
+    // TODO monitor stack... JSON_ADD_INT("minStack", ESP.getFreeContStack());
 #ifdef RATGDO32_DISCO
-        static int32_t lastVehicleDistance = 0;
-        if (garage_door.has_distance_sensor && (lastVehicleDistance != vehicleDistance))
+    static int32_t lastVehicleDistance = 0;
+    if (garage_door.has_distance_sensor && (lastVehicleDistance != vehicleDistance))
+    {
+        lastVehicleDistance = vehicleDistance;
+        JSON_ADD_INT("vehicleDist", (uint32_t)vehicleDistance);
+    }
+#endif
+    if (lastRSSI != WiFi.RSSI())
+    {
+        lastRSSI = WiFi.RSSI();
+        char rssi[32];
+        snprintf_P(rssi, sizeof(rssi), PSTR("%d dBm, Channel %d"), lastRSSI, WiFi.channel());
+        JSON_ADD_STR("wifiRSSI", rssi);
+    }
+#ifdef ESP8266
+    static int lastClientCount = 0;
+    if (arduino_homekit_get_running_server() && arduino_homekit_get_running_server()->nfds != lastClientCount)
+    {
+        lastClientCount = arduino_homekit_get_running_server()->nfds;
+        JSON_ADD_INT("clients", lastClientCount);
+    }
+#endif
+    JSON_END();
+    // retry needed to before event:
+    SSEbuildFrame(frame, PSTR("event: message\ndata: %s\n\n"), json);
+    SSEbuildFrame(wsFrame, PSTR("{\"status\":%s}"), json);
+    GIVE_MUTEX();
+}
+
+void SSEheartbeat()
+{
+    static SSEFrame frame;
+    static SSEFrame wsFrame;
+    bool built = false;
+
+    SSEheartbeatTicks++;
+    if (subscriptionCount == 0)
+        return;
+
+    for (uint32_t i = 0; i < SSE_MAX_CHANNELS; i++)
+    {
+        SSESubscription *s = &subscription[i];
+        if (!(s->clientIP))
+            continue;
+
+        if (!(s->SSEconnected))
         {
-            lastVehicleDistance = vehicleDistance;
-            JSON_ADD_INT("vehicleDist", (uint32_t)vehicleDistance);
+            if (s->SSEfailCount++ >= 5)
+            {
+                // 5 heartbeats have failed... assume client will not connect
+                // and free up the slot
+                ESP_LOGD(TAG, "Client %s (%s) >5 heartbeat fails, remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+                removeSSEsubscription(s);
+            }
+            else
+            {
+                ESP_LOGD(TAG, "Client %s (%s) not yet listening for SSE", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+            }
+            continue;
         }
-#endif
-        if (lastRSSI != WiFi.RSSI())
+
+        if (!s->heartbeatInterval || (SSEheartbeatTicks % s->heartbeatInterval) != 0)
+            continue;
+
+        if (s->client.connected())
         {
-            lastRSSI = WiFi.RSSI();
-            JSON_ADD_STR("wifiRSSI", (std::to_string(lastRSSI) + " dBm, Channel " + std::to_string(WiFi.channel())).c_str());
+            if (!built)
+            {
+                SSEbuildHeartbeat(frame, wsFrame);
+                built = true;
+            }
+            SSEsend(s, (s->websocket) ? wsFrame : frame, RATGDO_STATUS);
+            YIELD();
         }
-#ifdef ESP8266
-        static int lastClientCount = 0;
-        if (arduino_homekit_get_running_server() && arduino_homekit_get_running_server()->nfds != lastClientCount)
+        else
         {
-            lastClientCount = arduino_homekit_get_running_server()->nfds;
-            JSON_ADD_INT("clients", lastClientCount);
+            ESP_LOGD(TAG, "Client %s (%s) not listening (heartbeat), remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str());
+            removeSSEsubscription(s);
+            YIELD();
         }
-#endif
-        JSON_END();
-        JSON_REMOVE_NL(json);
-        // retry needed to before event:
-        snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("event: message\ndata: %s\n\n"), json);
-        clientWrite(s->client, writeBuffer);
-        GIVE_MUTEX();
-        YIELD();
     }
-    else
+    if (built)
     {
-        ESP_LOGD(TAG, "Client %s (%s) not listening (heartbeat), remove SSE subscription", s->clientIP.toString().c_str(), s->clientUUID.c_str());
-        removeSSEsubscription(s);
-        YIELD();
+        SSEfreeFrame(frame);
+        SSEfreeFrame(wsFrame);
     }
 }
 
@@ -1340,25 +2414,18 @@ void SSEHandler(uint32_t channel)
     s.client.setTimeout(CLIENT_WRITE_TIMEOUT);       // default is 5000ms which is way too long (Watchdog will fire)
     server.setContentLength(CONTENT_LENGTH_UNKNOWN); // the payload can go on forever
     server.sendContent_P(PSTR("HTTP/1.1 200 OK\nContent-Type: text/event-stream;\nConnection: keep-alive\nCache-Control: no-cache\nAccess-Control-Allow-Origin: *\n\n"));
+    SSE_TAKE_MUTEX();
+    if (!s.queue)
+        s.queue = static_cast<uint8_t *>(malloc(SSE_QUEUE_SIZE));
+    s.queueUsed = 0;
+    s.queueSent = 0;
+    s.queueMax = 0;
+    s.droppedBytes = 0;
+    SSE_GIVE_MUTEX();
+    if (!s.queue)
+        ESP_LOGE(TAG, "Unable to allocate SSE queue for client %s (%s)", s.client.remoteIP().toString().c_str(), s.clientUUID.c_str());
     s.SSEconnected = true;
     s.SSEfailCount = 0;
-    if (s.heartbeatInterval)
-    {
-        s.heartbeatTimer.attach_ms(s.heartbeatInterval * 1000, [&s]
-                                   {
-#ifdef ESP8266
-                                       schedule_recurrent_function_us([&s]()
-                                                                      {
-                                                                          SSEheartbeat(&s);
-                                                                          return false; // run the fn only once
-                                                                      },
-                                                                      0); // zero micro seconds (run asap)
-#else
-                                       SSEheartbeat(&s);
-                                       return;
-#endif
-                                   });
-    }
     ESP_LOGD(TAG, "Client %s (%s) listening for SSE events on channel %d", s.client.remoteIP().toString().c_str(), s.clientUUID.c_str(), channel);
 }
 
@@ -1394,8 +2461,15 @@ void handle_subscribe()
     }
 
     // find the UUID and whether client wants to receive log messages and setting a heartbeat interval time
+    // Log viewers can filter the log messages sent to them...
+    //   level=N   only send log lines at or below log level N (0..5)
+    //   tag=xxx   only send log lines logged with tag xxx (or comma separated list of tags)
+    //   match=xxx only send log lines that contain the string xxx
     int id = 0;
     bool logViewer = false;
+    esp_log_level_t logMaxLevel = ESP_LOG_VERBOSE;
+    String logTags;
+    String logMatch;
     int heartbeatIntervalArgIdx = -1;
     for (int i = 0; i < server.args(); i++)
     {
@@ -1405,6 +2479,12 @@ void handle_subscribe()
             logViewer = true;
         else if (server.argName(i).equals("heartbeat"))
             heartbeatIntervalArgIdx = i;
+        else if (server.argName(i).equals("level"))
+            logMaxLevel = (esp_log_level_t)std::clamp((int)server.arg(i).toInt(), (int)ESP_LOG_NONE, (int)ESP_LOG_VERBOSE);
+        else if (server.argName(i).equals("tag"))
+            logTags = server.arg(i);
+        else if (server.argName(i).equals("match"))
+            logMatch = server.arg(i);
     }
 
     // check if we already have a subscription for this UUID
@@ -1436,11 +2516,6 @@ void handle_subscribe()
         for (channel = 0; channel < SSE_MAX_CHANNELS; channel++)
             if (!subscription[channel].clientIP)
                 break;
-
-        if (channel < SSE_MAX_CHANNELS)
-        {
-            subscriptionCount++;
-        }
     }
 
     // Check if we found a free slot
@@ -1479,22 +2554,283 @@ void handle_subscribe()
         }
     }
 
-    // Safe assignment with validation
+    // Safe assignment with validation. Count the slot only once it is in use, so that
+    // removeSSEsubscription() and the count agree.
+    SSE_TAKE_MUTEX();
+    if (!foundExisting)
+        subscriptionCount++;
     subscription[channel].clientIP = clientIP;
+    SSE_GIVE_MUTEX();
     subscription[channel].client = client;
-    subscription[channel].heartbeatTimer = Ticker();
     subscription[channel].SSEconnected = false;
     subscription[channel].SSEfailCount = 0;
     subscription[channel].clientUUID = server.arg(id);
     subscription[channel].logViewer = logViewer;
+    subscription[channel].logMaxLevel = logMaxLevel;
+    subscription[channel].logTags = logTags;
+    subscription[channel].logMatch = logMatch;
     subscription[channel].heartbeatInterval = heartbeatInterval;
 
     SSEurl += std::to_string(channel);
     ESP_LOGD(TAG, "Client %s (%s) SSE subscription: %s, Total: %d, Heartbeat: %d, Log: %d", clientIP.toString().c_str(), server.arg(id).c_str(), SSEurl.c_str(), subscriptionCount, heartbeatInterval, (int)logViewer);
+    if (logViewer && (logMaxLevel != ESP_LOG_VERBOSE || logTags.length() || logMatch.length()))
+        ESP_LOGD(TAG, "Client %s (%s) log filter level: %d, tags: %s, match: %s", clientIP.toString().c_str(), server.arg(id).c_str(), logMaxLevel, logTags.c_str(), logMatch.c_str());
     server.sendHeader(F("Cache-Control"), F("no-cache, no-store"));
     server.send_P(200, type_txt, SSEurl.c_str());
 }
 
+// Base64 of a 20 byte SHA1 hash, for the Sec-WebSocket-Accept handshake header.
+static void WSaccept(const char *key, char *accept)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char buf[64];
+    uint8_t hash[21];
+    int len = snprintf_P(buf, sizeof(buf), PSTR("%s258EAFA5-E914-47DA-95CA-C5AB0DC85B11"), key);
+#ifdef ESP8266
+    sha1((const uint8_t *)buf, len, hash);
+#else
+    mbedtls_sha1((const unsigned char *)buf, len, hash);
+#endif
+    hash[20] = 0;
+    for (int i = 0; i < 21; i += 3)
+    {
+        uint32_t v = (hash[i] << 16) | (hash[i + 1] << 8) | hash[i + 2];
+        *accept++ = b64[(v >> 18) & 0x3F];
+        *accept++ = b64[(v >> 12) & 0x3F];
+        *accept++ = b64[(v >> 6) & 0x3F];
+        *accept++ = (i < 18) ? b64[v & 0x3F] : '=';
+    }
+    *accept = 0;
+}
+
+// Status and log messages for WebSocket clients are compact JSON... {"status":{...}} and
+// {"log":seq,"msg":"..."}.  Log lines are escaped, if that does not fit in the static
+// buffer the frame is allocated.
+static void WSbuildLogFrame(SSEFrame &frame, uint32_t seq, const char *data)
+{
+    size_t size = sizeof(frame.buffer);
+    frame.data = frame.buffer;
+    while (true)
+    {
+        JsonWriter json(frame.data, size);
+        json.addInt("log", seq);
+        json.addStr("msg", data);
+        frame.len = json.finish();
+        if (!json.overflow() || frame.data != frame.buffer)
+            return;
+        size = strlen(data) * 6 + 32;
+        frame.data = static_cast<char *>(malloc(size));
+        if (!frame.data)
+        {
+            frame.data = frame.buffer;
+            frame.len = 0;
+            return;
+        }
+    }
+}
+
+// Read next complete frame from client, unmasked into payload (WS_RX_SIZE + 1 bytes, null terminated).
+// Returns the opcode, 0 if no complete frame yet, -1 if the client sent something we do not support.
+// Call with SSE mutex held.
+static int WSreadFrame(SSESubscription *s, char *payload, size_t *len)
+{
+    if (!s->wsRx)
+        return -1;
+    while (s->wsRxUsed < WS_RX_SIZE && s->client.available())
+    {
+        int n = s->client.read(&s->wsRx[s->wsRxUsed], WS_RX_SIZE - s->wsRxUsed);
+        if (n <= 0)
+            break;
+        s->wsRxUsed += n;
+    }
+    if (s->wsRxUsed < 2)
+        return 0;
+    uint8_t *rx = s->wsRx;
+    // Frames from client must be masked, we do not support fragmented or large frames.
+    if (!(rx[0] & 0x80) || !(rx[1] & 0x80) || (rx[1] & 0x7F) > 125)
+        return -1;
+    size_t hdr = 2 + 4;
+    *len = rx[1] & 0x7F;
+    if (hdr + *len > WS_RX_SIZE)
+        return -1;
+    if (s->wsRxUsed < hdr + *len)
+        return 0;
+    for (size_t i = 0; i < *len; i++)
+        payload[i] = rx[hdr + i] ^ rx[2 + (i & 3)];
+    payload[*len] = 0;
+    int opcode = rx[0] & 0x0F;
+    memmove(rx, &rx[hdr + *len], s->wsRxUsed - hdr - *len);
+    s->wsRxUsed -= hdr + *len;
+    return opcode;
+}
+
+// Commands accepted over WebSocket... {"id":N,"garageDoorState":1}, same keys and values
+// as /setgdo.  Each is acknowledged with {"ack":N,"ok":true} or {"ack":N,"error":"..."}
+static void WScommand(SSESubscription *s, const char *payload)
+{
+    static const std::pair<const char *, bool (*)(const std::string &, const char *, configSetting *)> commands[] = {
+        {"garageDoorState", helperGarageDoorState},
+        {"garageLightOn", helperGarageLightOn},
+        {"garageLockState", helperGarageLockState},
+#ifdef RATGDO32_DISCO
+        {"assistLaser", helperAssistLaser},
+#endif
+    };
+    const char *error = "unknown command";
+    const char *p = strstr(payload, "\"id\":");
+    uint32_t id = (p) ? strtoul(p + 5, NULL, 10) : 0;
+
+    for (auto &cmd : commands)
+    {
+        char key[24];
+        snprintf(key, sizeof(key), "\"%s\":", cmd.first);
+        if (!(p = strstr(payload, key)))
+            continue;
+        p += strlen(key);
+        while (*p == ' ' || *p == '"')
+            p++;
+        const char *value = (!strncmp(p, "true", 4) || *p == '1') ? "1" : "0";
+        if (!s->wsAuthorized)
+        {
+            error = "unauthorized";
+            break;
+        }
+        ESP_LOGI(TAG, "Client %s WebSocket command: %s, Value: %s (id: %lu)", s->clientIP.toString().c_str(), cmd.first, value, id);
+        WScommandCount++;
+        error = (cmd.second(cmd.first, value, nullptr)) ? NULL : "failed";
+        break;
+    }
+
+    SSEFrame frame;
+    JsonWriter json(frame.buffer, sizeof(frame.buffer));
+    json.addInt("ack", id);
+    if (error)
+        json.addStr("error", error);
+    else
+        json.addBool("ok", true);
+    frame.data = frame.buffer;
+    frame.len = json.finish();
+    SSEsend(s, frame, RATGDO_STATUS);
+}
+
+// Handle frames received from a WebSocket client.  Returns false if the connection is to be closed.
+static bool WSpoll(SSESubscription *s)
+{
+    char payload[WS_RX_SIZE + 1];
+    size_t len = 0;
+    while (true)
+    {
+        SSE_TAKE_MUTEX();
+        int opcode = WSreadFrame(s, payload, &len);
+        SSE_GIVE_MUTEX();
+        if (opcode == 0)
+            return s->client.connected();
+        if (opcode == WS_OP_TEXT)
+        {
+            WScommand(s, payload);
+            continue;
+        }
+        if (opcode == WS_OP_PONG)
+            continue;
+
+        SSEFrame frame;
+        frame.data = frame.buffer;
+        frame.len = std::min(len, (size_t)2); // close reason, or ping payload (up to 125 bytes)
+        memcpy(frame.buffer, payload, len);
+        if (opcode == WS_OP_PING)
+        {
+            frame.len = len;
+            SSEsend(s, frame, RATGDO_STATUS, WS_OP_PONG);
+            continue;
+        }
+        // Close, or a frame we do not support (1003), acknowledge and close.
+        if (opcode != WS_OP_CLOSE)
+        {
+            frame.buffer[0] = 1003 >> 8;
+            frame.buffer[1] = 1003 & 0xFF;
+            frame.len = 2;
+        }
+        SSEsend(s, frame, RATGDO_STATUS, WS_OP_CLOSE);
+        return false;
+    }
+}
+
+// Upgrade to WebSocket on /rest/ws, one connection carries status and log events (as SSE does)
+// and door, light and lock commands.  Takes the same query arguments as /rest/events/subscribe
+// except id.  Commands are only accepted if the upgrade request was authenticated.
+void handle_websocket()
+{
+    IPAddress clientIP = server.client().remoteIP();
+    if (!server.header(F("Upgrade")).equalsIgnoreCase(F("websocket")) || !server.hasHeader(F("Sec-WebSocket-Key")) ||
+        server.header(F("Sec-WebSocket-Version")) != "13")
+    {
+        ESP_LOGE(TAG, "Sending %s, for: %s not a WebSocket upgrade", response400invalid, server.uri().c_str());
+        server.send_P(400, type_txt, response400invalid);
+        return;
+    }
+
+    uint32_t channel;
+    for (channel = 0; channel < SSE_MAX_CHANNELS; channel++)
+        if (!subscription[channel].clientIP)
+            break;
+    if (channel >= SSE_MAX_CHANNELS)
+    {
+        ESP_LOGE(TAG, "Client %s WebSocket declined, subscription count: %d", clientIP.toString().c_str(), subscriptionCount);
+        server.send(503, type_txt, "No free subscription slots available");
+        return;
+    }
+
+    SSESubscription &s = subscription[channel];
+    s.logViewer = false;
+    s.logMaxLevel = ESP_LOG_VERBOSE;
+    s.logTags.clear();
+    s.logMatch.clear();
+    s.heartbeatInterval = 1;
+    for (int i = 0; i < server.args(); i++)
+    {
+        if (server.argName(i).equals("log"))
+            s.logViewer = true;
+        else if (server.argName(i).equals("heartbeat"))
+            s.heartbeatInterval = std::clamp((int)server.arg(i).toInt(), 0, 60);
+        else if (server.argName(i).equals("level"))
+            s.logMaxLevel = (esp_log_level_t)std::clamp((int)server.arg(i).toInt(), (int)ESP_LOG_NONE, (int)ESP_LOG_VERBOSE);
+        else if (server.argName(i).equals("tag"))
+            s.logTags = server.arg(i);
+        else if (server.argName(i).equals("match"))
+            s.logMatch = server.arg(i);
+    }
+    s.wsAuthorized = isAuthenticated();
+
+    char accept[32];
+    WSaccept(server.header(F("Sec-WebSocket-Key")).c_str(), accept);
+    s.client = server.client();
+    s.client.setNoDelay(true);
+    s.client.setTimeout(CLIENT_WRITE_TIMEOUT);
+    server.setContentLength(CONTENT_LENGTH_UNKNOWN); // connection stays open
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n"), accept);
+    server.sendContent(writeBuffer);
+
+    SSE_TAKE_MUTEX();
+    s.queue = static_cast<uint8_t *>(malloc(SSE_QUEUE_SIZE + WS_RX_SIZE));
+    s.wsRx = (s.queue) ? &s.queue[SSE_QUEUE_SIZE] : NULL;
+    s.wsRxUsed = 0;
+    s.queueUsed = 0;
+    s.queueSent = 0;
+    s.queueMax = 0;
+    s.droppedBytes = 0;
+    s.clientIP = clientIP;
+    s.clientUUID.clear();
+    s.SSEfailCount = 0;
+    s.websocket = true;
+    s.SSEconnected = true;
+    subscriptionCount++;
+    SSE_GIVE_MUTEX();
+    if (!s.queue)
+        ESP_LOGE(TAG, "Unable to allocate WebSocket queue for client %s", clientIP.toString().c_str());
+    ESP_LOGD(TAG, "Client %s WebSocket on channel %d, Total: %d, Heartbeat: %d, Log: %d, Commands: %s", clientIP.toString().c_str(), channel,
+             subscriptionCount, s.heartbeatInterval, (int)s.logViewer, (s.wsAuthorized) ? "yes" : "no");
+}
+
 void handle_crashlog()
 {
     server.client().print(response200);
@@ -1503,8 +2839,28 @@ void handle_crashlog()
 
 void handle_showlog()
 {
-    server.client().print(response200);
-    ratgdoLogger->printMessageLog(server.client());
+    // Optional query string args...
+    //   after=N  only return log lines with sequence number greater than N (cursor)
+    //   level=N  only return log lines at or below log level N (0..5)
+    //   tag=xxx  only return log lines logged with tag xxx (or comma separated list of tags)
+    //   match=xxx only return log lines that contain the string xxx
+    // Sequence number of the last line considered is returned in X-Log-Cursor header,
+    // pass that back in "after" to retrieve just the lines logged since.
+    bool incremental = server.hasArg(F("after"));
+    uint32_t after = incremental ? strtoul(server.arg(F("after")).c_str(), NULL, 10) : 0;
+    esp_log_level_t level = ESP_LOG_VERBOSE;
+    if (server.hasArg(F("level")))
+        level = (esp_log_level_t)std::clamp((int)server.arg(F("level")).toInt(), (int)ESP_LOG_NONE, (int)ESP_LOG_VERBOSE);
+    String tag = server.arg(F("tag"));
+    String match = server.arg(F("match"));
+    uint32_t cursor = ratgdoLogger->getSequence();
+
+    timingSendStart(false);
+    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("HTTP/1.1 200 OK\nContent-Type: text/plain\nCache-Control: no-cache, no-store\nX-Log-Cursor: %lu\nConnection: close\n\n"), cursor);
+    server.client().print(writeBuffer);
+    if (!incremental)
+        ratgdoLogger->printMessageLogHeader(server.client());
+    ratgdoLogger->printMessagesSince(server.client(), after, cursor, level, tag.c_str(), match.c_str());
 }
 
 void handle_showrebootlog()
@@ -1549,6 +2905,23 @@ void handle_forcecrash()
 }
 #endif // CRASH_DEBUG
 
+// Returns true if log subscriptions have the same filter, so they can share the filter result.
+static bool SSEsameLogFilter(const SSESubscription &a, const SSESubscription &b)
+{
+    return a.logMaxLevel == b.logMaxLevel && a.logTags == b.logTags && a.logMatch == b.logMatch;
+}
+
+static bool SSElogFilter(const SSESubscription &s, const char *data, esp_log_level_t level)
+{
+    if (level > s.logMaxLevel)
+        return false;
+    if (s.logTags.length() && !logLineHasTag(data, s.logTags.c_str()))
+        return false;
+    if (s.logMatch.length() && !strstr(data, s.logMatch.c_str()))
+        return false;
+    return true;
+}
+
 void SSEBroadcastState(const char *data, BroadcastType type)
 {
     if (!web_setup_done)
@@ -1561,8 +2934,27 @@ void SSEBroadcastState(const char *data, BroadcastType type)
     if (subscriptionCount == 0)
         return;
 
+    // The event frame is built once, when the first subscriber needs it, and the same
+    // bytes written to all.  For log messages each filter is applied once per line,
+    // subscribers with the same filter share the result.
+    // Status and log messages use their own frame, as writing to a client may log
+    // a message which would be broadcast while we are still sending status.
+    static SSEFrame statusFrame;
+    static SSEFrame logFrame;
+    static SSEFrame wsStatusFrame;
+    static SSEFrame wsLogFrame;
+    SSEFrame &sseFrame = (type == LOG_MESSAGE) ? logFrame : statusFrame;
+    SSEFrame &wsFrame = (type == LOG_MESSAGE) ? wsLogFrame : wsStatusFrame;
+    bool built = false;
+    bool wsBuilt = false;
+    uint32_t sent = 0;
+    uint32_t startUs = micros();
+    esp_log_level_t level = (type == LOG_MESSAGE) ? logLineLevel(data) : ESP_LOG_NONE;
+    int8_t logPass[SSE_MAX_CHANNELS];
+
     for (uint32_t i = 0; i < SSE_MAX_CHANNELS; i++)
     {
+        logPass[i] = -1;
         YIELD(); // yield between each SSE client
         if (subscription[i].SSEconnected)
         {
@@ -1570,20 +2962,29 @@ void SSEBroadcastState(const char *data, BroadcastType type)
             {
                 if (type == LOG_MESSAGE)
                 {
-                    if (subscription[i].logViewer)
+                    if (!subscription[i].logViewer)
+                        continue;
+
+                    for (uint32_t j = 0; j < i && logPass[i] < 0; j++)
                     {
-                        if (snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("event: logger\ndata: %s\n\n"), data) >= (int)sizeof(writeBuffer))
-                        {
-                            // Will not fit in our write buffer, let system printf handle
-#ifdef ESP8266
-                            subscription[i].client.flush(); // make sure previous data all sent.
-#endif
-                            subscription[i].client.printf("event: logger\ndata: %s\n\n", data);
-                        }
-                        else
-                        {
-                            clientWrite(subscription[i].client, writeBuffer);
-                        }
+                        if (logPass[j] >= 0 && SSEsameLogFilter(subscription[i], subscription[j]))
+                            logPass[i] = logPass[j];
+                    }
+                    if (logPass[i] < 0)
+                        logPass[i] = SSElogFilter(subscription[i], data, level);
+                    if (!logPass[i])
+                        continue;
+
+                    if (subscription[i].websocket && !wsBuilt)
+                    {
+                        WSbuildLogFrame(wsFrame, ratgdoLogger->getSequence(), data);
+                        wsBuilt = true;
+                    }
+                    else if (!subscription[i].websocket && !built)
+                    {
+                        // id is the log line sequence number, client can use it as cursor to /showlog?after=
+                        SSEbuildFrame(sseFrame, PSTR("event: logger\nid: %lu\ndata: %s\n\n"), ratgdoLogger->getSequence(), data);
+                        built = true;
                     }
                 }
                 else if (type == RATGDO_STATUS)
@@ -1591,19 +2992,19 @@ void SSEBroadcastState(const char *data, BroadcastType type)
                     ESP_LOGV(TAG, "Client %s (%s) send status SSE on channel %d, data: %s",
                              IPAddress(subscription[i].clientIP).toString().c_str(),
                              subscription[i].clientUUID.c_str(), i, data);
-                    if (snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("event: message\ndata: %s\n\n"), data) >= (int)sizeof(writeBuffer))
+                    if (subscription[i].websocket && !wsBuilt)
                     {
-                        // Will not fit in our write buffer, let system printf handle
-#ifdef ESP8266
-                        subscription[i].client.flush(); // make sure previous data all sent.
-#endif
-                        subscription[i].client.printf("event: message\ndata: %s\n\n", data);
+                        SSEbuildFrame(wsFrame, PSTR("{\"status\":%s}"), data);
+                        wsBuilt = true;
                     }
-                    else
+                    else if (!subscription[i].websocket && !built)
                     {
-                        clientWrite(subscription[i].client, writeBuffer);
+                        SSEbuildFrame(sseFrame, PSTR("event: message\ndata: %s\n\n"), data);
+                        built = true;
                     }
                 }
+                SSEsend(&subscription[i], (subscription[i].websocket) ? wsFrame : sseFrame, type);
+                sent++;
             }
             else
             {
@@ -1613,9 +3014,47 @@ void SSEBroadcastState(const char *data, BroadcastType type)
             }
         }
     }
+    if (built)
+        SSEfreeFrame(sseFrame);
+    if (wsBuilt)
+        SSEfreeFrame(wsFrame);
+    SSEbroadcastCount[sent]++;
+    SSEbroadcastUs[sent] += micros() - startUs;
     YIELD();
 }
 
+void printSSEStats(Print &outputDev)
+{
+    outputDev.printf("SSE subscriptions: %lu, heartbeat ticks: %lu, evictions: %lu, WebSocket commands: %lu\n", subscriptionCount, SSEheartbeatTicks, SSEevictions, WScommandCount);
+    for (uint32_t i = 0; i < SSE_MAX_CHANNELS; i++)
+    {
+        if (subscription[i].SSEconnected)
+            outputDev.printf("Channel %lu: %s%s queue %u bytes (max %u of %d), dropped %lu bytes\n", i, subscription[i].clientIP.toString().c_str(),
+                             (subscription[i].websocket) ? " (WebSocket)" : "", subscription[i].queueUsed, subscription[i].queueMax, SSE_QUEUE_SIZE, subscription[i].droppedBytes);
+    }
+    outputDev.print("Subscribers  Broadcasts   Avg us\n");
+    for (uint32_t i = 0; i <= SSE_MAX_CHANNELS; i++)
+    {
+        if (SSEbroadcastCount[i])
+            outputDev.printf("%11lu %11lu %8lu\n", i, SSEbroadcastCount[i], (uint32_t)(SSEbroadcastUs[i] / SSEbroadcastCount[i]));
+    }
+}
+
+void printRateStats(Print &outputDev)
+{
+    outputDev.printf("Rate limit clients: %d, evictions: %lu\n", RATE_MAX_CLIENTS, rateEvictions);
+    outputDev.print("Class     Burst  Refill ms    Admitted   Throttled\n");
+    for (uint32_t i = 0; i < RATE_CLASSES; i++)
+        outputDev.printf("%-8s %6u %10u %11lu %11lu\n", rateClassName[i], rateBudget[i].burst, rateBudget[i].refillMs, rateAdmitted[i], rateThrottled[i]);
+    _millis_t now = _millis();
+    for (uint32_t i = 0; i < RATE_MAX_CLIENTS; i++)
+    {
+        if (rateClients[i].clientIP)
+            outputDev.printf("%s last seen %lus ago, tokens %u/%u/%u\n", rateClients[i].clientIP.toString().c_str(), (uint32_t)((now - rateClients[i].lastSeen) / 1000),
+                             rateClients[i].tokens[RATE_STATIC], rateClients[i].tokens[RATE_API], rateClients[i].tokens[RATE_UPLOAD]);
+    }
+}
+
 // Implement our own firmware update so can enforce MD5 check.
 // Based on HTTPUpdateServer
 void _setUpdaterError()
@@ -1633,6 +3072,12 @@ void handle_update()
     server.sendHeader(F("Access-Control-Allow-Headers"), "*");
     server.sendHeader(F("Access-Control-Allow-Origin"), "*");
     AUTHENTICATE();
+    if (uploadRetryAfter)
+    {
+        sendTooManyRequests(RATE_UPLOAD, uploadRetryAfter);
+        uploadRetryAfter = 0;
+        return;
+    }
 
     server.client().setNoDelay(true);
     if (!verify && Update.hasError())
@@ -1681,16 +3126,20 @@ void handle_firmware_upload()
     {
         _updaterError.clear();
 
-#ifdef ESP8266
-        _authenticatedUpdate = !userConfig->getPasswordRequired() || server.authenticateDigest(userConfig->getwwwUsername(), userConfig->getwwwCredentials());
-#else
-        _authenticatedUpdate = !userConfig->getPasswordRequired() || server.authenticate(ratgdoAuthenticate);
-#endif
+        // Accepts a session cookie as well as digest credentials, same as all other handlers
+        _authenticatedUpdate = isAuthenticated();
         if (!_authenticatedUpdate)
         {
             ESP_LOGE(TAG, "Unauthenticated Update");
             return;
         }
+        uploadRetryAfter = admitRequest(RATE_UPLOAD);
+        if (uploadRetryAfter)
+        {
+            // Ignore the rest of the upload, handle_update() responds with 429
+            _authenticatedUpdate = false;
+            return;
+        }
         ESP_LOGI(TAG, "Update: %s", upload.filename.c_str());
         verify = !strcmp(server.arg("action").c_str(), "verify");
         size = atoi(server.arg("size").c_str());
@@ -1775,13 +3224,14 @@ void handle_firmware_upload()
                 {
                     static char *json = loop_json;
                     TAKE_MUTEX();
-                    JSON_START(json);
+                    JSON_START(json, LOOP_JSON_BUFFER_SIZE);
                     JSON_ADD_INT("uploadPercent", uploadPercent);
                     JSON_END();
-                    JSON_REMOVE_NL(json);
-                    snprintf_P(writeBuffer, sizeof(writeBuffer), PSTR("event: uploadStatus\ndata: %s\n\n"), json);
-                    clientWrite(firmwareUpdateSub->client, writeBuffer);
+                    static SSEFrame frame;
+                    SSEbuildFrame(frame, PSTR("event: uploadStatus\ndata: %s\n\n"), json);
                     GIVE_MUTEX();
+                    SSEsend(firmwareUpdateSub, frame, RATGDO_STATUS);
+                    SSEfreeFrame(frame);
                 }
             }
         }
@@ -39,7 +39,7 @@ extern void factoryReset();
 
 extern void load_page(const char *page);
 
-extern void build_status_json(char *json);
+extern size_t build_status_json(char *json, size_t size);
 
 extern const char response400invalid[];
 extern const char type_txt[];
@@ -57,3 +57,5 @@ enum BroadcastType : uint8_t
     LOG_MESSAGE = 2,
 };
 void SSEBroadcastState(const char *data, BroadcastType type = RATGDO_STATUS);
+void printSSEStats(Print &outputDev = Serial);
+void printRateStats(Print &outputDev = Serial);
@@ -746,6 +746,7 @@ function setElementsFromStatus(status) {
             case "freeIramHeap":
             case "webRequests":
             case "webMaxResponseTime":
+            case "webThrottled":
             case "openHistory":
             case "closeHistory":
                 // No-op: Not displayed in UI
@@ -11,6 +11,13 @@ var msgJson = undefined;        // for status
 const clientUUID = uuidv4();    // uniquely identify this session
 var sysLogLoaded = false;
 var tmpLogMsgs = [];
+var logCursor = 0;              // sequence number of last log line received
+// Optional server side filter of live log, from logs page query string, e.g. ?level=3&tag=ratgdo-comms
+const logFilter = new URLSearchParams(window.location.search);
+const logFilterArgs = ["level", "tag", "match"]
+    .filter((arg) => logFilter.has(arg))
+    .map((arg) => `&${arg}=${encodeURIComponent(logFilter.get(arg))}`)
+    .join("");
 
 function msToTime(duration) {
     let seconds = Math.floor((duration / 1000) % 60),
@@ -74,10 +81,43 @@ function openTab(evt, tabName) {
 async function loadLogs() {
     sysLogLoaded = false;
     tmpLogMsgs.length = 0;
+    logCursor = 0;
     // Load all the logs in parallel, showing progress indicator while we do...
     loaderElem.style.visibility = "visible";
+    subscribeLogs(() => {
+        console.log("Load each log page");
+        loadLogPages();
+    });
+}
+
+async function resumeLogs() {
+    // Re-subscribe and fetch only the log lines that we missed while disconnected.
+    console.log(`Resume logs after line: ${logCursor}`);
+    sysLogLoaded = false;
+    tmpLogMsgs.length = 0;
+    subscribeLogs(() => {
+        fetch("showlog?after=" + logCursor + logFilterArgs)
+            .then((response) => {
+                if (!response.ok || response.status !== 200) {
+                    reject(`Error requesting logs, RC: ${response.status}`);
+                } else {
+                    return Promise.all([response.headers.get("X-Log-Cursor"), response.text()]);
+                }
+            })
+            .then(([cursor, text]) => {
+                text = text.replaceAll('\r\n', '\n');
+                if (text.length > 0) appendLog(text.replace(/\n$/, ''), 0);
+                logCursor = Math.max(logCursor, parseInt(cursor) || 0);
+                flushTmpLogMsgs();
+            })
+            .catch(error => console.warn(error));
+    });
+}
+
+function subscribeLogs(onOpen) {
+    if (evtSource) evtSource.close();
     console.log("Subscribe to Server Sent Events");
-    fetch("rest/events/subscribe?id=" + clientUUID + "&log=1&heartbeat=0")
+    fetch("rest/events/subscribe?id=" + clientUUID + "&log=1&heartbeat=0" + logFilterArgs)
         .then((response) => {
             if (!response.ok || response.status !== 200) {
                 reject(`Error registering for Server Sent Events, RC: ${response.status}`);
@@ -89,22 +129,22 @@ async function loadLogs() {
             const evtUrl = text + '?id=' + clientUUID;
             console.log(`Register for Server Sent Events at ${evtUrl}`);
             evtSource = new EventSource(evtUrl);
-            evtSource.onopen = () => {
-                console.log("Load each log page");
-                loadLogPages();
-            };
+            evtSource.onopen = onOpen;
             evtSource.addEventListener("logger", (event) => {
-                let divElem = document.getElementById("logTab");
-                let scroll = (divElem.scrollHeight - divElem.scrollTop - divElem.clientHeight) < 10;
-                document.getElementById("showlog").insertAdjacentText('beforeend', event.data + "\n");
-                if (!sysLogLoaded) tmpLogMsgs.push(event.data);
-                // Only scroll the page if we are already at bottom of the page
-                if (scroll) divElem.scrollTop = divElem.scrollHeight;
+                // SSE event id is the log line sequence number
+                const seq = parseInt(event.lastEventId) || 0;
+                if (!sysLogLoaded) {
+                    // Hold on to it until the log has loaded, it may be a duplicate.
+                    tmpLogMsgs.push({ seq: seq, data: event.data });
+                    return;
+                }
+                appendLog(event.data, seq);
             });
             evtSource.addEventListener("error", (event) => {
-                // If an error occurs close the connection.
+                // If an error occurs close the connection, then try and resume from where we left off.
                 console.log(`SSE error occurred while attempting to connect to ${evtSource.url}`);
                 evtSource.close();
+                if (sysLogLoaded) setTimeout(resumeLogs, 5000);
             });
         })
         .catch((error) => {
@@ -112,6 +152,25 @@ async function loadLogs() {
         });
 }
 
+function appendLog(text, seq) {
+    if (seq && seq <= logCursor) return; // already have this one
+    if (seq) logCursor = seq;
+    let divElem = document.getElementById("logTab");
+    let scroll = (divElem.scrollHeight - divElem.scrollTop - divElem.clientHeight) < 10;
+    document.getElementById("showlog").insertAdjacentText('beforeend', text + "\n");
+    // Only scroll the page if we are already at bottom of the page
+    if (scroll) divElem.scrollTop = divElem.scrollHeight;
+}
+
+function flushTmpLogMsgs() {
+    // Append log messages received over SSE while loading, dropping any already in the log.
+    sysLogLoaded = true;
+    for (const msg of tmpLogMsgs) {
+        appendLog(msg.data, msg.seq);
+    }
+    tmpLogMsgs.length = 0;
+}
+
 async function loadLogPages() {
     // Load the pages in background
     Promise.allSettled([
@@ -121,18 +180,15 @@ async function loadLogPages() {
                 if (!response.ok || response.status !== 200) {
                     reject(`Error requesting logs, RC: ${response.status}`);
                 } else {
-                    return response.text();
+                    return Promise.all([response.headers.get("X-Log-Cursor"), response.text()]);
                 }
             })
-            .then((text) => {
-                sysLogLoaded = true;
+            .then(([cursor, text]) => {
                 // reduce newlines down to single \n
                 text = text.replaceAll('\r\n', '\n');
-                while (line = tmpLogMsgs.pop()) {
-                    console.log(`Remove dup: ${line}`);
-                    text = text.replace(line + '\n', '');
-                }
                 document.getElementById("showlog").insertAdjacentText('afterbegin', text);
+                logCursor = parseInt(cursor) || 0;
+                flushTmpLogMsgs();
                 let divElem = document.getElementById("logTab");
                 // Scroll to the bottom
                 divElem.scrollTop = divElem.scrollHeight;